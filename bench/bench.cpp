@@ -0,0 +1,402 @@
+// Microbenchmarks of the hot paths: count JSON parsing, config lookups, status JSON
+// serialization, config validation and the MQTT broker fan-out.
+//
+// Usage: meow_bench [--filter <substring>] [--config json/config.json] [--i2c /dev/i2c-0]
+//   --filter  run only the cases whose name contains the substring
+//   --config  template for the generated configs, run from the repo root for the default
+//   --i2c     also run the ACMonitor / DCInput cases, they need a ControlModule so only on the box,
+//             it drives the outputs low, never on a box in service
+//
+// Each case is calibrated to about 20 ms per batch, warmed up, then timed over 7 batches.
+// One JSON line per case on stdout: {"name","ops","ns_per_op","min_ns","max_ns"}, ns_per_op is the
+// median batch, so two runs on the same build and board are comparable line by line.
+// A put must reach the subscribers within the same broker wake up: when mqtt.fanout is slower than
+// FANOUT_LIMIT_NS (a broker tick would show as 50 ms) the case is reported on stderr and the exit code is 1.
+
+#include "ConfigManager.h"
+#include "ControlModule.h"
+#include "CommModule.h"
+#include "ACMonitor.h"
+#include "DCinput.h"
+#include "StateStore.h"
+#include "EventJournal.h"
+#include "CountHistory.h"
+#include "LatencyTracker.h"
+#include "LvJSON.h"
+#include "LvMetrics.h"
+#include "Quiet.h"
+#include "SimConfig.h"
+#include "mongoose.h"
+#include "rapidjson/reader.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#define FANOUT_LIMIT_NS 5000000
+
+static std::string filter;
+static bool failed = false;
+
+// Keep the compiler from dropping the work of a case
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static uint64_t now_ns() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Method to time one case and print its JSON line, fn runs one operation, returns the median ns per op (0 when filtered out)
+template <typename F>
+static double run(const std::string& name, F fn) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return 0;
+    }
+
+    // Calibrate the batch to about 20 ms, the first batches are the warm up
+    uint64_t ops = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < ops; i++) {
+            fn();
+        }
+        if (now_ns() - start >= 20000000 || ops >= (1ULL << 30)) {
+            break;
+        }
+        ops *= 2;
+    }
+
+    std::vector<double> batches;
+    for (int repeat = 0; repeat < 7; repeat++) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < ops; i++) {
+            fn();
+        }
+        batches.push_back((double)(now_ns() - start) / ops);
+    }
+    std::sort(batches.begin(), batches.end());
+    printf("{\"name\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.1f,\"min_ns\":%.1f,\"max_ns\":%.1f}\n",
+           name.c_str(), (unsigned long long)ops, batches[batches.size() / 2], batches.front(), batches.back());
+    fflush(stdout);
+    return batches[batches.size() / 2];
+}
+
+// Count response of a camera with 4 loops, same shape as /api/v1/count
+static const char* countBody =
+    "{\"data\":["
+    "{\"id\":1,\"frame_count\":[1],\"accumulate_count\":[0]},"
+    "{\"id\":2,\"frame_count\":[0],\"accumulate_count\":[0]},"
+    "{\"id\":3,\"frame_count\":[0],\"accumulate_count\":[1287]},"
+    "{\"id\":4,\"frame_count\":[0],\"accumulate_count\":[942]}"
+    "]}";
+
+// Values the parse cases take from the count, the same in DOM and SAX
+struct CountValues {
+    int ids[8];
+    int frameCounts[8];
+    int accumulateCounts[8];
+    int size = 0;
+};
+
+static void parseDom(CountValues& values) {
+    LvJSON json;
+    json.Parse(countBody);
+    values.size = 0;
+    for (const auto& data : json["data"].GetArray()) {
+        values.ids[values.size] = data["id"].GetInt();
+        values.frameCounts[values.size] = data["frame_count"][0].GetInt();
+        values.accumulateCounts[values.size] = data["accumulate_count"][0].GetInt();
+        values.size++;
+    }
+}
+
+// SAX handler, takes the first number after each key of a data entry
+struct CountHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CountHandler> {
+    CountValues& values;
+    int* target = nullptr;
+    int depth = 0;
+    explicit CountHandler(CountValues& values) : values(values) {}
+
+    bool Key(const char* str, rapidjson::SizeType length, bool) {
+        target = nullptr;
+        if (length == 2 && memcmp(str, "id", 2) == 0) {
+            target = &values.ids[values.size];
+        } else if (length == 11 && memcmp(str, "frame_count", 11) == 0) {
+            target = &values.frameCounts[values.size];
+        } else if (length == 16 && memcmp(str, "accumulate_count", 16) == 0) {
+            target = &values.accumulateCounts[values.size];
+        }
+        return true;
+    }
+    bool Int(int value) {
+        if (target != nullptr) {
+            *target = value;
+            target = nullptr;
+        }
+        return true;
+    }
+    bool Uint(unsigned value) { return Int((int)value); }
+    bool StartObject() { depth++; return true; }
+    bool EndObject(rapidjson::SizeType) {
+        if (--depth == 1 && values.size < 7) {
+            values.size++; // a data entry closed
+        }
+        return true;
+    }
+    bool Default() { return true; }
+};
+
+static void parseSax(CountValues& values) {
+    values.size = 0;
+    CountHandler handler(values);
+    rapidjson::Reader reader;
+    rapidjson::StringStream stream(countBody);
+    reader.Parse(stream, handler);
+}
+
+// Files of this run, all under /tmp
+static std::string tmpPrefix() {
+    return "/tmp/meow_bench_" + std::to_string(getpid()) + "_";
+}
+
+// Method to write a config with cameras copies of the first camera of the template,
+// the journal and state files go to /tmp so the bench never touches the box files
+static std::string makeConfig(const std::string& templateFile, int cameras) {
+    LvJSON doc;
+    try {
+        SimConfig::load(doc, templateFile);
+    } catch (const std::string& err) {
+        std::cerr << err << std::endl;
+        exit(1);
+    }
+    std::vector<std::string> ips;
+    for (int i = 0; i < cameras; i++) {
+        ips.push_back("10.0." + std::to_string(i / 250) + "." + std::to_string(i % 250 + 1));
+    }
+    SimConfig::copyFirstCamera(doc, ips);
+    std::string prefix = tmpPrefix();
+    SimConfig::useFiles(doc, prefix, 4096);
+    return SimConfig::write(doc, prefix + std::to_string(cameras) + ".json");
+}
+
+static void benchParse() {
+    CountValues values;
+    run("parse.count.dom", [&] { parseDom(values); keep(values); });
+    run("parse.count.sax", [&] { parseSax(values); keep(values); });
+}
+
+static void benchConfigLookup(const std::string& templateFile) {
+    for (int cameras : {1, 16, 128}) {
+        std::string filepath = makeConfig(templateFile, cameras);
+        std::unique_ptr<ConfigManager> configManager;
+        {
+            Quiet quiet;
+            configManager.reset(new ConfigManager(filepath));
+        }
+        // the last camera is the worst case of the linear search
+        std::string ip = configManager->getCameraConfigs().back().ip_address;
+        std::string suffix = "/" + std::to_string(cameras);
+        run("config.demandGpio" + suffix, [&] { auto gpio = configManager->getDemandGpioConfig(ip, 2); keep(gpio); });
+        run("config.demandCount" + suffix, [&] { auto demand = configManager->getDemandCountConfig(ip, 2); keep(demand); });
+        run("config.camera" + suffix, [&] { auto camera = configManager->getCameraConfig(ip); keep(camera); });
+        {
+            Quiet quiet;
+            configManager.reset();
+        }
+        unlink(filepath.c_str());
+    }
+}
+
+// ConfigManager::validateConfig on the whole config, parsed once
+static void benchValidate(const std::string& templateFile) {
+    for (int cameras : {16, 128}) {
+        std::string filepath = makeConfig(templateFile, cameras);
+        LvJSON doc;
+        doc.Parse(SimConfig::readFile(filepath).c_str());
+        unlink(filepath.c_str());
+        if (!ConfigManager::validateConfig(doc)) {
+            std::cerr << "The generated config does not validate" << std::endl;
+            failed = true;
+            return;
+        }
+        run("validate.config/" + std::to_string(cameras), [&] { bool valid = ConfigManager::validateConfig(doc); keep(valid); });
+    }
+}
+
+static void benchSerialize(const std::string& templateFile, const std::string& i2cDevice) {
+    std::string filepath = makeConfig(templateFile, 16);
+    std::unique_ptr<ConfigManager> configManager;
+    std::unique_ptr<EventJournal> eventJournal;
+    std::unique_ptr<LatencyTracker> latencyTracker;
+    std::unique_ptr<CountHistory> countHistory;
+    {
+        Quiet quiet;
+        configManager.reset(new ConfigManager(filepath));
+        eventJournal.reset(new EventJournal(*configManager));
+        latencyTracker.reset(new LatencyTracker(*configManager));
+        countHistory.reset(new CountHistory(*configManager));
+    }
+
+    // A day of one minute polls on one loop, 1000 events, 1000 demands per camera loop
+    std::string ip = configManager->getCameraConfigs().front().ip_address;
+    for (int minute = 0; minute < 1440; minute++) {
+        countHistory->record(ip, 3, 1700000000000ULL + minute * 60000ULL, minute % 3, {minute, minute / 2});
+    }
+    for (int i = 0; i < 1000; i++) {
+        eventJournal->record(EventJournal::SourceDemand, i % 4 + 1, i % 7);
+    }
+    for (const auto& camera : configManager->getCameraConfigs()) {
+        for (int i = 0; i < 1000; i++) {
+            LatencyTracker::Stamps stamps;
+            stamps.requestUs = 1000000;
+            stamps.responseUs = stamps.requestUs + 2000 + i * 10;
+            stamps.parsedUs = stamps.responseUs + 30;
+            stamps.handleUs = stamps.parsedUs + 5;
+            stamps.writtenUs = stamps.handleUs + 200;
+            latencyTracker->record(camera.ip_address, 1 + i % 2, stamps);
+        }
+    }
+
+    run("json.countHistory.1m", [&] { std::string json = countHistory->toJSON(ip, 3, "1m", 0); keep(json); });
+    run("json.eventJournal", [&] { std::string json = eventJournal->toJSON(0); keep(json); });
+    run("json.latency/16", [&] { std::string json = latencyTracker->toJSON(); keep(json); });
+    run("json.metrics.prometheus", [&] { std::string text = LvMetrics::instance().prometheus(); keep(text); });
+
+    if (!i2cDevice.empty()) {
+        std::unique_ptr<StateStore> stateStore;
+        std::unique_ptr<ControlModule> controlModule;
+        std::unique_ptr<CommModule> commModule;
+        std::unique_ptr<ACMonitor> acMonitor;
+        std::unique_ptr<DCInput> dcInput;
+        {
+            Quiet quiet;
+            stateStore.reset(new StateStore(*configManager));
+            controlModule.reset(new ControlModule(i2cDevice, 0x20, 0x21, *configManager, *stateStore));
+            commModule.reset(new CommModule("mqtt://127.0.0.1:0"));
+            acMonitor.reset(new ACMonitor(*configManager, *controlModule, *commModule, *eventJournal));
+            dcInput.reset(new DCInput(*configManager, *controlModule, *commModule, *eventJournal));
+        }
+        run("json.acMonitor", [&] { std::string json = acMonitor->generateJSON(); keep(json); });
+        run("json.dcInput", [&] { std::string json = dcInput->generateJSON(); keep(json); });
+        Quiet quiet;
+        dcInput.reset();
+        acMonitor.reset();
+        commModule.reset();
+        controlModule.reset();
+        stateStore.reset();
+    }
+    {
+        Quiet quiet;
+        latencyTracker.reset();
+        eventJournal.reset();
+        configManager.reset();
+    }
+    unlink(filepath.c_str());
+    unlink((tmpPrefix() + "events.journal").c_str());
+    unlink((tmpPrefix() + "iotbox.state").c_str());
+}
+
+// MQTT subscriber side of the fan-out case
+struct FanoutClients {
+    struct mg_mgr mgr;
+    int subscribed = 0;
+    uint64_t received = 0;
+
+    static void handler(struct mg_connection* c, int ev, void* ev_data) {
+        FanoutClients& clients = *(FanoutClients*)c->fn_data;
+        if (ev == MG_EV_MQTT_OPEN) {
+            struct mg_mqtt_opts opts;
+            memset(&opts, 0, sizeof(opts));
+            opts.topic = mg_str("bench/#");
+            mg_mqtt_sub(c, &opts);
+        } else if (ev == MG_EV_MQTT_CMD && ((struct mg_mqtt_message*)ev_data)->cmd == MQTT_CMD_SUBACK) {
+            clients.subscribed++;
+        } else if (ev == MG_EV_MQTT_MSG) {
+            clients.received++;
+        }
+    }
+};
+
+// Time from the put of one message to its delivery at every subscriber, over loopback
+static void benchFanout() {
+    int port = 18900 + getpid() % 1000;
+    std::string address = "mqtt://127.0.0.1:" + std::to_string(port);
+    LvMQTTServer server(address.c_str());
+    server.start();
+
+    for (int subscribers : {1, 8, 64}) {
+        std::string name = "mqtt.fanout/" + std::to_string(subscribers);
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            continue;
+        }
+        FanoutClients clients;
+        mg_mgr_init(&clients.mgr);
+        for (int i = 0; i < subscribers; i++) {
+            struct mg_mqtt_opts opts;
+            memset(&opts, 0, sizeof(opts));
+            opts.clean = true;
+            std::string clientId = "bench" + std::to_string(i);
+            opts.client_id = mg_str(clientId.c_str());
+            mg_mqtt_connect(&clients.mgr, address.c_str(), &opts, &FanoutClients::handler, &clients);
+        }
+        uint64_t start = mg_millis();
+        while (clients.subscribed < subscribers && mg_millis() - start < 5000) {
+            mg_mgr_poll(&clients.mgr, 1);
+        }
+        if (clients.subscribed < subscribers) {
+            std::cerr << name << ": only " << clients.subscribed << " subscribers connected, skipped" << std::endl;
+            mg_mgr_free(&clients.mgr);
+            continue;
+        }
+
+        const std::string payload(256, 'x');
+        double ns = run(name, [&] {
+            uint64_t expected = clients.received + subscribers;
+            server.put("bench/status", payload);
+            while (clients.received < expected) {
+                mg_mgr_poll(&clients.mgr, 1);
+            }
+        });
+        if (ns > FANOUT_LIMIT_NS) {
+            std::cerr << name << ": " << ns / 1e6 << " ms per publish, above " << FANOUT_LIMIT_NS / 1e6
+                      << " ms, the put waited for a broker tick" << std::endl;
+            failed = true;
+        }
+        mg_mgr_free(&clients.mgr);
+    }
+    server.stop();
+}
+
+int main(int argc, char* argv[]) {
+    std::string templateFile = "json/config.json";
+    std::string i2cDevice;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--filter") {
+            filter = argv[i + 1];
+        } else if (option == "--config") {
+            templateFile = argv[i + 1];
+        } else if (option == "--i2c") {
+            i2cDevice = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    mg_log_set(MG_LL_ERROR);
+
+    benchParse();
+    benchConfigLookup(templateFile);
+    benchValidate(templateFile);
+    benchSerialize(templateFile, i2cDevice);
+    benchFanout();
+    return failed ? 1 : 0;
+}
@@ -1,24 +1,23 @@
-const ws = new WebSocket('ws://localhost:3000');
+const ws = new WebSocket(`ws://${location.host}/ws`);
+ws.binaryType = 'arraybuffer'; // the box sends the status JSON in binary frames
+const decoder = new TextDecoder();
 
 ws.onopen = () => {
     console.log("WebSocket connection established.");
 };
 
 ws.onmessage = (event) => {
-    const data = JSON.parse(event.data);
-    const topic = data.topic;
-    const message = JSON.parse(data.message);
+    // Each frame is the status JSON published by one module
+    const message = JSON.parse(decoder.decode(event.data));
 
-    switch (topic) {
-        case 'Camera_status':
-            updateCameraStatus(message.cameraStatus);
-            break;
-        case 'AC_status':
-            updateACStatus(message.AC_status);
-            break;
-        case 'DC_status':
-            updateDCStatus(message.DC_status);
-            break;
+    if (message.cameraStatus) {
+        updateCameraStatus(message.cameraStatus);
+    }
+    if (message.AC_status) {
+        updateACStatus(message.AC_status);
+    }
+    if (message.DC_status) {
+        updateDCStatus(message.DC_status);
     }
 };
 
@@ -0,0 +1,279 @@
+// #include "LvAssetCache.h"
+#ifndef LV_ASSET_CACHE_H
+#define LV_ASSET_CACHE_H
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdio> // snprintf
+#include <cstdlib> // atof
+#include <strings.h> // strcasecmp
+#include <cstdint> // uint64_t
+#include <dirent.h> // opendir
+#include <sys/stat.h> // stat
+#include <zlib.h> // deflate
+#include "mongoose.h"
+
+// Static files kept in memory, loaded once at startup so serving them need no disk read.
+// Each file keep a gzip variant (made here with zlib, or <file>.gz if exist) and a brotli variant
+// (only <file>.br if exist, make it at build time with "brotli -k"), a variant is kept only when smaller.
+// Answer If-None-Match with 304. Files changed on disk after loaded are not seen until restart.
+// Not thread safe.
+class LvAssetCache
+{
+public:
+	LvAssetCache(uint64_t _limitBytes = 4194304)
+		: limitBytes(_limitBytes)
+	{}
+
+	// load every file under the root directory, stop when the memory limit reached
+	void loadDir(const std::string &rootDir)
+	{
+		if (limitBytes == 0) return;
+		size_t before = assetMap.size();
+		walk(normalize(rootDir), "");
+		MG_INFO(("Asset cache %s: %lu files, %lu bytes",
+		         rootDir.c_str(), (unsigned long)(assetMap.size() - before), (unsigned long)totalBytes));
+	}
+
+	// return true when the file loaded or already loaded
+	bool loadFile(const std::string &filepath)
+	{
+		if (limitBytes == 0) return false;
+		if (assetMap.find(filepath) != assetMap.end()) return true;
+
+		Asset asset;
+		if (!readFile(filepath, asset.body)) return false;
+		if (totalBytes + asset.body.size() > limitBytes)
+		{
+			MG_ERROR(("Asset cache full, %s served from disk", filepath.c_str()));
+			return false;
+		}
+		asset.etag = hashHex(asset.body);
+
+		std::string sidecar;
+		if (readFile(filepath + ".gz", sidecar)) asset.gzip = sidecar;
+		else asset.gzip = gzipCompress(asset.body);
+		if (asset.gzip.size() + 16 >= asset.body.size()) asset.gzip.clear(); // not worth
+		if (readFile(filepath + ".br", sidecar) && sidecar.size() < asset.body.size()) asset.brotli = sidecar;
+
+		totalBytes += asset.body.size() + asset.gzip.size() + asset.brotli.size();
+		assetMap[filepath] = asset;
+		return true;
+	}
+
+	// file under the directory loaded by loadDir, uri is the request path
+	// return true when response written from memory, false caller serve it the normal way
+	bool serveDir(struct mg_connection *c, struct mg_http_message *hm, const std::string &rootDir, const std::string &mimeTypes = "")
+	{
+		if (assetMap.empty()) return false;
+		char decoded[512];
+		int len = mg_url_decode(hm->uri.ptr, hm->uri.len, decoded, sizeof(decoded), 0);
+		if (len <= 0 || decoded[0] != '/') return false;
+		std::string path = normalize(rootDir) + std::string(decoded, len);
+		if (path[path.size() - 1] == '/') path += "index.html";
+		return serveFile(c, hm, path, "", mimeTypes);
+	}
+
+	// mimeTypes same format as mg_http_serve_opts, "ext1=type1,ext2=type2"
+	bool serveFile(struct mg_connection *c, struct mg_http_message *hm, const std::string &filepath,
+	               const std::string &extraHeaders = "", const std::string &mimeTypes = "")
+	{
+		auto it = assetMap.find(filepath);
+		if (it == assetMap.end()) return false;
+		const Asset &asset = it->second;
+
+		const std::string *body = &asset.body;
+		const char *encoding = NULL;
+		std::string etag = asset.etag;
+		struct mg_str *acceptEncoding = mg_http_get_header(hm, "Accept-Encoding");
+		if (acceptEncoding != NULL)
+		{
+			if (!asset.brotli.empty() && accepts(*acceptEncoding, "br"))
+			{
+				body = &asset.brotli;
+				encoding = "br";
+			}
+			else if (!asset.gzip.empty() && accepts(*acceptEncoding, "gzip"))
+			{
+				body = &asset.gzip;
+				encoding = "gzip";
+			}
+		}
+		if (encoding != NULL) etag += std::string("-") + encoding;
+		etag = "\"" + etag + "\"";
+
+		std::string headers = "Content-Type: " + contentType(filepath, mimeTypes) + "\r\n"
+		                      "ETag: " + etag + "\r\n"
+		                      "Cache-Control: no-cache\r\n" // always revalidate, mostly cost a 304
+		                      "Vary: Accept-Encoding\r\n";
+		if (encoding != NULL) headers += std::string("Content-Encoding: ") + encoding + "\r\n";
+		headers += extraHeaders;
+
+		struct mg_str *ifNoneMatch = mg_http_get_header(hm, "If-None-Match");
+		if (ifNoneMatch != NULL && matchEtag(*ifNoneMatch, asset.etag))
+		{
+			mg_printf(c, "HTTP/1.1 304 Not Modified\r\n%sContent-Length: 0\r\n\r\n", headers.c_str());
+			return true;
+		}
+
+		mg_printf(c, "HTTP/1.1 200 OK\r\n%sContent-Length: %lu\r\n\r\n", headers.c_str(), (unsigned long)body->size());
+		if (mg_vcasecmp(&hm->method, "HEAD") != 0) mg_send(c, body->data(), body->size());
+		return true;
+	}
+
+	size_t size()
+	{
+		return assetMap.size();
+	}
+
+private:
+	struct Asset
+	{
+		std::string body;
+		std::string gzip;
+		std::string brotli;
+		std::string etag; // content hash, without quote
+	};
+	const uint64_t limitBytes; // body + variants of all the files, 0 disable the cache
+	uint64_t totalBytes = 0;
+	std::map<std::string, Asset> assetMap; // <file path, asset>
+
+	static std::string normalize(std::string dir)
+	{
+		while (dir.size() > 1 && dir[dir.size() - 1] == '/') dir.erase(dir.size() - 1);
+		return dir;
+	}
+
+	void walk(const std::string &rootDir, const std::string &relDir)
+	{
+		DIR *dir = opendir((rootDir + relDir).c_str());
+		if (dir == NULL) return;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			std::string name = entry->d_name;
+			if (name == "." || name == "..") continue;
+			std::string path = rootDir + relDir + "/" + name;
+			struct stat st;
+			if (stat(path.c_str(), &st) != 0) continue;
+			if (S_ISDIR(st.st_mode)) walk(rootDir, relDir + "/" + name);
+			else if (S_ISREG(st.st_mode) && !endsWith(name, ".gz") && !endsWith(name, ".br")) loadFile(path);
+		}
+		closedir(dir);
+	}
+
+	static bool readFile(const std::string &filepath, std::string &content)
+	{
+		std::ifstream file(filepath.c_str(), std::ios::binary);
+		if (!file.is_open()) return false;
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		content = buffer.str();
+		return true;
+	}
+
+	static std::string gzipCompress(const std::string &data)
+	{
+		z_stream zs = {};
+		if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return "";
+		std::string out;
+		out.resize(deflateBound(&zs, data.size()) + 32); // +32 for gzip header and trailer
+		zs.next_in = (Bytef*)data.data();
+		zs.avail_in = data.size();
+		zs.next_out = (Bytef*)&out[0];
+		zs.avail_out = out.size();
+		int rc = deflate(&zs, Z_FINISH);
+		out.resize(zs.total_out);
+		deflateEnd(&zs);
+		return rc == Z_STREAM_END ? out : "";
+	}
+
+	// FNV-1a 64 bit
+	static std::string hashHex(const std::string &data)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (unsigned char ch : data)
+		{
+			hash ^= ch;
+			hash *= 1099511628211ULL;
+		}
+		char buf[17];
+		snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+		return buf;
+	}
+
+	// coding in the Accept-Encoding list, "gzip;q=0" is refused
+	static bool accepts(struct mg_str header, const char *coding)
+	{
+		std::string list(header.ptr, header.len);
+		size_t start = 0;
+		while (start < list.size())
+		{
+			size_t end = list.find(',', start);
+			if (end == std::string::npos) end = list.size();
+			std::string token = list.substr(start, end - start);
+			start = end + 1;
+
+			size_t semicolon = token.find(';');
+			std::string name = token.substr(0, semicolon);
+			name.erase(0, name.find_first_not_of(' '));
+			name.erase(name.find_last_not_of(' ') + 1);
+			if (strcasecmp(name.c_str(), coding) != 0) continue;
+			if (semicolon == std::string::npos) return true;
+			size_t q = token.find("q=", semicolon);
+			return q == std::string::npos || atof(token.c_str() + q + 2) > 0;
+		}
+		return false;
+	}
+
+	// all the variants of one file share the hash so any of them match, "*" match all
+	static bool matchEtag(struct mg_str header, const std::string &etag)
+	{
+		std::string value(header.ptr, header.len);
+		return value.find(etag) != std::string::npos || value.find('*') != std::string::npos;
+	}
+
+	static bool endsWith(const std::string &str, const std::string &suffix)
+	{
+		return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	static std::string contentType(const std::string &filepath, const std::string &mimeTypes)
+	{
+		size_t dot = filepath.find_last_of('.');
+		std::string ext = dot == std::string::npos ? "" : filepath.substr(dot + 1);
+
+		struct mg_str list = mg_str(mimeTypes.c_str()), entry, key, value;
+		while (mg_span(list, &entry, &list, ','))
+		{
+			if (!mg_span(entry, &key, &value, '=')) continue;
+			if (key.len == ext.size() && strncasecmp(key.ptr, ext.c_str(), key.len) == 0)
+				return std::string(value.ptr, value.len);
+		}
+
+		static const std::map<std::string, std::string> knownTypes =
+		{
+			{"html", "text/html; charset=utf-8"},
+			{"htm", "text/html; charset=utf-8"},
+			{"css", "text/css; charset=utf-8"},
+			{"js", "text/javascript; charset=utf-8"},
+			{"json", "application/json"},
+			{"txt", "text/plain; charset=utf-8"},
+			{"svg", "image/svg+xml"},
+			{"png", "image/png"},
+			{"jpg", "image/jpeg"},
+			{"jpeg", "image/jpeg"},
+			{"gif", "image/gif"},
+			{"ico", "image/x-icon"},
+			{"webp", "image/webp"},
+			{"woff", "font/woff"},
+			{"ttf", "font/ttf"},
+		};
+		auto it = knownTypes.find(ext);
+		return it == knownTypes.end() ? "text/plain; charset=utf-8" : it->second;
+	}
+};
+
+#endif // LV_ASSET_CACHE_H
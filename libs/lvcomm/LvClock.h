@@ -0,0 +1,82 @@
+// #include "LvClock.h"
+#ifndef LV_CLOCK_H
+#define LV_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // uint64_t
+#include <time.h> // clock_gettime
+
+// Time source of the modules in milliseconds, the main loop reads it once per tick and passes now_ms down.
+// nowMs() is CLOCK_MONOTONIC, NTP steps and manual date changes dont move it, so it is the one for
+// intervals, hold times and heartbeats. wallMs() is the date, only for the timestamps that leave the box
+// (journal, history, checkpoint), toWallMs() / fromWallMs() map a monotonic time to it and back.
+// A simulation or a benchmark injects its own monotonic time, the wall time is then that time plus an offset.
+// Inject before the module threads start.
+class LvClock
+{
+public:
+	typedef uint64_t (*NowCallback)(void *self);
+
+	static uint64_t nowMs()
+	{
+		NowCallback callback = source().callback.load(std::memory_order_acquire);
+		if (callback != NULL) return callback(source().self.load(std::memory_order_relaxed));
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	}
+
+	static uint64_t wallMs()
+	{
+		NowCallback callback = source().callback.load(std::memory_order_acquire);
+		if (callback != NULL)
+		{
+			return callback(source().self.load(std::memory_order_relaxed)) + source().wallOffsetMs.load(std::memory_order_relaxed);
+		}
+		using namespace std::chrono;
+		return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+	}
+
+	// wall time of an earlier nowMs(), with the current mapping so an NTP step applies to it too
+	static uint64_t toWallMs(uint64_t monotonicMs)
+	{
+		uint64_t now = nowMs();
+		uint64_t wall = wallMs();
+		uint64_t age = now > monotonicMs ? now - monotonicMs : 0;
+		return wall > age ? wall - age : 0;
+	}
+
+	// monotonic time of a wall time, e.g. read back from a file, a date in the future maps to now
+	static uint64_t fromWallMs(uint64_t wallTimeMs)
+	{
+		uint64_t now = nowMs();
+		uint64_t wall = wallMs();
+		uint64_t age = wall > wallTimeMs ? wall - wallTimeMs : 0;
+		return now > age ? now - age : 0;
+	}
+
+	// NULL goes back to the system clocks, wallOffsetMs is added to the injected time for wallMs()
+	static void inject(NowCallback callback, void *self, uint64_t wallOffsetMs = 0)
+	{
+		source().self.store(self, std::memory_order_relaxed);
+		source().wallOffsetMs.store(wallOffsetMs, std::memory_order_relaxed);
+		source().callback.store(callback, std::memory_order_release);
+	}
+
+private:
+	struct Source
+	{
+		std::atomic<NowCallback> callback{NULL};
+		std::atomic<void*> self{NULL};
+		std::atomic<uint64_t> wallOffsetMs{0};
+	};
+
+	static Source &source()
+	{
+		static Source instance;
+		return instance;
+	}
+};
+
+#endif // LV_CLOCK_H
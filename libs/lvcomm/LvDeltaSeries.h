@@ -0,0 +1,170 @@
+// #include "LvDeltaSeries.h"
+#ifndef LV_DELTA_SERIES_H
+#define LV_DELTA_SERIES_H
+
+#include <vector>
+#include <cstdint> // int64_t
+#include <cstddef> // size_t
+
+// Fixed memory time series of <time, Width integer values>, compressed and kept in a ring of blocks.
+// Each block start with the full sample, the next samples store the time as delta-of-delta and
+// the values as delta to the previous sample, all zigzag varint, so a steady poll of slow counters
+// take about 1 byte per field. When the ring is full the oldest block is dropped.
+// Not thread safe.
+class LvDeltaSeries
+{
+public:
+	struct Sample
+	{
+		uint64_t timeMs;
+		std::vector<int64_t> values;
+	};
+
+	LvDeltaSeries(size_t _width, size_t _blockBytes = 512, size_t _blockCount = 32)
+		: width(_width), blockBytes(_blockBytes), blocks(_blockCount),
+		  storage(_blockBytes * _blockCount), prevValues(_width, 0)
+	{}
+
+	// values must hold width values, time must not go backward
+	void append(uint64_t timeMs, const int64_t *values)
+	{
+		if (newest < 0 || blockBytes - blocks[newest].used < maxSampleBytes())
+		{
+			startBlock(timeMs, values);
+			return;
+		}
+
+		Block &block = blocks[newest];
+		uint8_t *out = &storage[newest * blockBytes] + block.used;
+		int64_t delta = (int64_t)(timeMs - prevTimeMs);
+		size_t n = writeVarint(out, zigzag(delta - prevDelta));
+		for (size_t i = 0; i < width; ++i)
+		{
+			n += writeVarint(out + n, zigzag(values[i] - prevValues[i]));
+			prevValues[i] = values[i];
+		}
+		block.used += n;
+		block.count++;
+		block.lastTimeMs = timeMs;
+		prevDelta = delta;
+		prevTimeMs = timeMs;
+	}
+
+	// decode the samples at or after sinceMs, oldest first
+	std::vector<Sample> read(uint64_t sinceMs = 0) const
+	{
+		std::vector<Sample> samples;
+		if (newest < 0) return samples;
+		for (size_t k = 1; k <= blocks.size(); ++k)
+		{
+			size_t index = (newest + k) % blocks.size();
+			const Block &block = blocks[index];
+			if (block.count == 0 || block.lastTimeMs < sinceMs) continue;
+
+			const uint8_t *in = &storage[index * blockBytes];
+			Sample sample;
+			sample.values.resize(width);
+			int64_t delta = 0;
+			for (uint32_t s = 0; s < block.count; ++s)
+			{
+				if (s == 0)
+				{
+					sample.timeMs = readVarint(in);
+					for (size_t i = 0; i < width; ++i) sample.values[i] = unzigzag(readVarint(in));
+				}
+				else
+				{
+					delta += unzigzag(readVarint(in));
+					sample.timeMs += delta;
+					for (size_t i = 0; i < width; ++i) sample.values[i] += unzigzag(readVarint(in));
+				}
+				if (sample.timeMs >= sinceMs) samples.push_back(sample);
+			}
+		}
+		return samples;
+	}
+
+	// bytes reserved for the samples
+	size_t capacity() const
+	{
+		return storage.size();
+	}
+
+private:
+	struct Block
+	{
+		uint32_t used = 0; // bytes
+		uint32_t count = 0; // samples
+		uint64_t lastTimeMs = 0;
+	};
+
+	const size_t width;
+	const size_t blockBytes;
+	std::vector<Block> blocks;
+	std::vector<uint8_t> storage;
+	int newest = -1; // block being written
+
+	// encoder state of the newest block
+	uint64_t prevTimeMs = 0;
+	int64_t prevDelta = 0;
+	std::vector<int64_t> prevValues;
+
+	size_t maxSampleBytes() const
+	{
+		return 10 * (width + 1);
+	}
+
+	void startBlock(uint64_t timeMs, const int64_t *values)
+	{
+		newest = (newest + 1) % blocks.size(); // overwrite the oldest when full
+		Block &block = blocks[newest];
+		uint8_t *out = &storage[newest * blockBytes];
+		size_t n = writeVarint(out, timeMs);
+		for (size_t i = 0; i < width; ++i)
+		{
+			n += writeVarint(out + n, zigzag(values[i]));
+			prevValues[i] = values[i];
+		}
+		block.used = n;
+		block.count = 1;
+		block.lastTimeMs = timeMs;
+		prevTimeMs = timeMs;
+		prevDelta = 0;
+	}
+
+	static uint64_t zigzag(int64_t value)
+	{
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+
+	static int64_t unzigzag(uint64_t value)
+	{
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	static size_t writeVarint(uint8_t *out, uint64_t value)
+	{
+		size_t n = 0;
+		while (value >= 0x80)
+		{
+			out[n++] = (uint8_t)(value | 0x80);
+			value >>= 7;
+		}
+		out[n++] = (uint8_t)value;
+		return n;
+	}
+
+	static uint64_t readVarint(const uint8_t *&in)
+	{
+		uint64_t value = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			uint8_t byte = *in++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		return value;
+	}
+};
+
+#endif // LV_DELTA_SERIES_H
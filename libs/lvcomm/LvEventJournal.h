@@ -0,0 +1,163 @@
+// #include "LvEventJournal.h"
+#ifndef LV_EVENT_JOURNAL_H
+#define LV_EVENT_JOURNAL_H
+
+#include <string> // std::string
+#include <cstring> // memset
+#include <cstdint> // uint64_t
+#include <fcntl.h> // open
+#include <unistd.h> // close, ftruncate
+#include <sys/mman.h> // mmap, msync, munmap
+
+// Append-only journal of fixed size <time, source, id, value> records in a preallocated mmap'd file.
+// The content survive restart, when full the oldest record is overwritten.
+// Writes only touch the mapping, the batch is written back at most once per interval
+// so the SD card sees one write per batch instead of one per event.
+// Not thread safe, except sync() which may run while another thread appends.
+class LvEventJournal
+{
+public:
+	struct Record
+	{
+		uint64_t timeMs;
+		uint16_t source;
+		uint16_t reserved;
+		int32_t id;
+		int64_t value;
+	};
+
+	LvEventJournal(uint64_t _flushIntervalMs = 5000)
+		: flushIntervalMs(_flushIntervalMs)
+	{}
+	~LvEventJournal()
+	{
+		close();
+	}
+
+	// capacity in records, return 0 OK, -1 cannot create file, -2 cannot map
+	int open(const std::string &filepath, uint32_t capacity)
+	{
+		close();
+		fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) return -1;
+		mapLen = sizeof(Header) + (size_t)capacity * sizeof(Record);
+		if (ftruncate(fd, mapLen) != 0)
+		{
+			close();
+			return -1;
+		}
+		void *addr = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			close();
+			return -2;
+		}
+		header = (Header*)addr;
+		records = (Record*)((uint8_t*)addr + sizeof(Header));
+
+		// new file or other layout, start empty
+		if (header->magic != Magic || header->recordSize != sizeof(Record) || header->capacity != capacity)
+		{
+			memset(header, 0, sizeof(Header));
+			header->magic = Magic;
+			header->recordSize = sizeof(Record);
+			header->capacity = capacity;
+		}
+		return 0;
+	}
+
+	void close()
+	{
+		if (header != NULL)
+		{
+			msync(header, mapLen, MS_SYNC);
+			munmap(header, mapLen);
+		}
+		if (fd >= 0) ::close(fd);
+		header = NULL;
+		records = NULL;
+		fd = -1;
+		dirty = false;
+	}
+
+	// return 0 OK, -1 not open
+	int append(uint64_t timeMs, uint16_t source, int32_t id, int64_t value)
+	{
+		if (header == NULL) return -1;
+		Record &record = records[header->written % header->capacity];
+		record.timeMs = timeMs;
+		record.source = source;
+		record.reserved = 0;
+		record.id = id;
+		record.value = value;
+		header->written++; // after the record, a crash in between lose only this record
+		dirty = true;
+		return 0;
+	}
+
+	// call often, write back when there is something new and the interval passed
+	void flush(uint64_t nowMs)
+	{
+		if (flushDue(nowMs)) sync();
+	}
+
+	// true when there is something new and the interval passed, the caller then calls sync()
+	bool flushDue(uint64_t nowMs)
+	{
+		if (header == NULL || !dirty || nowMs - lastFlushMs < flushIntervalMs) return false;
+		dirty = false;
+		lastFlushMs = nowMs;
+		return true;
+	}
+
+	// write back the mapping and wait for it, MS_ASYNC only schedules on Linux where the pages
+	// already are in the page cache; safe while another thread appends, a record written meanwhile
+	// goes with the next batch
+	void sync()
+	{
+		if (header != NULL) msync(header, mapLen, MS_SYNC);
+	}
+
+	// visit the records at or after sinceMs oldest first, the record points into the mapping
+	// visitor: bool(const Record &record), return false to stop
+	template <typename Visitor>
+	void read(uint64_t sinceMs, Visitor visitor) const
+	{
+		if (header == NULL) return;
+		uint64_t count = header->written < header->capacity ? header->written : header->capacity;
+		for (uint64_t i = header->written - count; i < header->written; ++i)
+		{
+			const Record &record = records[i % header->capacity];
+			if (record.timeMs >= sinceMs && !visitor(record)) return;
+		}
+	}
+
+	uint64_t size() const
+	{
+		if (header == NULL) return 0;
+		return header->written < header->capacity ? header->written : header->capacity;
+	}
+
+private:
+	static const uint32_t Magic = 0x4C56454A; // "LVEJ"
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t recordSize;
+		uint32_t capacity; // records
+		uint32_t reserved0;
+		uint64_t written; // records ever appended, the next one goes to written % capacity
+		uint64_t reserved[5];
+	};
+
+	const uint64_t flushIntervalMs;
+	int fd = -1;
+	size_t mapLen = 0;
+	Header *header = NULL;
+	Record *records = NULL;
+	bool dirty = false;
+	uint64_t lastFlushMs = 0;
+};
+
+#endif // LV_EVENT_JOURNAL_H
@@ -0,0 +1,103 @@
+// #include "LvHdrHistogram.h"
+#ifndef LV_HDR_HISTOGRAM_H
+#define LV_HDR_HISTOGRAM_H
+
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <cstdint> // uint64_t
+#include <cstddef> // size_t
+
+// High dynamic range histogram of integer values (e.g. microseconds), log-linear buckets:
+// values below 2^subBucketBits are exact, above that every power of 2 is split in 2^(subBucketBits-1)
+// buckets, so a percentile is within 1 / 2^(subBucketBits-1) of the true value (1.6% with the default 7 bits)
+// over the whole range and the memory is fixed. Values above maxValue are counted at maxValue.
+// record() is a relaxed atomic add, safe at any thread, a reader sees a consistent enough snapshot.
+class LvHdrHistogram
+{
+public:
+	LvHdrHistogram(uint64_t _maxValue = 60000000, int _subBucketBits = 7)
+		: maxValue(_maxValue), subBucketBits(_subBucketBits),
+		  bucketCount(index(_maxValue) + 1), counts(new std::atomic<uint32_t>[bucketCount])
+	{
+		for (size_t i = 0; i < bucketCount; ++i) counts[i].store(0, std::memory_order_relaxed);
+	}
+
+	void record(uint64_t value)
+	{
+		if (value > maxValue) value = maxValue;
+		counts[index(value)].fetch_add(1, std::memory_order_relaxed);
+		total.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+		uint64_t seen = highest.load(std::memory_order_relaxed);
+		while (value > seen && !highest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+	}
+
+	// value at or below which percent of the records are, 0 when empty
+	uint64_t percentile(double percent) const
+	{
+		uint64_t count = total.load(std::memory_order_relaxed);
+		if (count == 0) return 0;
+		uint64_t target = (uint64_t)(percent / 100.0 * count + 0.5);
+		if (target < 1) target = 1;
+		uint64_t cumulative = 0;
+		for (size_t i = 0; i < bucketCount; ++i)
+		{
+			cumulative += counts[i].load(std::memory_order_relaxed);
+			if (cumulative >= target)
+			{
+				uint64_t value = highestEquivalent(i);
+				uint64_t max = highest.load(std::memory_order_relaxed);
+				return value < max ? value : max;
+			}
+		}
+		return highest.load(std::memory_order_relaxed);
+	}
+
+	uint64_t count() const
+	{
+		return total.load(std::memory_order_relaxed);
+	}
+
+	uint64_t max() const
+	{
+		return highest.load(std::memory_order_relaxed);
+	}
+
+	double mean() const
+	{
+		uint64_t count = total.load(std::memory_order_relaxed);
+		return count == 0 ? 0 : (double)sum.load(std::memory_order_relaxed) / count;
+	}
+
+private:
+	const uint64_t maxValue;
+	const int subBucketBits;
+	const size_t bucketCount;
+	std::unique_ptr<std::atomic<uint32_t>[]> counts;
+	std::atomic<uint64_t> total{0};
+	std::atomic<uint64_t> sum{0};
+	std::atomic<uint64_t> highest{0};
+
+	size_t index(uint64_t value) const
+	{
+		uint64_t subBucketCount = 1ULL << subBucketBits;
+		if (value < subBucketCount) return value;
+		int msb = 63 - __builtin_clzll(value);
+		int shift = msb - subBucketBits + 1; // mantissa keep subBucketBits bits, top one always set
+		uint64_t halfCount = subBucketCount >> 1;
+		return subBucketCount + (shift - 1) * halfCount + ((value >> shift) - halfCount);
+	}
+
+	// largest value that falls in the bucket
+	uint64_t highestEquivalent(size_t i) const
+	{
+		uint64_t subBucketCount = 1ULL << subBucketBits;
+		if (i < subBucketCount) return i;
+		uint64_t halfCount = subBucketCount >> 1;
+		int shift = (i - subBucketCount) / halfCount + 1;
+		uint64_t mantissa = (i - subBucketCount) % halfCount + halfCount;
+		return ((mantissa + 1) << shift) - 1;
+	}
+};
+
+#endif // LV_HDR_HISTOGRAM_H
@@ -0,0 +1,160 @@
+// #include "LvHttpCapture.h"
+#ifndef LV_HTTP_CAPTURE_H
+#define LV_HTTP_CAPTURE_H
+
+#include <string>
+#include <cstdint> // uint64_t
+#include <zlib.h> // gzopen
+
+// Capture file of HTTP exchanges: one gzip stream of binary records written as the answers come
+// (time, duration, status, host, body), read back in the same order. Same JSON answers of a camera
+// compress well, a day of polls of a junction is a few MB. Reopening for write appends a new gzip member
+// with its own file header, gzread reads the members one after the other.
+// Host byte order, a capture is read back on the same kind of machine it was taken on.
+class LvHttpCapture
+{
+public:
+	struct Record
+	{
+		uint64_t timeMs;     // wall time the request was sent
+		uint32_t durationUs; // request to answer
+		int32_t status;      // HTTP status, 0 when there was no answer (refused, timeout)
+		std::string host;
+		std::string body;
+	};
+
+	~LvHttpCapture()
+	{
+		close();
+	}
+
+	// return 0 OK, -1 cannot open
+	int openWrite(const std::string &filepath)
+	{
+		close();
+		file = gzopen(filepath.c_str(), "ab6");
+		if (file == NULL) return -1;
+		FileHeader header = {FileMagic, Version, 0};
+		if (gzwrite(file, &header, sizeof(header)) != (int)sizeof(header))
+		{
+			close();
+			return -1;
+		}
+		return 0;
+	}
+
+	// return 0 OK, -1 cannot open or not a capture
+	int openRead(const std::string &filepath)
+	{
+		close();
+		file = gzopen(filepath.c_str(), "rb");
+		if (file == NULL) return -1;
+		FileHeader header;
+		if (gzread(file, &header, sizeof(header)) != (int)sizeof(header) || header.magic != FileMagic || header.version != Version)
+		{
+			close();
+			return -1;
+		}
+		return 0;
+	}
+
+	// return 0 OK, -1 not open or write error
+	int write(const Record &record)
+	{
+		if (file == NULL) return -1;
+		RecordHeader header;
+		header.magic = RecordMagic;
+		header.durationUs = record.durationUs;
+		header.timeMs = record.timeMs;
+		header.status = record.status;
+		header.hostLen = record.host.size() > UINT16_MAX ? UINT16_MAX : record.host.size();
+		header.reserved = 0;
+		header.bodyLen = record.body.size();
+		header.reserved2 = 0;
+		if (gzwrite(file, &header, sizeof(header)) != (int)sizeof(header)) return -1;
+		if (header.hostLen > 0 && gzwrite(file, record.host.data(), header.hostLen) != (int)header.hostLen) return -1;
+		if (header.bodyLen > 0 && gzwrite(file, record.body.data(), header.bodyLen) != (int)header.bodyLen) return -1;
+		return 0;
+	}
+
+	// return 1 a record read, 0 end of the capture, -1 not open or corrupt (a cut last record reads as the end)
+	int read(Record &record)
+	{
+		if (file == NULL) return -1;
+		for (;;)
+		{
+			uint32_t magic;
+			int n = gzread(file, &magic, sizeof(magic));
+			if (n == 0) return 0;
+			if (n != (int)sizeof(magic)) return gzeof(file) ? 0 : -1;
+			if (magic == FileMagic) // header of an appended member
+			{
+				FileHeader header;
+				header.magic = magic;
+				size_t rest = sizeof(header) - sizeof(magic);
+				if (gzread(file, (char *)&header + sizeof(magic), rest) != (int)rest) return gzeof(file) ? 0 : -1;
+				if (header.version != Version) return -1;
+				continue;
+			}
+			if (magic != RecordMagic) return -1;
+			RecordHeader header;
+			header.magic = magic;
+			size_t rest = sizeof(header) - sizeof(magic);
+			if (gzread(file, (char *)&header + sizeof(magic), rest) != (int)rest) return gzeof(file) ? 0 : -1;
+			record.timeMs = header.timeMs;
+			record.durationUs = header.durationUs;
+			record.status = header.status;
+			record.host.resize(header.hostLen);
+			record.body.resize(header.bodyLen);
+			if (header.hostLen > 0 && gzread(file, &record.host[0], header.hostLen) != (int)header.hostLen) return gzeof(file) ? 0 : -1;
+			if (header.bodyLen > 0 && gzread(file, &record.body[0], header.bodyLen) != (int)header.bodyLen) return gzeof(file) ? 0 : -1;
+			return 1;
+		}
+	}
+
+	// hands the buffered records to the file so a crash keeps them, costs some compression, not per record
+	void flush()
+	{
+		if (file != NULL) gzflush(file, Z_SYNC_FLUSH);
+	}
+
+	void close()
+	{
+		if (file == NULL) return;
+		gzclose(file);
+		file = NULL;
+	}
+
+	bool isOpen() const
+	{
+		return file != NULL;
+	}
+
+private:
+	static const uint32_t FileMagic = 0x4348564c; // "LVHC"
+	static const uint32_t RecordMagic = 0x5248564c; // "LVHR"
+	static const uint16_t Version = 1;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+	};
+
+	struct RecordHeader
+	{
+		uint32_t magic;
+		uint32_t durationUs;
+		uint64_t timeMs;
+		int32_t status;
+		uint16_t hostLen;
+		uint16_t reserved;
+		uint32_t bodyLen;
+		uint32_t reserved2;
+	};
+
+	gzFile file = NULL;
+};
+
+#endif // LV_HTTP_CAPTURE_H
@@ -0,0 +1,400 @@
+// #include "LvLog.h"
+#ifndef LV_LOG_H
+#define LV_LOG_H
+
+#include "LvSPSCQueue.h"
+#include <string>
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm> // std::stable_sort
+#include <type_traits> // std::enable_if
+#include <cstdio> // fwrite, fflush
+#include <cstring> // memcpy, strlen
+#include <cstdint> // uint64_t
+#include <ctime> // localtime_r, strftime
+
+#define LV_LOG_LEVEL_ERROR 1
+#define LV_LOG_LEVEL_WARN 2
+#define LV_LOG_LEVEL_INFO 3
+#define LV_LOG_LEVEL_DEBUG 4
+
+// build with -DLV_LOG_LEVEL=3 to leave the debug lines out of the binary
+#ifndef LV_LOG_LEVEL
+#define LV_LOG_LEVEL LV_LOG_LEVEL_DEBUG
+#endif
+
+// LV_LOG_INFO("Camera {} count {}", ip, count), each {} is replaced by the next argument
+#define LV_LOG(level, ...) do { if ((level) <= LV_LOG_LEVEL) LvLog::instance().write((level), __VA_ARGS__); } while (0)
+#define LV_LOG_ERROR(...) LV_LOG(LV_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LV_LOG_WARN(...) LV_LOG(LV_LOG_LEVEL_WARN, __VA_ARGS__)
+#define LV_LOG_INFO(...) LV_LOG(LV_LOG_LEVEL_INFO, __VA_ARGS__)
+#define LV_LOG_DEBUG(...) LV_LOG(LV_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Logger that never blocks the caller on the console.
+// Each thread has its own lock-free ring, a log call only copies the format pointer and the
+// raw arguments into it. A background thread formats the lines, writes them in time order
+// (error and warn to stderr, the rest to stdout) and flushes once per batch.
+// When a ring is full the line is dropped and counted, the caller never waits.
+// The format must be a string literal, the arguments are copied (strings truncated to fit the record).
+class LvLog
+{
+public:
+	static LvLog &instance()
+	{
+		static LvLog log;
+		return log;
+	}
+
+	// argument printed in hex, LV_LOG_DEBUG("address {}", LvLog::Hex(0x20)) gives "address 20"
+	struct Hex
+	{
+		uint64_t value;
+		explicit Hex(uint64_t _value) : value(_value) {}
+	};
+
+	template <typename... Args>
+	void write(int level, const char *fmt, const Args &... args)
+	{
+		ThreadRing &ring = threadRing();
+		Record *record = ring.queue.claim();
+		if (record == NULL)
+		{
+			ring.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		record->timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		                     std::chrono::system_clock::now().time_since_epoch()).count();
+		record->fmt = fmt;
+		record->level = level;
+		record->used = 0;
+		int expand[] = {0, (put(*record, args), 0)...};
+		(void)expand;
+		ring.queue.publish();
+	}
+
+	// wait until the lines logged so far are written, up to timeoutMs
+	void flush(uint64_t timeoutMs = 1000)
+	{
+		for (uint64_t waited = 0; waited < timeoutMs; waited += 5)
+		{
+			bool empty = true;
+			{
+				std::lock_guard<std::mutex> lock(ringsMtx);
+				for (const auto &ring : rings) empty = empty && ring->queue.empty();
+			}
+			if (empty) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		std::lock_guard<std::mutex> lock(writeMtx); // the last batch is being written
+	}
+
+private:
+	enum ArgType : uint8_t
+	{
+		ArgInt,
+		ArgUint,
+		ArgDouble,
+		ArgBool,
+		ArgChar,
+		ArgHex,
+		ArgString,
+	};
+
+	struct Record
+	{
+		uint64_t timeMs;
+		const char *fmt;
+		uint8_t level;
+		uint16_t used; // bytes of args
+		char args[256 - 8 - sizeof(const char*) - 4]; // [type][value], string value is [uint16 len][bytes]
+	};
+
+	struct ThreadRing
+	{
+		LvSPSCQueue<Record, 256> queue; // 64 KB per thread
+		std::atomic<uint32_t> dropped{0};
+		std::atomic<bool> closed{false}; // thread ended, removed once drained
+	};
+
+	// registered at the first log of a thread, closed when the thread ends
+	struct RingHolder
+	{
+		std::shared_ptr<ThreadRing> ring;
+		RingHolder(LvLog &log)
+			: ring(std::make_shared<ThreadRing>())
+		{
+			log.addRing(ring);
+		}
+		~RingHolder()
+		{
+			ring->closed = true;
+		}
+	};
+
+	struct Line
+	{
+		uint64_t timeMs;
+		int level;
+		std::string text;
+	};
+
+	std::vector<std::shared_ptr<ThreadRing>> rings;
+	std::mutex ringsMtx; // only taken when a thread starts logging and by the writer
+	std::mutex writeMtx; // held by the writer while a batch is out, flush() waits on it
+	std::thread writerThread;
+	std::atomic<bool> running{false};
+
+	LvLog() {}
+	~LvLog()
+	{
+		if (running)
+		{
+			running = false;
+			writerThread.join();
+		}
+		drain();
+	}
+
+	ThreadRing &threadRing()
+	{
+		thread_local RingHolder holder(*this);
+		return *holder.ring;
+	}
+
+	void addRing(const std::shared_ptr<ThreadRing> &ring)
+	{
+		std::lock_guard<std::mutex> lock(ringsMtx);
+		rings.push_back(ring);
+		if (!running)
+		{
+			running = true;
+			writerThread = std::thread(&LvLog::run, this);
+		}
+	}
+
+	void run()
+	{
+		while (running)
+		{
+			if (drain() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	}
+
+	// format and write what the rings hold, return the number of lines
+	size_t drain()
+	{
+		std::vector<std::shared_ptr<ThreadRing>> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(ringsMtx);
+			snapshot = rings;
+		}
+
+		std::lock_guard<std::mutex> writeLock(writeMtx);
+		std::vector<Line> lines;
+		for (const auto &ring : snapshot)
+		{
+			uint32_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+			if (dropped > 0)
+			{
+				uint64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+				                     std::chrono::system_clock::now().time_since_epoch()).count();
+				lines.push_back({0, LV_LOG_LEVEL_WARN, // sorted first, before the lines of this batch
+				                 prefix(nowMs, LV_LOG_LEVEL_WARN) + std::to_string(dropped) + " log lines dropped, ring full\n"});
+			}
+			Record *record;
+			while ((record = ring->queue.front()) != NULL)
+			{
+				lines.push_back({record->timeMs, record->level, format(*record)});
+				ring->queue.release();
+			}
+		}
+		if (lines.empty())
+		{
+			removeClosedRings();
+			return 0;
+		}
+
+		// each ring is in order, merge the threads by time
+		std::stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b)
+		{
+			return a.timeMs < b.timeMs;
+		});
+		for (const auto &line : lines)
+		{
+			FILE *out = line.level <= LV_LOG_LEVEL_WARN ? stderr : stdout;
+			fwrite(line.text.data(), 1, line.text.size(), out);
+		}
+		fflush(stdout);
+		fflush(stderr);
+		return lines.size();
+	}
+
+	void removeClosedRings()
+	{
+		std::lock_guard<std::mutex> lock(ringsMtx);
+		rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<ThreadRing> &ring)
+		{
+			return ring->closed && ring->queue.empty();
+		}), rings.end());
+	}
+
+	// encode, an argument that does not fit is left out
+	static bool reserve(Record &record, size_t size)
+	{
+		return record.used + size <= sizeof(record.args);
+	}
+
+	template <typename T>
+	static void putRaw(Record &record, ArgType type, T value)
+	{
+		if (!reserve(record, 1 + sizeof(value))) return;
+		record.args[record.used] = type;
+		memcpy(record.args + record.used + 1, &value, sizeof(value));
+		record.used += 1 + sizeof(value);
+	}
+
+	static void putString(Record &record, const char *str, size_t len)
+	{
+		if (!reserve(record, 3)) return;
+		uint16_t fit = std::min(len, sizeof(record.args) - record.used - 3);
+		record.args[record.used] = ArgString;
+		memcpy(record.args + record.used + 1, &fit, sizeof(fit));
+		memcpy(record.args + record.used + 3, str, fit);
+		record.used += 3 + fit;
+	}
+
+	static void put(Record &record, bool value)
+	{
+		putRaw(record, ArgBool, (uint8_t)value);
+	}
+
+	static void put(Record &record, char value)
+	{
+		putRaw(record, ArgChar, value);
+	}
+
+	template <typename T>
+	static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type put(Record &record, T value)
+	{
+		putRaw(record, ArgInt, (int64_t)value);
+	}
+
+	template <typename T>
+	static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type put(Record &record, T value)
+	{
+		putRaw(record, ArgUint, (uint64_t)value);
+	}
+
+	template <typename T>
+	static typename std::enable_if<std::is_floating_point<T>::value>::type put(Record &record, T value)
+	{
+		putRaw(record, ArgDouble, (double)value);
+	}
+
+	static void put(Record &record, Hex value)
+	{
+		putRaw(record, ArgHex, value.value);
+	}
+
+	static void put(Record &record, const char *value)
+	{
+		putString(record, value, strlen(value));
+	}
+
+	static void put(Record &record, const std::string &value)
+	{
+		putString(record, value.data(), value.size());
+	}
+
+	// decode, at the writer thread
+	// "12:34:56.789 I "
+	static std::string prefix(uint64_t timeMs, int level)
+	{
+		char stamp[32];
+		time_t seconds = timeMs / 1000;
+		struct tm local;
+		localtime_r(&seconds, &local);
+		size_t n = strftime(stamp, sizeof(stamp), "%H:%M:%S", &local);
+		snprintf(stamp + n, sizeof(stamp) - n, ".%03d %c ", (int)(timeMs % 1000), "?EWID"[level <= LV_LOG_LEVEL_DEBUG ? level : 0]);
+		return stamp;
+	}
+
+	static std::string format(const Record &record)
+	{
+		std::string text = prefix(record.timeMs, record.level);
+		size_t offset = 0;
+		for (const char *p = record.fmt; *p; ++p)
+		{
+			if (p[0] == '{' && p[1] == '}' && offset < record.used)
+			{
+				offset += appendArg(text, record.args + offset);
+				++p;
+				continue;
+			}
+			text += *p;
+		}
+		text += '\n';
+		return text;
+	}
+
+	// return the bytes used by the argument
+	static size_t appendArg(std::string &text, const char *arg)
+	{
+		char buf[32];
+		switch (arg[0])
+		{
+		case ArgInt:
+		{
+			int64_t value;
+			memcpy(&value, arg + 1, sizeof(value));
+			snprintf(buf, sizeof(buf), "%lld", (long long)value);
+			text += buf;
+			return 1 + sizeof(value);
+		}
+		case ArgUint:
+		{
+			uint64_t value;
+			memcpy(&value, arg + 1, sizeof(value));
+			snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+			text += buf;
+			return 1 + sizeof(value);
+		}
+		case ArgHex:
+		{
+			uint64_t value;
+			memcpy(&value, arg + 1, sizeof(value));
+			snprintf(buf, sizeof(buf), "%llx", (unsigned long long)value);
+			text += buf;
+			return 1 + sizeof(value);
+		}
+		case ArgDouble:
+		{
+			double value;
+			memcpy(&value, arg + 1, sizeof(value));
+			snprintf(buf, sizeof(buf), "%g", value);
+			text += buf;
+			return 1 + sizeof(value);
+		}
+		case ArgBool:
+			text += arg[1] ? "1" : "0"; // same as std::cout
+			return 2;
+		case ArgChar:
+			text += arg[1];
+			return 2;
+		case ArgString:
+		default:
+		{
+			uint16_t len;
+			memcpy(&len, arg + 1, sizeof(len));
+			text.append(arg + 3, len);
+			return 3 + len;
+		}
+		}
+	}
+};
+
+#endif // LV_LOG_H
@@ -0,0 +1,72 @@
+// #include "LvMPSCQueue.h"
+#ifndef LV_MPSC_QUEUE_H
+#define LV_MPSC_QUEUE_H
+
+#include <atomic> // std::atomic
+#include <cstddef> // size_t
+#include <cstdint> // intptr_t
+#include <utility> // std::move
+
+// Bounded lock-free queue, many threads can push, only one thread can pop.
+// Each slot carries a sequence number so a producer knows when the slot is free
+// and the consumer knows when the slot is filled (Vyukov bounded queue).
+// Capacity must be power of 2.
+template <typename T, size_t Capacity>
+class LvMPSCQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of 2");
+public:
+	LvMPSCQueue()
+	{
+		for (size_t i = 0; i < Capacity; ++i)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		enqueuePos.store(0, std::memory_order_relaxed);
+		dequeuePos = 0;
+	}
+
+	// safe to call at any thread, return false when full
+	bool push(T &&data)
+	{
+		Cell *cell;
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[pos & (Capacity - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+			if (dif == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (dif < 0) return false; // full
+			else pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+		cell->data = std::move(data);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// only call at the consumer thread, return false when empty
+	bool pop(T &data)
+	{
+		Cell *cell = &cells[dequeuePos & (Capacity - 1)];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		if ((intptr_t)seq - (intptr_t)(dequeuePos + 1) < 0) return false; // empty
+		data = std::move(cell->data);
+		cell->sequence.store(dequeuePos + Capacity, std::memory_order_release);
+		dequeuePos++;
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+	Cell cells[Capacity];
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) size_t dequeuePos; // consumer only
+};
+
+#endif // LV_MPSC_QUEUE_H
@@ -115,6 +115,7 @@ private:
 	void* onMessageCallbackSelf = NULL;
 	void* onConnectedCallbackSelf = NULL;
 	uint64_t PingreqTick = 0;
+	uint32_t pubackCount = 0; // PUBACK received and not yet taken
 
 	static void fn(struct mg_connection *c, int ev, void *ev_data)
 	{
@@ -142,6 +143,11 @@ private:
 				client.onConnectedCallback(client.onConnectedCallbackSelf, &client, client.option.url);
 			}
 		}
+		else if (ev == MG_EV_MQTT_CMD)
+		{
+			struct mg_mqtt_message *mm = (struct mg_mqtt_message *) ev_data;
+			if (mm->cmd == MQTT_CMD_PUBACK) ((Client*)c->fn_data)->pubackCount++;
+		}
 		else if (ev == MG_EV_MQTT_MSG)
 		{
 			// When we get echo response, print it
@@ -285,6 +291,14 @@ public:
 		return status;
 	}
 
+	// PUBACK received since the last call, the broker acknowledge QoS 1 publish in the order they are sent
+	uint32_t takePubacks()
+	{
+		uint32_t count = pubackCount;
+		pubackCount = 0;
+		return count;
+	}
+
 	void close()
 	{
 		closing = true;
@@ -304,6 +318,12 @@ public:
 	{
 		CreateClient(); // bootstrap
 	}
+	// connect straight to url, no bootstrap on the default host
+	LvMQTTClient(const std::string &url, const std::string &client_id = "")
+		: mqtt_url(url), optclient_id(client_id)
+	{
+		CreateClient();
+	}
 	~LvMQTTClient()
 	{
 		DeleteClient();
@@ -337,14 +357,28 @@ public:
 		return 0;
 	}
 
-	int pub(std::string topic, std::string payload)
+	// qos 1 is acknowledged through take_puback(), what is queued or in flight is lost when the connection drops
+	int pub(std::string topic, std::string payload, int qos = 0)
 	{
 		if (client == NULL) return -1;
 		if (client->getStatus() != LvMqttClient::StatusConnected) return -2;
-		if (client->pub(LvMqttClient::PublishOption(topic, payload, 0, false)) != 0) return -3;
+		if (client->pub(LvMqttClient::PublishOption(topic, payload, qos, false)) != 0) return -3;
 		return 0;
 	}
 
+	// PUBACK of the current connection received since the last call, same thread as loop()
+	uint32_t take_puback()
+	{
+		if (client == NULL) return 0;
+		return client->takePubacks();
+	}
+
+	// number of successful connections so far, a change means the previous one and its unacknowledged publish are gone
+	uint64_t connected_count()
+	{
+		return connected;
+	}
+
 	int sub(std::string topic)
 	{
 		if (std::find(subtopiclist.begin(), subtopiclist.end(), topic) != subtopiclist.end()) return -1;
@@ -421,6 +455,7 @@ private:
 
 	uint64_t connect_tick;
 	uint64_t delay_connect = 125;
+	uint64_t connected = 0;
 
 	std::vector<std::string> subtopiclist;
 	std::queue<std::pair<std::string, std::string>> mqtt_queue_sub;
@@ -467,6 +502,7 @@ private:
 		LvMQTTClient &Self = *((LvMQTTClient*)self);
 
 		Self.delay_connect = 125;
+		Self.connected++;
 
 		// printf("[onConnectedCallback] Connected to %s\n", url.c_str());
 		for (int i = 0; i < (signed)Self.subtopiclist.size(); ++i)
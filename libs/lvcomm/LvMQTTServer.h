@@ -5,6 +5,7 @@
 #include <vector> // std::vector
 #include <utility> // std::pair
 #include <queue> // std::queue
+#include <map> // std::map
 #include <string> // std::string
 #include <algorithm> // std::find
 #include <cstdlib> // exit
@@ -12,8 +13,25 @@
 #include <cstdint> // uint64_t
 #include <iostream> // std::cout
 #include <string> // std::string
+#include <thread> // std::thread
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <unistd.h> // read, write, close
+#include <sys/epoll.h> // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/eventfd.h> // eventfd
 #include "mongoose.h"
-
+#include "LvMPSCQueue.h"
+#include "LvTrace.h"
+
+#ifndef LV_MQTT_SEND_SOFT_LIMIT
+#define LV_MQTT_SEND_SOFT_LIMIT (64 * 1024) // subscriber send buffer bytes, above it state messages wait for it to drain, latest wins
+#endif
+#ifndef LV_MQTT_SEND_HARD_LIMIT
+#define LV_MQTT_SEND_HARD_LIMIT (1024 * 1024) // subscriber send buffer bytes, above it event messages to it are dropped
+#endif
+#ifndef LV_MQTT_PUT_OVERFLOW_LIMIT
+#define LV_MQTT_PUT_OVERFLOW_LIMIT 4096 // event messages kept aside when the put queue is full
+#endif
 
 namespace LvMqttServer
 {
@@ -22,12 +40,15 @@ class HostOption
 {
 public:
 	HostOption(std::string listeningAddress = "",
-	           const uint64_t connLimit = 0)
+	           const uint64_t connLimit = 0,
+	           std::string wsListeningAddress = "")
 		: listeningAddress(listeningAddress),
-		  connLimit(connLimit)
+		  connLimit(connLimit),
+		  wsListeningAddress(wsListeningAddress)
 	{}
 	const std::string listeningAddress;
 	const uint64_t connLimit;
+	const std::string wsListeningAddress; // MQTT over websocket at /mqtt, empty to disable
 };
 class Server
 {
@@ -44,9 +65,13 @@ private:
 	struct sub *s_subs = NULL;
 	OnMessageCallback onMessageCallback = NULL;
 	void *onMessageCallbackDataPtr = NULL;
+	struct mg_connection *publisher = NULL; // connection of the message being passed to onMessageCallback
 
-	struct mg_str pub_str_topic, pub_str_pay;
-	std::queue<std::pair<std::string, std::string>> pubQueue;
+	std::queue<std::pair<std::string, std::string>> pubQueue; // event topics, FIFO
+	std::vector<std::pair<std::string, std::string>> stateQueue; // state topics, one pending slot per topic, latest wins
+	std::map<unsigned long, std::string> wsRecv; // websocket connection id, bytes of incomplete mqtt packet, at most MG_MAX_RECV_SIZE
+	std::map<unsigned long, std::vector<std::pair<std::string, std::string>>> stateHeld; // connection id, state messages waiting for its send buffer, one per topic
+	std::atomic<uint64_t> sendDropped{0}; // event messages not written, subscriber send buffer over LV_MQTT_SEND_HARD_LIMIT
 
 	static void fn(struct mg_connection *c, int ev, void *ev_data)
 	{
@@ -78,165 +103,309 @@ private:
 		break;
 		case MG_EV_MQTT_CMD: // 14
 		{
-			struct mg_mqtt_message *mm = (struct mg_mqtt_message *) ev_data;
-			MG_INFO(("cmd %d qos %d", mm->cmd, mm->qos));
-			switch (mm->cmd)
-			{
-			default:
-				break;
-			case MQTT_CMD_PINGREQ:
-			{
-				mg_mqtt_pong(c);
-			}
+			handleCmd(c, (struct mg_mqtt_message *) ev_data);
+		}
+		break;
+		case MG_EV_MQTT_OPEN: // 16
+		{
+
+		}
+		break;
+		case MG_EV_POLL: // 2
+		{
+			((Server*)c->fn_data)->flush();
+			((Server*)c->fn_data)->flushHeld(c);
+		}
+		break;
+		case MG_EV_CLOSE: // 9
+		{
+			removeSubs(c);
+		}
+		break;
+		}
+	}
+
+	// handle a parsed MQTT packet, from tcp or websocket connection
+	static void handleCmd(struct mg_connection *c, struct mg_mqtt_message *mm)
+	{
+		MG_INFO(("cmd %d qos %d", mm->cmd, mm->qos));
+		size_t from = c->send.len; // reply to c start here
+		switch (mm->cmd)
+		{
+		default:
 			break;
-			case MQTT_CMD_CONNECT:
+		case MQTT_CMD_PINGREQ:
+		{
+			mg_mqtt_pong(c);
+			wsWrap(c, from);
+		}
+		break;
+		case MQTT_CMD_CONNECT:
+		{
+			// Client connects
+			if (mm->dgram.len < 9) {
+				mg_error(c, "Malformed MQTT frame");
+			}
+			else if (mm->dgram.ptr[8] != 4) // Please use mqtt 3.1.1 // if want to use mosquitto_p/sub please give -V mqttv311
 			{
-				// Client connects
-				if (mm->dgram.len < 9) {
-					mg_error(c, "Malformed MQTT frame");
-				}
-				else if (mm->dgram.ptr[8] != 4) // Please use mqtt 3.1.1 // if want to use mosquitto_p/sub please give -V mqttv311
-				{
-					mg_error(c, "Unsupported MQTT version %d", mm->dgram.ptr[8]);
-				}
-				else
-				{
-					uint8_t response[] = {0, 0};
-					mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
-					mg_send(c, response, sizeof(response));
-				}
+				mg_error(c, "Unsupported MQTT version %d", mm->dgram.ptr[8]);
 			}
-			break;
-			case MQTT_CMD_SUBSCRIBE:
+			else
 			{
-				size_t pos = 4;  // Initial topic offset, where ID ends
-				uint8_t qos, resp[256];
-				struct mg_str topic;
-				int num_topics = 0;
-
-				// decode qos, topic, num_topics
-				while (pos < mm->dgram.len)
-				{
-					uint16_t topic_length = mg_ntohs(*(uint16_t*)(mm->dgram.ptr + pos));
-					pos += 2;
+				uint8_t response[] = {0, 0};
+				mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
+				mg_send(c, response, sizeof(response));
+				wsWrap(c, from);
+			}
+		}
+		break;
+		case MQTT_CMD_SUBSCRIBE:
+		{
+			size_t pos = 4;  // Initial topic offset, where ID ends
+			uint8_t qos, resp[256];
+			struct mg_str topic;
+			int num_topics = 0;
 
-					topic.len = topic_length;
+			// decode qos, topic, num_topics
+			while (pos < mm->dgram.len)
+			{
+				uint16_t topic_length = mg_ntohs(*(uint16_t*)(mm->dgram.ptr + pos));
+				pos += 2;
 
-					topic.ptr = mm->dgram.ptr + pos;
-					pos += topic_length;
+				topic.len = topic_length;
 
-					uint8_t qos = *(uint8_t*)(mm->dgram.ptr + pos);
-					pos += 1;
+				topic.ptr = mm->dgram.ptr + pos;
+				pos += topic_length;
 
-					resp[num_topics++] = qos;
-					// Process the extracted topic and qos
+				uint8_t qos = *(uint8_t*)(mm->dgram.ptr + pos);
+				pos += 1;
 
-					MG_INFO(("SUB %p [%.*s]", c->fd, (int) topic.len, topic.ptr));
+				resp[num_topics++] = qos;
+				// Process the extracted topic and qos
 
-					struct sub *sub = (struct sub*) calloc(1, sizeof(*sub));
-					sub->c = c;
-					sub->topic = mg_strdup(topic);
-					sub->qos = qos;
-					LIST_ADD_HEAD(struct sub, &((Server*)c->fn_data)->s_subs, sub);
+				MG_INFO(("SUB %p [%.*s]", c->fd, (int) topic.len, topic.ptr));
 
-					// Change '+' to '*' for topic matching using mg_globmatch
-					for (size_t i = 0; i < sub->topic.len; i++) {
-						if (sub->topic.ptr[i] == '+') ((char *) sub->topic.ptr)[i] = '*';
-					}
+				struct sub *sub = (struct sub*) calloc(1, sizeof(*sub));
+				sub->c = c;
+				sub->topic = mg_strdup(topic);
+				sub->qos = qos;
+				LIST_ADD_HEAD(struct sub, &((Server*)c->fn_data)->s_subs, sub);
 
+				// Change '+' to '*' for topic matching using mg_globmatch
+				for (size_t i = 0; i < sub->topic.len; i++) {
+					if (sub->topic.ptr[i] == '+') ((char *) sub->topic.ptr)[i] = '*';
 				}
-				mg_mqtt_send_header(c, MQTT_CMD_SUBACK, 0, num_topics + 2);
-				uint16_t id = mg_htons(mm->id);
-				mg_send(c, &id, 2);
-				mg_send(c, resp, num_topics);
+
 			}
-			break;
-			case MQTT_CMD_PUBLISH:
-			{
-				// Client published message. Push to all subscribed channels
-				MG_INFO(("PUB %p [%.*s] -> [%.*s]", c->fd, (int) mm->data.len,
-				         mm->data.ptr, (int) mm->topic.len, mm->topic.ptr));
+			mg_mqtt_send_header(c, MQTT_CMD_SUBACK, 0, num_topics + 2);
+			uint16_t id = mg_htons(mm->id);
+			mg_send(c, &id, 2);
+			mg_send(c, resp, num_topics);
+			wsWrap(c, from);
+		}
+		break;
+		case MQTT_CMD_PUBLISH:
+		{
+			// Client published message. Push to all subscribed channels
+			MG_INFO(("PUB %p [%.*s] -> [%.*s]", c->fd, (int) mm->data.len,
+			         mm->data.ptr, (int) mm->topic.len, mm->topic.ptr));
 
-				Server &server = *((Server*)c->fn_data);
+			Server &server = *((Server*)c->fn_data);
 
-				for (struct sub *sub = server.s_subs; sub != NULL; sub = sub->next)
+			for (struct sub *sub = server.s_subs; sub != NULL; sub = sub->next)
+			{
+				if (mg_globmatch(sub->topic.ptr, sub->topic.len, mm->topic.ptr, mm->topic.len))
 				{
-					if (mg_globmatch(sub->topic.ptr, sub->topic.len, mm->topic.ptr, mm->topic.len))
-					{
-						struct mg_mqtt_opts pub_opts;
-						memset(&pub_opts, 0, sizeof(pub_opts));
-						pub_opts.topic = mm->topic;
-						pub_opts.message = mm->data;
-						pub_opts.qos = 1;
-						pub_opts.retain = false;
-						mg_mqtt_pub(sub->c, &pub_opts);
-					}
+					struct mg_mqtt_opts pub_opts;
+					memset(&pub_opts, 0, sizeof(pub_opts));
+					pub_opts.topic = mm->topic;
+					pub_opts.message = mm->data;
+					pub_opts.qos = 1;
+					pub_opts.retain = false;
+					size_t subFrom = sub->c->send.len;
+					mg_mqtt_pub(sub->c, &pub_opts);
+					wsWrap(sub->c, subFrom);
 				}
+			}
 
-				if (server.onMessageCallback != NULL)
-				{
-					server.onMessageCallback(server.onMessageCallbackDataPtr,
-					                         std::string(mm->topic.ptr, mm->topic.len),
-					                         std::string(mm->data.ptr, mm->data.len));
-				}
+			if (server.onMessageCallback != NULL)
+			{
+				server.publisher = c;
+				server.onMessageCallback(server.onMessageCallbackDataPtr,
+				                         std::string(mm->topic.ptr, mm->topic.len),
+				                         std::string(mm->data.ptr, mm->data.len));
+				server.publisher = NULL;
+			}
 
 
-			}
+		}
+		break;
+		}
+	}
+
+	static void removeSubs(struct mg_connection *c)
+	{
+		Server &server = *((Server*)c->fn_data);
+		server.stateHeld.erase(c->id);
+		for (struct sub * next, *sub = server.s_subs; sub != NULL; sub = next) {
+			next = sub->next;
+			if (c != sub->c) continue;
+			MG_INFO(("UNSUB %p [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr));
+			LIST_DELETE(struct sub, &server.s_subs, sub);
+		}
+	}
+
+	// MQTT over websocket, the packets are carried in binary frames at /mqtt
+	static void wsfn(struct mg_connection *c, int ev, void *ev_data)
+	{
+		switch (ev)
+		{
+		default:
 			break;
+		case MG_EV_ACCEPT:
+		{
+			uint64_t ConnLimit = ((Server*)c->fn_data)->hostOption.connLimit;
+			if (ConnLimit == 0); // do nothing when 0
+			else if (numconns(c->mgr) > ConnLimit) {
+				MG_ERROR(("Too many connections"));
+				c->is_closing = 1; // Close this connection when the response is sent
 			}
 		}
 		break;
-		case MG_EV_MQTT_OPEN: // 16
+		case MG_EV_HTTP_MSG:
 		{
-
+			struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+			if (!mg_http_match_uri(hm, "/mqtt"))
+			{
+				mg_http_reply(c, 404, "", "Not Found\n");
+				break;
+			}
+			mg_ws_upgrade(c, hm, NULL); // the requested subprotocol (mqtt) is echoed back by mongoose
 		}
 		break;
-		case MG_EV_POLL: // 2
+		case MG_EV_POLL:
+		{
+			((Server*)c->fn_data)->flushHeld(c);
+		}
+		break;
+		case MG_EV_WS_MSG:
 		{
 			Server &server = *((Server*)c->fn_data);
-			while (!server.pubQueue.empty())
+			struct mg_ws_message *wm = (struct mg_ws_message *) ev_data;
+			std::string &pending = server.wsRecv[c->id];
+			// same bound as the tcp receive buffer, a packet that never completes cannot grow the broker
+			if (pending.size() + wm->data.len > MG_MAX_RECV_SIZE)
+			{
+				MG_ERROR(("%lu MQTT packet over %lu bytes, closing", c->id, (unsigned long) MG_MAX_RECV_SIZE));
+				pending.clear();
+				c->is_closing = 1;
+				break;
+			}
+			pending.append(wm->data.ptr, wm->data.len);
+
+			size_t pos = 0;
+			while (pos < pending.size())
 			{
-				server.pub_str_topic.ptr = server.pubQueue.front().first.c_str();
-				server.pub_str_topic.len = server.pubQueue.front().first.size();
-				server.pub_str_pay.ptr = server.pubQueue.front().second.c_str();
-				server.pub_str_pay.len = server.pubQueue.front().second.size();
-				for (struct sub *sub = server.s_subs; sub != NULL; sub = sub->next)
+				struct mg_mqtt_message mm;
+				int rc = mg_mqtt_parse((const uint8_t*)pending.data() + pos, pending.size() - pos, 4, &mm);
+				if (rc == MQTT_MALFORMED)
+				{
+					MG_ERROR(("%lu MQTT malformed message", c->id));
+					c->is_closing = 1;
+					break;
+				}
+				if (rc != MQTT_OK) break; // wait for the rest of the packet
+
+				if (mm.cmd == MQTT_CMD_PUBLISH && mm.qos > 0)
 				{
-					if (mg_globmatch(sub->topic.ptr, sub->topic.len, server.pub_str_topic.ptr, server.pub_str_topic.len))
-					{
-						struct mg_mqtt_opts pub_opts;
-						memset(&pub_opts, 0, sizeof(pub_opts));
-						pub_opts.topic = server.pub_str_topic;
-						pub_opts.message = server.pub_str_pay;
-						pub_opts.qos = 0;
-						pub_opts.retain = false;
-						mg_mqtt_pub(sub->c, &pub_opts);
-					}
+					size_t from = c->send.len;
+					uint16_t id = mg_ntohs(mm.id);
+					mg_mqtt_send_header(c, (uint8_t) (mm.qos == 2 ? MQTT_CMD_PUBREC : MQTT_CMD_PUBACK), 0, sizeof(id));
+					mg_send(c, &id, sizeof(id));
+					wsWrap(c, from);
 				}
-				server.pubQueue.pop();
+				handleCmd(c, &mm);
+				pos += mm.dgram.len;
 			}
+			pending.erase(0, pos);
 		}
 		break;
-		case MG_EV_CLOSE: // 9
+		case MG_EV_CLOSE:
 		{
 			Server &server = *((Server*)c->fn_data);
-			for (struct sub * next, *sub = server.s_subs; sub != NULL; sub = next) {
-				next = sub->next;
-				if (c != sub->c) continue;
-				MG_INFO(("UNSUB %p [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr));
-				LIST_DELETE(struct sub, &server.s_subs, sub);
-			}
+			server.wsRecv.erase(c->id);
+			removeSubs(c);
 		}
 		break;
 		}
 	}
 
+	// mongoose mqtt functions write raw packet to c->send,
+	// for websocket connection move what was written since "from" into one binary frame
+	static void wsWrap(struct mg_connection *c, size_t from)
+	{
+		if (!c->is_websocket || c->send.len <= from) return;
+		std::string packet((const char*)c->send.buf + from, c->send.len - from);
+		c->send.len = from;
+		mg_ws_send(c, packet.data(), packet.size(), WEBSOCKET_OP_BINARY);
+	}
+
 	static inline uint64_t numconns(struct mg_mgr *mgr) { // Specify the return type as 'uint64_t'
 		uint64_t n = 0;
 		for (struct mg_connection *t = mgr->conns; t != NULL; t = t->next) n++;
 		return n;
 	}
 
+	// state == true : a subscriber with a backed up send buffer gets only the latest payload once it drains
+	// state == false: a subscriber so far behind that its send buffer is over the hard limit misses it
+	void publishToSubs(const std::string &topic, const std::string &payload, bool state)
+	{
+		for (struct sub *sub = s_subs; sub != NULL; sub = sub->next)
+		{
+			if (!mg_globmatch(sub->topic.ptr, sub->topic.len, topic.c_str(), topic.size())) continue;
+			if (state && (sub->c->send.len >= LV_MQTT_SEND_SOFT_LIMIT || stateHeld.count(sub->c->id)))
+			{
+				holdState(sub->c, topic, payload);
+				continue;
+			}
+			if (!state && sub->c->send.len >= LV_MQTT_SEND_HARD_LIMIT)
+			{
+				uint64_t dropped = sendDropped.fetch_add(1, std::memory_order_relaxed);
+				if (dropped % 1000 == 0)
+				{
+					MG_ERROR(("%lu Drop publish %s, send buffer full, %lu dropped", sub->c->id, topic.c_str(), (unsigned long) dropped + 1));
+				}
+				continue;
+			}
+			sendPub(sub->c, topic, payload);
+		}
+	}
+
+	void holdState(struct mg_connection *c, const std::string &topic, const std::string &payload)
+	{
+		std::vector<std::pair<std::string, std::string>> &held = stateHeld[c->id];
+		for (size_t nth_h = 0; nth_h < held.size(); ++nth_h)
+		{
+			if (held[nth_h].first != topic) continue;
+			held[nth_h].second = payload;
+			return;
+		}
+		held.push_back({topic, payload});
+	}
+
+	static void sendPub(struct mg_connection *c, const std::string &topic, const std::string &payload)
+	{
+		struct mg_mqtt_opts pub_opts;
+		memset(&pub_opts, 0, sizeof(pub_opts));
+		pub_opts.topic = mg_str_n(topic.c_str(), topic.size());
+		pub_opts.message = mg_str_n(payload.c_str(), payload.size());
+		pub_opts.qos = 0;
+		pub_opts.retain = false;
+		size_t from = c->send.len;
+		mg_mqtt_pub(c, &pub_opts);
+		wsWrap(c, from);
+	}
+
 
 public:
 	Server(const HostOption hostOption)
@@ -250,6 +419,14 @@ public:
 			          hostOption.listeningAddress.c_str()));
 			exit(EXIT_FAILURE);
 		}
+
+		if (hostOption.wsListeningAddress.size() &&
+		        mg_http_listen(&mgr, hostOption.wsListeningAddress.c_str(), &wsfn, this) == NULL)
+		{
+			MG_ERROR(("Cannot listen on %s. Use http://ADDR:PORT or :PORT",
+			          hostOption.wsListeningAddress.c_str()));
+			exit(EXIT_FAILURE);
+		}
 	}
 	~Server()
 	{
@@ -261,13 +438,77 @@ public:
 		mg_mgr_poll(&mgr, 0);
 	}
 
+	// fd that become readable when mongoose has io to handle, -1 if not using epoll
+	int getPollFd()
+	{
+		return mgr.epoll_fd;
+	}
+
 	void setOnMessageCallback(OnMessageCallback callback, void* self)
 	{
 		onMessageCallback = callback;
 		onMessageCallbackDataPtr = self;
 	}
-	int pub(std::string topic, std::string payload)
+	// peer address of the client whose message is being passed to the callback, empty outside the callback
+	std::string publisherIp()
+	{
+		if (publisher == NULL) return "";
+		char ip[48];
+		mg_snprintf(ip, sizeof(ip), "%M", mg_print_ip, &publisher->rem);
+		return ip;
+	}
+
+	// write the queued publishes into the subscriber send buffers, call before loop() so the write pass
+	// of the same poll sends them, MG_EV_POLL comes after that pass and would leave them for the next poll
+	void flush()
+	{
+		while (!pubQueue.empty())
+		{
+			publishToSubs(pubQueue.front().first, pubQueue.front().second, false);
+			pubQueue.pop();
+		}
+		for (size_t nth_s = 0; nth_s < stateQueue.size(); ++nth_s)
+		{
+			publishToSubs(stateQueue[nth_s].first, stateQueue[nth_s].second, true);
+		}
+		stateQueue.clear();
+	}
+
+	// write the state messages held for c once its send buffer is back under the soft limit
+	void flushHeld(struct mg_connection *c)
+	{
+		if (stateHeld.empty() || c->send.len >= LV_MQTT_SEND_SOFT_LIMIT) return;
+		auto held = stateHeld.find(c->id);
+		if (held == stateHeld.end()) return;
+		for (size_t nth_h = 0; nth_h < held->second.size(); ++nth_h)
+		{
+			sendPub(c, held->second[nth_h].first, held->second[nth_h].second);
+		}
+		stateHeld.erase(held);
+	}
+
+	/// event messages dropped for a subscriber too far behind, safe to call at any thread
+	uint64_t droppedCount()
+	{
+		return sendDropped.load(std::memory_order_relaxed);
+	}
+
+	/// coalesce == true : state topic, replace the pending payload of the same topic (latest value wins)
+	/// coalesce == false: event topic, keep FIFO order
+	int pub(std::string topic, std::string payload, bool coalesce = false)
 	{
+		if (coalesce)
+		{
+			for (size_t nth_s = 0; nth_s < stateQueue.size(); ++nth_s)
+			{
+				if (stateQueue[nth_s].first != topic) continue;
+				stateQueue[nth_s].second.swap(payload);
+				return 0;
+			}
+			if (stateQueue.size() > 100) return -1;
+			stateQueue.push_back({topic, payload});
+			return 0;
+		}
 		if (pubQueue.size() > 100) return -1;
 		pubQueue.push({topic, payload});
 		return 0;
@@ -278,10 +519,35 @@ public:
 class LvMQTTServer
 {
 public:
-	LvMQTTServer(const char *s_listen_on)
-		: server(LvMqttServer::HostOption(s_listen_on, 1000)) // default 1000 connection
+	LvMQTTServer(const char *s_listen_on, const char *s_ws_listen_on = "")
+		: server(LvMqttServer::HostOption(s_listen_on, 1000, s_ws_listen_on)) // default 1000 connection
 	{
 		server.setOnMessageCallback(&OnMessageCallback, this);
+		wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+	~LvMQTTServer()
+	{
+		stop();
+		if (wake_fd >= 0) close(wake_fd);
+	}
+
+	// Run the broker at its own thread, after this loop() do nothing.
+	// Add interest/state topic before start, the list is not protected.
+	int start()
+	{
+		if (running) return -1;
+		if (wake_fd < 0) return -2;
+		running = true;
+		broker_thread = std::thread(&LvMQTTServer::run, this);
+		return 0;
+	}
+
+	void stop()
+	{
+		if (!running) return;
+		running = false;
+		wake();
+		if (broker_thread.joinable()) broker_thread.join();
 	}
 
 	int interest_topic_add(std::string topic)
@@ -297,8 +563,36 @@ public:
 		topic_interest.clear();
 	}
 
+	// when set, interest topic message is passed to the callback at the broker thread instead of queue for get()
+	// when using this callback please be quick dont block it
+	void set_on_interest_message(LvMqttServer::OnMessageCallback callback, void* self)
+	{
+		on_interest_message = callback;
+		on_interest_message_self = self;
+	}
+
+	// state topic only keep the latest pending payload, support wildcard same as interest topic
+	int state_topic_add(std::string topic)
+	{
+		if (std::find(topic_state.begin(), topic_state.end(), topic) != topic_state.end()) return -1;
+		topic_state.push_back(topic);
+		return 0;
+	}
+
+	void state_topic_clear()
+	{
+		topic_state.clear();
+	}
+
+	// address of the client that published the message, only valid inside the interest callback
+	std::string message_source_ip()
+	{
+		return server.publisherIp();
+	}
+
 	int get(std::string &topic, std::string &payload)
 	{
+		std::lock_guard<std::mutex> lock(msg_get_mtx);
 		if (mqtt_msg_get.empty()) return -1;
 		topic = mqtt_msg_get.front().first;
 		payload = mqtt_msg_get.front().second;
@@ -307,13 +601,65 @@ public:
 	}
 
 
+	/// safe to call at any thread, the broker thread is wake up to publish it
+	/// when the queue is full a state message replaces its pending one, an event message waits aside
+	/// up to LV_MQTT_PUT_OVERFLOW_LIMIT, only then it is dropped and -1 returned
 	int put(std::string topic, std::string payload)
 	{
-		return server.pub(topic, payload);
+		std::pair<std::string, std::string> msg(std::move(topic), std::move(payload));
+		if (!overflowing.load(std::memory_order_acquire) && put_queue.push(std::move(msg)))
+		{
+			put_pending.fetch_add(1, std::memory_order_relaxed);
+			wake();
+			return 0;
+		}
+
+		// once a message is aside the next ones follow it, so a producer keeps its order
+		std::lock_guard<std::mutex> lock(overflow_mtx);
+		if (is_state_topic(msg.first))
+		{
+			for (size_t nth_s = 0; nth_s < overflow_state.size(); ++nth_s)
+			{
+				if (overflow_state[nth_s].first != msg.first) continue;
+				overflow_state[nth_s].second.swap(msg.second);
+				wake();
+				return 0;
+			}
+			overflow_state.push_back(std::move(msg));
+		}
+		else if (overflow_event.size() >= LV_MQTT_PUT_OVERFLOW_LIMIT)
+		{
+			if (put_dropped.fetch_add(1, std::memory_order_relaxed) == overflow_dropped_logged)
+			{
+				MG_ERROR(("Drop put %s, queue full", msg.first.c_str()));
+			}
+			wake();
+			return -1;
+		}
+		else overflow_event.push_back(std::move(msg));
+		overflowing.store(true, std::memory_order_release);
+		put_pending.fetch_add(1, std::memory_order_relaxed);
+		wake();
+		return 0;
+	}
+
+	/// messages put and not yet taken by the broker, safe to call at any thread
+	uint64_t pending_count()
+	{
+		int64_t pending = put_pending.load(std::memory_order_relaxed);
+		return pending > 0 ? pending : 0;
+	}
+
+	/// messages dropped since start, put queue and its overflow full or subscriber too far behind, safe to call at any thread
+	uint64_t dropped_count()
+	{
+		return put_dropped.load(std::memory_order_relaxed) + server.droppedCount();
 	}
 
 	void loop(uint64_t now_ms)
 	{
+		if (running) return; // broker thread is doing the job
+		drain_put_queue();
 		l_now_ms = now_ms;
 		if (now_ms - delay_tick_ms < 5) return;
 		delay_tick_ms = now_ms;
@@ -327,8 +673,107 @@ private:
 	uint64_t delay_tick_ms;
 
 	std::vector<std::string> topic_interest;
+	std::vector<std::string> topic_state;
+	LvMqttServer::OnMessageCallback on_interest_message = NULL;
+	void *on_interest_message_self = NULL;
+	std::mutex msg_get_mtx;
 	std::queue<std::pair<std::string, std::string>> mqtt_msg_get;
 
+	LvMPSCQueue<std::pair<std::string, std::string>, 256> put_queue; // producer modules -> broker
+	std::atomic<int64_t> put_pending{0};
+	std::atomic<uint64_t> put_dropped{0};
+	std::mutex overflow_mtx; // guards the overflow vectors and overflow_dropped_logged
+	std::atomic<bool> overflowing{false}; // overflow vectors not empty, put() skips the queue
+	std::vector<std::pair<std::string, std::string>> overflow_event; // FIFO after the queue content
+	std::vector<std::pair<std::string, std::string>> overflow_state; // one per topic, latest wins
+	uint64_t overflow_dropped_logged = 0; // put_dropped when the overflow last drained, log the first drop after it
+	int wake_fd = -1;
+	std::atomic<bool> running{false};
+	std::thread broker_thread;
+
+	void wake()
+	{
+		uint64_t one = 1;
+		if (write(wake_fd, &one, sizeof(one)) < 0) {} // counter overflow only, still readable
+	}
+
+	// only call at the thread that poll the server
+	void drain_put_queue()
+	{
+		std::pair<std::string, std::string> msg;
+		while (put_queue.pop(msg))
+		{
+			take(msg);
+		}
+		if (overflowing.load(std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> lock(overflow_mtx);
+			for (size_t nth_o = 0; nth_o < overflow_event.size(); ++nth_o) take(overflow_event[nth_o]);
+			for (size_t nth_o = 0; nth_o < overflow_state.size(); ++nth_o) take(overflow_state[nth_o]);
+			overflow_event.clear();
+			overflow_state.clear();
+			overflow_dropped_logged = put_dropped.load(std::memory_order_relaxed);
+			overflowing.store(false, std::memory_order_release);
+		}
+		server.flush(); // to the send buffers now, the poll that follows writes them
+	}
+
+	// hand one put message to the server, writing its queue out first when that is full
+	void take(std::pair<std::string, std::string> &msg)
+	{
+		put_pending.fetch_sub(1, std::memory_order_relaxed);
+		bool state = is_state_topic(msg.first);
+		if (server.pub(msg.first, msg.second, state) == 0) return;
+		server.flush();
+		server.pub(msg.first, msg.second, state);
+	}
+
+	// broker thread, wait on eventfd and the mongoose epoll fd together
+	void run()
+	{
+		int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = wake_fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+		int poll_fd = server.getPollFd();
+		if (poll_fd >= 0)
+		{
+			ev.data.fd = poll_fd;
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, poll_fd, &ev);
+		}
+		// without mongoose epoll fd fall back to 5 ms tick, otherwise only wake for closing connection
+		int timeout_ms = poll_fd >= 0 ? 50 : 5;
+
+		struct epoll_event evs[2];
+		LvTrace::instance().setThreadName("mqtt");
+		while (running)
+		{
+			int n = epoll_wait(epoll_fd, evs, 2, timeout_ms);
+			for (int i = 0; i < n; ++i)
+			{
+				if (evs[i].data.fd != wake_fd) continue;
+				uint64_t count;
+				if (read(wake_fd, &count, sizeof(count)) < 0) {} // EAGAIN when already drained
+			}
+			LV_TRACE_SCOPE("mqtt.poll");
+			drain_put_queue();
+			server.loop(mg_millis());
+		}
+		close(epoll_fd);
+	}
+
+	bool is_state_topic(const std::string &topic)
+	{
+		for (size_t nth_ts = 0; nth_ts < topic_state.size(); ++nth_ts)
+		{
+			if (mg_globmatch(topic_state[nth_ts].c_str(), topic_state[nth_ts].size(),
+			                 topic.c_str(), topic.size())) return true;
+		}
+		return false;
+	}
+
 
 	static void OnMessageCallback(void* self, const std::string topic, const std::string payload)
 	{
@@ -339,6 +784,12 @@ private:
 			                 Self.topic_interest[nth_ti].size(),
 			                 topic.c_str(), topic.size()))
 			{
+				if (Self.on_interest_message != NULL)
+				{
+					Self.on_interest_message(Self.on_interest_message_self, topic, payload);
+					break;
+				}
+				std::lock_guard<std::mutex> lock(Self.msg_get_mtx);
 				if (Self.mqtt_msg_get.size() > 100) break;
 				Self.mqtt_msg_get.push({
 					std::string(topic.c_str(), topic.size()),
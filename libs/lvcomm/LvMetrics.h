@@ -0,0 +1,297 @@
+// #include "LvMetrics.h"
+#ifndef LV_METRICS_H
+#define LV_METRICS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <atomic>
+#include <cstdio> // snprintf
+#include <cstdint> // uint64_t
+
+// Process wide registry of counters, gauges and fixed bucket histograms.
+// A module registers its metrics once (at construction) and keeps the reference,
+// updating them is a relaxed atomic so it is safe and cheap at any thread.
+// Registering the same name and labels again gives the same metric.
+// Export as Prometheus text, or as JSON of <series, value> for MQTT.
+// Labels are given already formatted, e.g. camera="10.0.0.5".
+class LvMetrics
+{
+public:
+	class Counter
+	{
+	public:
+		void inc(uint64_t n = 1)
+		{
+			count.fetch_add(n, std::memory_order_relaxed);
+		}
+		uint64_t value() const
+		{
+			return count.load(std::memory_order_relaxed);
+		}
+	private:
+		std::atomic<uint64_t> count{0};
+	};
+
+	class Gauge
+	{
+	public:
+		void set(int64_t value)
+		{
+			current.store(value, std::memory_order_relaxed);
+		}
+		void add(int64_t n)
+		{
+			current.fetch_add(n, std::memory_order_relaxed);
+		}
+		int64_t value() const
+		{
+			return current.load(std::memory_order_relaxed);
+		}
+	private:
+		std::atomic<int64_t> current{0};
+	};
+
+	class Histogram
+	{
+	public:
+		// bounds ascending, the +Inf bucket is added
+		Histogram(const std::vector<double> &_bounds)
+			: bounds(_bounds), buckets(new std::atomic<uint64_t>[_bounds.size() + 1])
+		{
+			for (size_t i = 0; i <= bounds.size(); ++i) buckets[i].store(0, std::memory_order_relaxed);
+		}
+		void observe(double value)
+		{
+			size_t i = 0;
+			while (i < bounds.size() && value > bounds[i]) ++i;
+			buckets[i].fetch_add(1, std::memory_order_relaxed);
+			double old = sum.load(std::memory_order_relaxed);
+			while (!sum.compare_exchange_weak(old, old + value, std::memory_order_relaxed)) {}
+		}
+	private:
+		friend class LvMetrics;
+		const std::vector<double> bounds;
+		std::unique_ptr<std::atomic<uint64_t>[]> buckets; // not cumulative, summed at export
+		std::atomic<double> sum{0};
+	};
+
+	// value read at export time, e.g. the depth of a queue owned by the module
+	typedef double (*SampleCallback)(void *self);
+
+	static LvMetrics &instance()
+	{
+		static LvMetrics metrics;
+		return metrics;
+	}
+
+	Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		Series &series = findSeries(name, help, TypeCounter, labels);
+		if (!series.counter) series.counter.reset(new Counter());
+		return *series.counter;
+	}
+
+	Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		Series &series = findSeries(name, help, TypeGauge, labels);
+		if (!series.gauge) series.gauge.reset(new Gauge());
+		return *series.gauge;
+	}
+
+	Histogram &histogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+	                     const std::string &labels = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		Series &series = findSeries(name, help, TypeHistogram, labels);
+		if (!series.histogram) series.histogram.reset(new Histogram(bounds));
+		return *series.histogram;
+	}
+
+	// counter kept by the module itself, the callback must stay valid for the life of the process
+	void counterCallback(const std::string &name, const std::string &help, SampleCallback callback, void *self,
+	                     const std::string &labels = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		Series &series = findSeries(name, help, TypeCounter, labels);
+		series.callback = callback;
+		series.callbackSelf = self;
+	}
+
+	void gaugeCallback(const std::string &name, const std::string &help, SampleCallback callback, void *self,
+	                   const std::string &labels = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		Series &series = findSeries(name, help, TypeGauge, labels);
+		series.callback = callback;
+		series.callbackSelf = self;
+	}
+
+	// Prometheus text exposition format 0.0.4
+	std::string prometheus()
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		std::string text;
+		for (const auto &family : families)
+		{
+			const std::string &name = family.first;
+			text += "# HELP " + name + " " + family.second.help + "\n";
+			text += "# TYPE " + name + " " + typeName(family.second.type) + "\n";
+			for (const auto &series : family.second.series)
+			{
+				if (series.histogram)
+				{
+					const Histogram &histogram = *series.histogram;
+					uint64_t cumulative = 0;
+					for (size_t i = 0; i <= histogram.bounds.size(); ++i)
+					{
+						cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+						std::string le = i < histogram.bounds.size() ? number(histogram.bounds[i]) : "+Inf";
+						text += name + "_bucket" + withLabels(series.labels, "le=\"" + le + "\"") + " " + number(cumulative) + "\n";
+					}
+					text += name + "_sum" + withLabels(series.labels) + " " + number(histogram.sum.load(std::memory_order_relaxed)) + "\n";
+					text += name + "_count" + withLabels(series.labels) + " " + number(cumulative) + "\n";
+					continue;
+				}
+				text += name + withLabels(series.labels) + " " + number(value(series)) + "\n";
+			}
+		}
+		return text;
+	}
+
+	// {"<name>{<labels>}":<value>,...} of the metrics whose name starts with prefix, histogram as _count and _sum
+	std::string json(const std::string &prefix = "")
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		std::string text = "{";
+		for (const auto &family : families)
+		{
+			if (family.first.compare(0, prefix.size(), prefix) != 0) continue;
+			for (const auto &series : family.second.series)
+			{
+				if (series.histogram)
+				{
+					uint64_t count = 0;
+					for (size_t i = 0; i <= series.histogram->bounds.size(); ++i)
+						count += series.histogram->buckets[i].load(std::memory_order_relaxed);
+					appendJson(text, family.first + "_count" + withLabels(series.labels), number(count));
+					appendJson(text, family.first + "_sum" + withLabels(series.labels),
+					           number(series.histogram->sum.load(std::memory_order_relaxed)));
+					continue;
+				}
+				appendJson(text, family.first + withLabels(series.labels), number(value(series)));
+			}
+		}
+		return text + "}";
+	}
+
+	std::vector<std::string> names()
+	{
+		std::lock_guard<std::mutex> lock(registryMtx);
+		std::vector<std::string> result;
+		for (const auto &family : families) result.push_back(family.first);
+		return result;
+	}
+
+private:
+	enum Type
+	{
+		TypeCounter,
+		TypeGauge,
+		TypeHistogram,
+	};
+
+	struct Series
+	{
+		std::string labels;
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Gauge> gauge;
+		std::unique_ptr<Histogram> histogram;
+		SampleCallback callback = NULL;
+		void *callbackSelf = NULL;
+	};
+
+	struct Family
+	{
+		std::string help;
+		Type type;
+		std::vector<Series> series; // the metrics are on the heap, the vector may grow
+	};
+
+	std::map<std::string, Family> families; // sorted by name
+	std::mutex registryMtx; // registration and export only, updates do not take it
+
+	LvMetrics() {}
+
+	Series &findSeries(const std::string &name, const std::string &help, Type type, const std::string &labels)
+	{
+		auto it = families.find(name);
+		if (it == families.end())
+		{
+			it = families.insert({name, Family()}).first;
+			it->second.help = help;
+			it->second.type = type;
+		}
+		for (auto &series : it->second.series)
+		{
+			if (series.labels == labels) return series;
+		}
+		it->second.series.emplace_back();
+		it->second.series.back().labels = labels;
+		return it->second.series.back();
+	}
+
+	static double value(const Series &series)
+	{
+		if (series.callback != NULL) return series.callback(series.callbackSelf);
+		if (series.counter) return series.counter->value();
+		if (series.gauge) return series.gauge->value();
+		return 0;
+	}
+
+	static const char *typeName(Type type)
+	{
+		switch (type)
+		{
+		case TypeCounter:
+			return "counter";
+		case TypeGauge:
+			return "gauge";
+		default:
+			return "histogram";
+		}
+	}
+
+	static std::string withLabels(const std::string &labels, const std::string &extra = "")
+	{
+		if (labels.empty() && extra.empty()) return "";
+		if (labels.empty()) return "{" + extra + "}";
+		if (extra.empty()) return "{" + labels + "}";
+		return "{" + labels + "," + extra + "}";
+	}
+
+	static std::string number(double value)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.15g", value);
+		return buf;
+	}
+
+	static void appendJson(std::string &text, const std::string &key, const std::string &value)
+	{
+		if (text.size() > 1) text += ",";
+		text += "\"";
+		for (char ch : key)
+		{
+			if (ch == '"' || ch == '\\') text += '\\';
+			text += ch;
+		}
+		text += "\":" + value;
+	}
+};
+
+#endif // LV_METRICS_H
@@ -0,0 +1,210 @@
+// #include "LvMmapRing.h"
+#ifndef LV_MMAP_RING_H
+#define LV_MMAP_RING_H
+
+#include <string> // std::string
+#include <cstring> // memcpy
+#include <cstdint> // uint32_t
+#include <fcntl.h> // open
+#include <unistd.h> // close, ftruncate
+#include <sys/mman.h> // mmap, munmap
+
+// Persistent FIFO of <topic, payload> records kept in a preallocated mmap'd file.
+// The content survive restart, when full the oldest record is dropped.
+// Record: [uint32 topic len][uint32 payload len][topic][payload], a 0xFFFFFFFF len mark the unused end before wrap.
+// Not thread safe.
+class LvMmapRing
+{
+public:
+	LvMmapRing() {}
+	~LvMmapRing()
+	{
+		close();
+	}
+
+	// return 0 OK, -1 cannot create file, -2 cannot map
+	int open(const std::string &filepath, uint32_t capacity)
+	{
+		close();
+		fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) return -1;
+		mapLen = sizeof(Header) + capacity;
+		if (ftruncate(fd, mapLen) != 0)
+		{
+			close();
+			return -1;
+		}
+		void *addr = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			close();
+			return -2;
+		}
+		header = (Header*)addr;
+		data = (uint8_t*)addr + sizeof(Header);
+
+		// new file or other layout, start empty
+		if (header->magic != Magic || header->capacity != capacity || header->used > capacity ||
+		    header->head >= capacity || header->tail >= capacity)
+		{
+			memset(header, 0, sizeof(Header));
+			header->magic = Magic;
+			header->capacity = capacity;
+		}
+		return 0;
+	}
+
+	void close()
+	{
+		if (header != NULL) munmap(header, mapLen);
+		if (fd >= 0) ::close(fd);
+		header = NULL;
+		data = NULL;
+		fd = -1;
+	}
+
+	// return 0 OK, 1 OK but oldest record dropped, -1 not open, -2 record too large
+	int push(const std::string &topic, const std::string &payload)
+	{
+		if (header == NULL) return -1;
+		uint32_t need = RecordHeaderSize + topic.size() + payload.size();
+		if (need > header->capacity / 2) return -2;
+
+		int rc = 0;
+		uint32_t waste;
+		for (;;)
+		{
+			waste = (header->capacity - header->head < need) ? header->capacity - header->head : 0;
+			if (header->capacity - header->used >= need + waste) break;
+			if (drop() != 0) // nothing left, start from the beginning
+			{
+				header->head = header->tail = header->used = 0;
+			}
+			rc = 1;
+		}
+
+		if (waste)
+		{
+			if (waste >= sizeof(uint32_t)) writeU32(header->head, WrapMark);
+			header->used += waste;
+			header->head = 0;
+		}
+
+		writeU32(header->head, topic.size());
+		writeU32(header->head + sizeof(uint32_t), payload.size());
+		memcpy(data + header->head + RecordHeaderSize, topic.data(), topic.size());
+		memcpy(data + header->head + RecordHeaderSize + topic.size(), payload.data(), payload.size());
+		header->head += need;
+		if (header->head == header->capacity) header->head = 0;
+		header->used += need;
+		header->count++;
+		return rc;
+	}
+
+	// peek the oldest record, return 0 OK, -1 empty
+	int front(std::string &topic, std::string &payload)
+	{
+		if (header == NULL || header->count == 0) return -1;
+		skipWrap();
+		uint32_t topicLen = readU32(header->tail);
+		uint32_t payloadLen = readU32(header->tail + sizeof(uint32_t));
+		topic.assign((const char*)data + header->tail + RecordHeaderSize, topicLen);
+		payload.assign((const char*)data + header->tail + RecordHeaderSize + topicLen, payloadLen);
+		return 0;
+	}
+
+	// peek the nth oldest record without removing, 0 is the front, return 0 OK, -1 no such record
+	int at(uint32_t nth, std::string &topic, std::string &payload)
+	{
+		if (header == NULL || nth >= header->count) return -1;
+		uint32_t offset = header->tail;
+		for (uint32_t i = 0;; ++i)
+		{
+			if (header->capacity - offset < RecordHeaderSize || readU32(offset) == WrapMark) offset = 0;
+			uint32_t topicLen = readU32(offset);
+			uint32_t payloadLen = readU32(offset + sizeof(uint32_t));
+			if (i == nth)
+			{
+				topic.assign((const char*)data + offset + RecordHeaderSize, topicLen);
+				payload.assign((const char*)data + offset + RecordHeaderSize + topicLen, payloadLen);
+				return 0;
+			}
+			offset += RecordHeaderSize + topicLen + payloadLen;
+			if (offset == header->capacity) offset = 0;
+		}
+	}
+
+	// remove the oldest record, return 0 OK, -1 empty
+	int pop()
+	{
+		return drop();
+	}
+
+	uint32_t size()
+	{
+		return header == NULL ? 0 : header->count;
+	}
+
+	// ask kernel to write back the dirty pages, dont wait
+	void flush()
+	{
+		if (header != NULL) msync(header, mapLen, MS_ASYNC);
+	}
+
+private:
+	static const uint32_t Magic = 0x4C565247; // "LVRG"
+	static const uint32_t WrapMark = 0xFFFFFFFF;
+	static const uint32_t RecordHeaderSize = 2 * sizeof(uint32_t);
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t capacity;
+		uint32_t head; // next write offset
+		uint32_t tail; // oldest record offset
+		uint32_t used; // bytes between tail and head, include wasted end before wrap
+		uint32_t count; // number of records
+		uint32_t reserved[10];
+	};
+
+	int fd = -1;
+	size_t mapLen = 0;
+	Header *header = NULL;
+	uint8_t *data = NULL;
+
+	uint32_t readU32(uint32_t offset)
+	{
+		uint32_t value;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	void writeU32(uint32_t offset, uint32_t value)
+	{
+		memcpy(data + offset, &value, sizeof(value));
+	}
+
+	// tail at the wasted end, move it to the beginning
+	void skipWrap()
+	{
+		uint32_t left = header->capacity - header->tail;
+		if (left >= RecordHeaderSize && readU32(header->tail) != WrapMark) return;
+		header->used -= left;
+		header->tail = 0;
+	}
+
+	int drop()
+	{
+		if (header == NULL || header->count == 0) return -1;
+		skipWrap();
+		uint32_t size = RecordHeaderSize + readU32(header->tail) + readU32(header->tail + sizeof(uint32_t));
+		header->tail += size;
+		if (header->tail == header->capacity) header->tail = 0;
+		header->used -= size;
+		header->count--;
+		if (header->count == 0) header->head = header->tail = header->used = 0;
+		return 0;
+	}
+};
+
+#endif // LV_MMAP_RING_H
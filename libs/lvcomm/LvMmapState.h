@@ -0,0 +1,97 @@
+// #include "LvMmapState.h"
+#ifndef LV_MMAP_STATE_H
+#define LV_MMAP_STATE_H
+
+#include <string> // std::string
+#include <cstring> // memset
+#include <cstdint> // uint32_t
+#include <type_traits> // std::is_trivially_copyable
+#include <fcntl.h> // open
+#include <unistd.h> // close, ftruncate
+#include <sys/mman.h> // mmap, msync, munmap
+
+// Plain struct T kept in a mmap'd file, so what the program write to it is there after restart.
+// A file of another layout (different magic, version or size of T) starts again zeroed.
+// Change the version when the meaning of T change but not its size.
+// Not thread safe, except flush() which may run while another thread writes to the state.
+template <typename T>
+class LvMmapState
+{
+	static_assert(std::is_trivially_copyable<T>::value, "LvMmapState need a plain struct");
+
+public:
+	LvMmapState() {}
+	~LvMmapState()
+	{
+		close();
+	}
+
+	// return 0 OK with the saved state, 1 OK but started zeroed, -1 cannot create file, -2 cannot map
+	int open(const std::string &filepath, uint32_t version = 1)
+	{
+		close();
+		fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) return -1;
+		if (ftruncate(fd, sizeof(Mapping)) != 0)
+		{
+			close();
+			return -1;
+		}
+		void *addr = mmap(NULL, sizeof(Mapping), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			close();
+			return -2;
+		}
+		mapping = (Mapping*)addr;
+
+		if (mapping->magic == Magic && mapping->version == version && mapping->size == sizeof(T)) return 0;
+		memset(mapping, 0, sizeof(Mapping));
+		mapping->magic = Magic;
+		mapping->version = version;
+		mapping->size = sizeof(T);
+		return 1;
+	}
+
+	void close()
+	{
+		if (mapping != NULL)
+		{
+			msync(mapping, sizeof(Mapping), MS_SYNC);
+			munmap(mapping, sizeof(Mapping));
+		}
+		if (fd >= 0) ::close(fd);
+		mapping = NULL;
+		fd = -1;
+	}
+
+	// NULL when not open
+	T *get()
+	{
+		return mapping == NULL ? NULL : &mapping->state;
+	}
+
+	// write back the dirty page and wait for it, MS_ASYNC only schedules on Linux where the page
+	// already is in the page cache
+	void flush()
+	{
+		if (mapping != NULL) msync(mapping, sizeof(Mapping), MS_SYNC);
+	}
+
+private:
+	static const uint32_t Magic = 0x4C565354; // "LVST"
+
+	struct Mapping
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size;
+		uint32_t reserved;
+		T state;
+	};
+
+	int fd = -1;
+	Mapping *mapping = NULL;
+};
+
+#endif // LV_MMAP_STATE_H
@@ -0,0 +1,31 @@
+// #include "LvProbe.h"
+#ifndef LV_PROBE_H
+#define LV_PROBE_H
+
+// USDT static probes of the "iotbox" provider, for bpftrace / perf / systemtap in the field.
+// A probe is a single nop in the code and a note in the ELF, it costs nothing until a tracer
+// attaches (no rebuild needed), so the arguments must stay cheap: integers and const char*.
+// Needs <sys/sdt.h> (systemtap-sdt-dev) at build time, without it, or with -DLV_PROBE_DISABLE,
+// the probes compile to nothing. List them with "readelf -n meow | grep -A2 stapsdt".
+#if defined(__has_include) && !defined(LV_PROBE_DISABLE)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define LV_PROBE_ENABLED 1
+#endif
+#endif
+
+#ifdef LV_PROBE_ENABLED
+#define LV_PROBE0(name) DTRACE_PROBE(iotbox, name)
+#define LV_PROBE1(name, a1) DTRACE_PROBE1(iotbox, name, a1)
+#define LV_PROBE2(name, a1, a2) DTRACE_PROBE2(iotbox, name, a1, a2)
+#define LV_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(iotbox, name, a1, a2, a3)
+#define LV_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(iotbox, name, a1, a2, a3, a4)
+#else
+#define LV_PROBE0(name) do {} while (0)
+#define LV_PROBE1(name, a1) do {} while (0)
+#define LV_PROBE2(name, a1, a2) do {} while (0)
+#define LV_PROBE3(name, a1, a2, a3) do {} while (0)
+#define LV_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+#endif // LV_PROBE_H
@@ -78,9 +78,9 @@ public:
 		mg_mgr_free(&mgr);
 	}
 
-	void loop(uint64_t nowMs)
+	void loop(uint64_t nowMs, int waitMs = 0)
 	{
-		mg_mgr_poll(&mgr, 0);
+		mg_mgr_poll(&mgr, waitMs);
 	}
 
 	bool getResponse(Response &_response)
@@ -213,16 +213,17 @@ public:
 		return -2;
 	}
 
-    // existing loop function
-	void loop(uint64_t now_ms) {
-		if (now_ms - delay_tick_ms < 10) return;
+    // existing loop function, runs every 10 ms at most when called from a busy loop
+	// wait_ms > 0 is for a caller waiting on its request: no throttle, blocks up to wait_ms on the sockets instead of spinning
+	void loop(uint64_t now_ms, int wait_ms = 0) {
+		if (wait_ms == 0 && now_ms - delay_tick_ms < 10) return;
 		delay_tick_ms = now_ms;
 
 
 		std::vector<unsigned long> list_delete;
 		for (auto& it : request_list)
 		{
-			it.second.httpClient->loop(now_ms);
+			it.second.httpClient->loop(now_ms, wait_ms);
 			if (it.second.httpClient->getStatus() == LvHttpClient::StatusNew) continue;
 			if (it.second.httpClient->getStatus() == LvHttpClient::StatusConnecting) continue;
 			if (it.second.httpClient->getStatus() == LvHttpClient::StatusWaitForResponse) continue;
@@ -253,7 +254,7 @@ private:
 	std::map<unsigned long, request_t> request_list;
 	unsigned long uid = 1;
 
-	uint64_t delay_tick_ms;
+	uint64_t delay_tick_ms = 0;
 };
 
 
@@ -5,8 +5,12 @@
 #include <queue>
 #include <string>
 #include <map>
+#include <vector>
 #include <fstream>
+#include <deque>
+#include <memory>
 #include "mongoose.h"
+#include "LvAssetCache.h"
 
 
 
@@ -24,17 +28,26 @@ public:
 	HostOption(const std::string _ListeningAddress,
 	           const uint64_t _ConnLimit = 0,
 	           const uint64_t _ReadLimit = 524288, // fix to 512 KB max read
-	           const uint64_t _TimeoutMs = 1000)
+	           const uint64_t _TimeoutMs = 1000,
+	           const uint64_t _WsBacklogLimit = 64,
+	           const uint64_t _WsSendBufLimit = 65536,
+	           const uint64_t _AssetCacheLimit = 4194304) // 4 MB of static files in memory
 		:
 		ListeningAddress(_ListeningAddress),
 		ConnLimit(_ConnLimit),
 		ReadLimit(_ReadLimit),
-		TimeoutMs(_TimeoutMs)
+		TimeoutMs(_TimeoutMs),
+		WsBacklogLimit(_WsBacklogLimit),
+		WsSendBufLimit(_WsSendBufLimit),
+		AssetCacheLimit(_AssetCacheLimit)
 	{}
 	const std::string ListeningAddress;
-	const uint64_t ConnLimit; // set 0 to unlimited
+	const uint64_t ConnLimit; // set 0 to unlimited, also the connection slab size (1024 when unlimited)
 	const uint64_t ReadLimit; // set 0 to unlimited
 	const uint64_t TimeoutMs; // !!! take note the timeout must be set otherwise something wrong
+	const uint64_t WsBacklogLimit; // max broadcast frames waiting per websocket, oldest dropped when full
+	const uint64_t WsSendBufLimit; // stop moving frames to the socket buffer when it hold this many bytes
+	const uint64_t AssetCacheLimit; // bytes of servefile/servedir files kept in memory, set 0 to always read disk
 };
 enum Method
 {
@@ -51,17 +64,23 @@ public:
 	        unsigned long cId = 0)
 		: uri(uri), method(method), body(body), header(header), cId(cId)
 	{}
+	Request(const Request&) = default;
+	Request(Request&&) = default; // handed to the callback and queued without copying header and body
 	std::string uri;
+	std::string query; // after the '?', not decoded
 	Method method;
 	std::string body;
 	std::string header;
+	std::string remoteIp; // peer address of the connection, without port
 	unsigned long cId;
 	void copy(const Request& other)
 	{
 		uri = other.uri;
+		query = other.query;
 		method = other.method;
 		body = other.body;
 		header = other.header;
+		remoteIp = other.remoteIp;
 		cId = other.cId;
 	}
 
@@ -193,14 +212,66 @@ public:
 		StatusUriNotFound,
 		StatusWebsockOpen,
 	} status = StatusNew;
-	std::string requestStr;
-	struct mg_http_message hm;
-	Request request;
+	struct mg_http_message hm; // point into request.header and request.body, valid until releaseRequest
+	Request request; // header and body cleared and never shrunk so a slot allocates only for a bigger request
 	UriOption uriOption;
 	Response response;
 
 	uint64_t wsTickMs;
-	std::queue<std::string> wsMsgQueue;
+	std::deque<std::shared_ptr<const std::string>> wsMsgQueue; // encoded frames, shared by all the receivers
+	uint64_t wsDropCount = 0;
+
+	bool inUse = false;
+	uint16_t generation = 1; // bumped when the slot is freed, stale id wont match
+
+	// clear for the next connection, keep the string capacity
+	void reset(uint64_t nowMs)
+	{
+		bornMs = nowMs;
+		status = StatusWaitForRequest;
+		releaseRequest();
+		request = Request();
+		uriOption = UriOption();
+		response = Response();
+		wsTickMs = 0;
+		wsMsgQueue.clear();
+		wsDropCount = 0;
+	}
+
+	void releaseRequest()
+	{
+		request.header.clear();
+		request.body.clear();
+		memset(&hm, 0, sizeof(hm));
+	}
+
+	// copy the head and body mongoose parsed once into request and point hm at that copy, no second parse
+	void takeRequest(const struct mg_http_message &parsed)
+	{
+		request.header.assign(parsed.head.ptr, parsed.head.len);
+		request.body.assign(parsed.body.ptr, parsed.body.len);
+		hm = parsed;
+		const char *head = parsed.head.ptr;
+		rebase(hm.method, head, request.header);
+		rebase(hm.uri, head, request.header);
+		rebase(hm.query, head, request.header);
+		rebase(hm.proto, head, request.header);
+		for (size_t i = 0; i < MG_MAX_HTTP_HEADERS; ++i)
+		{
+			rebase(hm.headers[i].name, head, request.header);
+			rebase(hm.headers[i].value, head, request.header);
+		}
+		rebase(hm.head, head, request.header);
+		rebase(hm.body, parsed.body.ptr, request.body);
+		hm.message = mg_str_n(NULL, 0); // head and body are apart now, only the parse reads message
+	}
+
+private:
+	static void rebase(struct mg_str &str, const char *from, const std::string &to)
+	{
+		if (str.ptr == NULL) return;
+		str.ptr = to.data() + (str.ptr - from);
+	}
 };
 
 
@@ -208,8 +279,10 @@ class Server
 {
 public:
 	Server(const HostOption _hostOption)
-		: hostOption(_hostOption)
+		: hostOption(_hostOption), assetCache(_hostOption.AssetCacheLimit)
 	{
+		slab.reserve(slabCapacity());
+		freeSlots.reserve(slabCapacity());
 		mg_mgr_init(&mgr);
 		if (mg_http_listen(&mgr, hostOption.ListeningAddress.c_str(), cb, this) == NULL)
 		{
@@ -227,29 +300,37 @@ public:
 	{
 		while (!wsMsgQueue.empty())
 		{
-			for (auto connectionIt = connectionMap.begin(); connectionIt != connectionMap.end(); ++connectionIt)
+			std::shared_ptr<const std::string> frame; // encode once when the first receiver found
+			for (auto slotIt = slab.begin(); slotIt != slab.end(); ++slotIt)
 			{
-				if (connectionIt->second.uriOption.type != UriOption::TypeWebsocket) continue; // only send for websocket
-				if (connectionIt->second.status != ConnectionT::StatusWebsockOpen) continue; // not open dont need send
-				if (wsMsgQueue.front().first.size() == 0) // if url not specific send all
+				if (!slotIt->inUse) continue;
+				if (slotIt->uriOption.type != UriOption::TypeWebsocket) continue; // only send for websocket
+				if (slotIt->status != ConnectionT::StatusWebsockOpen) continue; // not open dont need send
+				if (wsMsgQueue.front().first.size() != 0 && // if url not specific send all
+				        !mg_globmatch(slotIt->uriOption.uri.c_str(),
+				                      slotIt->uriOption.uri.size(),
+				                      wsMsgQueue.front().first.c_str(),
+				                      wsMsgQueue.front().first.size())) continue; // uri not matched
+				if (!frame) frame = encodeWsFrame(wsMsgQueue.front().second, WEBSOCKET_OP_BINARY);
+				ConnectionT &connectionT = *slotIt;
+				if (connectionT.wsMsgQueue.size() >= hostOption.WsBacklogLimit) // slow client, drop the oldest
 				{
-					connectionIt->second.wsMsgQueue.push(wsMsgQueue.front().second);
-					continue;
+					connectionT.wsMsgQueue.pop_front();
+					connectionT.wsDropCount++;
 				}
-				if (!mg_globmatch(connectionIt->second.uriOption.uri.c_str(),
-				                  connectionIt->second.uriOption.uri.size(),
-				                  wsMsgQueue.front().first.c_str(),
-				                  wsMsgQueue.front().first.size())) continue; // uri not matched
-				connectionIt->second.wsMsgQueue.push(wsMsgQueue.front().second);
+				connectionT.wsMsgQueue.push_back(frame);
 			}
 			wsMsgQueue.pop();
 		}
 
 		mg_mgr_poll(&mgr, 0);
-		// printf("[loop]Active Connection %zu\n", connectionMap.size());
+		// printf("[loop]Active Connection %zu\n", slab.size() - freeSlots.size());
 	}
 	void addUri(UriOption uriOption)
 	{
+		// static files are read once here, later requests served from memory
+		if (uriOption.type == UriOption::TypeServefile) assetCache.loadFile(uriOption.filepath);
+		if (uriOption.type == UriOption::TypeServedir) assetCache.loadDir(uriOption.filepath);
 		uriOptionVec.push_back(uriOption);
 	}
 	/// this is not thread safe so dont call at other thread !!!
@@ -262,19 +343,84 @@ public:
 	/// this is not thread safe so dont call at other thread !!!
 	int setResponse(unsigned long cId, Response response)
 	{
-		auto iterator = connectionMap.find(cId);
-		if (iterator == connectionMap.end()) return -1; // id not found
-		connectionMap[cId].response.copy(response);
+		ConnectionT *connectionT = findSlot(cId);
+		if (connectionT == NULL) return -1; // id not found or connection already gone
+		connectionT->response.copy(response);
 		return 0;
 	}
 
 private:
 	const HostOption hostOption;
-	std::map<unsigned long, ConnectionT> connectionMap;
+	// Connections live in a slab reserved once, freed slots are reused from freeSlots.
+	// Slot id = generation << 16 | index, kept in c->data and handed out as Request::cId.
+	static const uint32_t SlotIndexBits = 16;
+	static const uint32_t SlotIndexMask = (1u << SlotIndexBits) - 1;
+	std::vector<ConnectionT> slab; // never grow past the reserve, so slot address stay same
+	std::vector<uint32_t> freeSlots;
 	std::vector<UriOption> uriOptionVec; // use vector because i need "order" access
 	std::queue<std::pair<std::string, std::string>> wsMsgQueue; // is not thread safe
+	LvAssetCache assetCache;
 	struct mg_mgr mgr;
 
+	size_t slabCapacity() const
+	{
+		uint64_t capacity = hostOption.ConnLimit == 0 ? 1024 : hostOption.ConnLimit;
+		return capacity > SlotIndexMask ? SlotIndexMask : capacity;
+	}
+
+	// take a free slot for new connection, return NULL when slab full
+	ConnectionT *allocSlot(struct mg_connection *c)
+	{
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else if (slab.size() < slab.capacity())
+		{
+			index = slab.size();
+			slab.emplace_back();
+		}
+		else return NULL;
+
+		ConnectionT &connectionT = slab[index];
+		connectionT.inUse = true;
+		connectionT.reset(mg_millis());
+		uint32_t slotId = ((uint32_t)connectionT.generation << SlotIndexBits) | index;
+		memcpy(c->data, &slotId, sizeof(slotId));
+		return &connectionT;
+	}
+
+	ConnectionT *findSlot(unsigned long slotId)
+	{
+		uint32_t index = slotId & SlotIndexMask;
+		if (index >= slab.size()) return NULL;
+		ConnectionT &connectionT = slab[index];
+		if (!connectionT.inUse || connectionT.generation != (slotId >> SlotIndexBits)) return NULL;
+		return &connectionT;
+	}
+
+	// connection without slot (listener or rejected) have id 0, generation never 0 so never found
+	ConnectionT *findSlot(struct mg_connection *c)
+	{
+		uint32_t slotId;
+		memcpy(&slotId, c->data, sizeof(slotId));
+		return findSlot(slotId);
+	}
+
+	void freeSlot(struct mg_connection *c)
+	{
+		ConnectionT *connectionT = findSlot(c);
+		if (connectionT == NULL) return;
+		connectionT->releaseRequest();
+		connectionT->wsMsgQueue.clear();
+		connectionT->inUse = false;
+		if (++connectionT->generation == 0) connectionT->generation = 1;
+		freeSlots.push_back(connectionT - slab.data());
+		memset(c->data, 0, sizeof(uint32_t));
+	}
+
 	static void cb(struct mg_connection *c, int ev, void *ev_data)
 	{
 		switch (ev)
@@ -294,10 +440,11 @@ private:
 			}
 
 			Server &server = *((Server*)c->fn_data);
-			server.connectionMap[c->id] = {}; // create connection
-			ConnectionT &connectionT = server.connectionMap[c->id];
-			connectionT.bornMs = mg_millis();
-			connectionT.status = ConnectionT::StatusWaitForRequest;
+			if (server.allocSlot(c) == NULL)
+			{
+				MG_ERROR(("Connection slab full"));
+				c->is_closing = 1;
+			}
 		}
 		break;
 		case MG_EV_WRITE:
@@ -306,7 +453,7 @@ private:
 			// printf("[Server][MG_EV_WRITE] c->id: %lu bytes_written: %ld\n", c->id, *bytes_written);
 
 			// Server &server = *((Server*)c->fn_data);
-			// ConnectionT &connectionT = server.connectionMap[c->id];
+			// ConnectionT &connectionT = *server.findSlot(c);
 			// // reborn
 			// connectionT.bornMs = mg_millis();
 		}
@@ -314,7 +461,9 @@ private:
 		case MG_EV_READ:
 		{
 			Server &server = *((Server*)c->fn_data);
-			ConnectionT &connectionT = server.connectionMap[c->id];
+			ConnectionT *slot = server.findSlot(c);
+			if (slot == NULL) break;
+			ConnectionT &connectionT = *slot;
 			if (server.hostOption.ReadLimit == 0) break; // if ReadLimit == 0 dont limit
 			if (c->recv.len > server.hostOption.ReadLimit)
 			{
@@ -332,47 +481,37 @@ private:
 		case MG_EV_HTTP_MSG:
 		{
 			Server &server = *((Server*)c->fn_data);
-			ConnectionT &connectionT = server.connectionMap[c->id];
-			connectionT.requestStr.assign((const char*)c->recv.buf, c->recv.len);
-			int parseRc = mg_http_parse(connectionT.requestStr.c_str(),
-			                            connectionT.requestStr.size(),
-			                            &connectionT.hm);
-			// MG_INFO(("[MG_EV_HTTP_MSG][%lu] parseRc %d c->recv.len:%lu",
-			//          c->id, parseRc, c->recv.len));
+			ConnectionT *slot = server.findSlot(c);
+			if (slot == NULL) break;
+			ConnectionT &connectionT = *slot;
+			struct mg_http_message *hm = (struct mg_http_message *) ev_data;
 			// MG_INFO(("[MG_EV_HTTP_MSG][%lu] %.*s", c->id,
-			//          (int) c->recv.len, c->recv.buf));
-
-			if (parseRc >= 0)
-			{
-				// MG_INFO(("[MG_EV_HTTP_MSG][%lu] uri %.*s", c->id,
-				//          (int) connectionT.hm.uri.len, connectionT.hm.uri.ptr));
-
-				// sanity check for whole message size
-				// worry if body is corrupted
-				size_t bodyLen = connectionT.requestStr.size() - parseRc;
-				if (connectionT.hm.body.len != bodyLen) // something wrong
-				{
-					MG_ERROR(("Something Wrong!!! body size not same %lu:%lu", connectionT.hm.body.len, bodyLen));
-					break;// dont proceed
-				}
-				// OK can proceed
-
-				std::string uri = std::string(connectionT.hm.uri.ptr, connectionT.hm.uri.len);
-				Method method = MethodGet;
-				if (connectionT.hm.method.len >= 3)
-					method = (strncmp("GET", connectionT.hm.method.ptr, 3) == 0) ? MethodGet : MethodPost;
-
-				std::string body = std::string(connectionT.hm.body.ptr, bodyLen);
-				std::string header = std::string(connectionT.hm.head.ptr, connectionT.hm.head.len);
-				connectionT.request = Request(uri, method, body, header, c->id);
-				connectionT.status = ConnectionT::StatusResolvingUri;
-			}
+			//          (int) hm->message.len, hm->message.ptr));
+
+			// mongoose already parsed the request in c->recv and deletes just this message after the event,
+			// pipelined bytes stay there; copy it once into the slot request so hm stays valid until the response is done
+			connectionT.takeRequest(*hm);
+
+			connectionT.request.uri.assign(hm->uri.ptr, hm->uri.len);
+			connectionT.request.query.assign(hm->query.ptr, hm->query.len);
+			connectionT.request.method = MethodGet;
+			if (hm->method.len >= 3)
+				connectionT.request.method = (strncmp("GET", hm->method.ptr, 3) == 0) ? MethodGet : MethodPost;
+			char remoteIp[48];
+			mg_snprintf(remoteIp, sizeof(remoteIp), "%M", mg_print_ip, &c->rem);
+			connectionT.request.remoteIp = remoteIp;
+			uint32_t slotId;
+			memcpy(&slotId, c->data, sizeof(slotId));
+			connectionT.request.cId = slotId;
+			connectionT.status = ConnectionT::StatusResolvingUri;
 		}
 		break;
 		case MG_EV_WS_MSG:
 		{
 			Server &server = *((Server*)c->fn_data);
-			ConnectionT &connectionT = server.connectionMap[c->id];
+			ConnectionT *slot = server.findSlot(c);
+			if (slot == NULL) break;
+			ConnectionT &connectionT = *slot;
 
 			struct mg_ws_message *wm = (struct mg_ws_message *) ev_data;
 			if (connectionT.uriOption.onWsMsgCallback != NULL)
@@ -395,10 +534,10 @@ private:
 		break;
 		case MG_EV_POLL:
 		{
-			if (c->id == 1) break; // first connection is for listener
-
 			Server &server = *((Server*)c->fn_data);
-			ConnectionT &connectionT = server.connectionMap[c->id];
+			ConnectionT *slot = server.findSlot(c);
+			if (slot == NULL) break; // listener or rejected connection dont have slot
+			ConnectionT &connectionT = *slot;
 
 			// printf("[MG_EV_POLL][%lu] connectionT.status %d\n", c->id, connectionT.status);
 			uint64_t nowMs = mg_millis();
@@ -420,14 +559,13 @@ private:
 					mg_ws_send(c, "", 0, WEBSOCKET_OP_PING);
 				}
 
-				// dequeue and send msg
-				while (!connectionT.wsMsgQueue.empty())
+				// dequeue and send the encoded frames, leave them queued while the socket buffer is full
+				while (!connectionT.wsMsgQueue.empty() && c->send.len < server.hostOption.WsSendBufLimit)
 				{
-					mg_ws_send(c,
-					           connectionT.wsMsgQueue.front().c_str(),
-					           connectionT.wsMsgQueue.front().size(),
-					           WEBSOCKET_OP_BINARY);
-					connectionT.wsMsgQueue.pop();
+					mg_send(c,
+					        connectionT.wsMsgQueue.front()->data(),
+					        connectionT.wsMsgQueue.front()->size());
+					connectionT.wsMsgQueue.pop_front();
 				}
 
 			}
@@ -472,9 +610,15 @@ private:
 				// Run Callback to get response
 				if (connectionT.uriOption.onRequestCallback != NULL)
 				{
-					connectionT.response = connectionT.uriOption.onRequestCallback(
-					                           connectionT.uriOption.onRequestCallbackDataPtr,
-					                           connectionT.request);
+					// a restful reply does not read hm or the request, hand the request over instead of copying it
+					if (connectionT.uriOption.type == UriOption::TypeRestful)
+						connectionT.response = connectionT.uriOption.onRequestCallback(
+						                           connectionT.uriOption.onRequestCallbackDataPtr,
+						                           std::move(connectionT.request));
+					else
+						connectionT.response = connectionT.uriOption.onRequestCallback(
+						                           connectionT.uriOption.onRequestCallbackDataPtr,
+						                           connectionT.request);
 				}
 				// MG_INFO(("returnCode %d", connectionT.response.returnCode));
 				connectionT.status = ConnectionT::StatusWaitForResponse;
@@ -528,7 +672,9 @@ private:
 					opts.fs = NULL;											// struct mg_fs *fs;           // Filesystem implementation. Use NULL for POSIX
 					MG_INFO(("Serve %s with mime: %s",
 					         connectionT.uriOption.filepath.c_str(), connectionT.uriOption.mime.c_str()));
-					mg_http_serve_file(c, &connectionT.hm, connectionT.uriOption.filepath.c_str(), &opts);
+					if (!server.assetCache.serveFile(c, &connectionT.hm, connectionT.uriOption.filepath,
+					                                 extra_headers, connectionT.uriOption.mime))
+						mg_http_serve_file(c, &connectionT.hm, connectionT.uriOption.filepath.c_str(), &opts);
 					c->is_resp = 0; //when your event handler finished writing its response. set to 0
 					connectionT.status = ConnectionT::StatusWaitForSend;
 				}
@@ -589,11 +735,13 @@ private:
 					opts.page404 = NULL;									// const char *page404;        // Path to the 404 page, or NULL by default
 					opts.fs = NULL;											// struct mg_fs *fs;           // Filesystem implementation. Use NULL for POSIX
 
-					mg_http_serve_dir(c, &connectionT.hm, &opts);
+					if (!server.assetCache.serveDir(c, &connectionT.hm, connectionT.uriOption.filepath))
+						mg_http_serve_dir(c, &connectionT.hm, &opts);
 					connectionT.status = ConnectionT::StatusWaitForSend;
 				}
 				break;
 				}
+				connectionT.releaseRequest(); // response written, request buffer not needed anymore
 			}
 			if (connectionT.status == ConnectionT::StatusWaitForSend)
 			{
@@ -606,13 +754,12 @@ private:
 		break;
 		case MG_EV_CLOSE:
 		{
-			if (c->id == 1) break; // first connection is for listener
 			// MG_INFO(("[%lu] connection closed", c->id));
 			Server &server = *((Server*)c->fn_data);
-			// ConnectionT &connectionT = server.connectionMap[c->id];
+			// ConnectionT &connectionT = *server.findSlot(c);
 			// if (connectionT.status == ConnectionT::StatusTimeout)
 			// 	MG_ERROR(("[%lu] because of timeout", c->id));
-			server.connectionMap.erase(c->id);
+			server.freeSlot(c);
 		}
 		break;
 		}
@@ -623,6 +770,33 @@ private:
 		for (struct mg_connection *t = mgr->conns; t != NULL; t = t->next) n++;
 		return n;
 	}
+
+	// server to client websocket frame, not masked, same layout mg_ws_send write
+	static std::shared_ptr<const std::string> encodeWsFrame(const std::string &payload, int op)
+	{
+		std::string frame;
+		size_t len = payload.size();
+		frame.reserve(len + 10);
+		frame.push_back((char)(0x80 | (op & 0x0F))); // FIN + opcode
+		if (len < 126)
+		{
+			frame.push_back((char)len);
+		}
+		else if (len < 65536)
+		{
+			frame.push_back((char)126);
+			frame.push_back((char)((len >> 8) & 0xFF));
+			frame.push_back((char)(len & 0xFF));
+		}
+		else
+		{
+			frame.push_back((char)127);
+			for (int shift = 56; shift >= 0; shift -= 8)
+				frame.push_back((char)(((uint64_t)len >> shift) & 0xFF));
+		}
+		frame.append(payload);
+		return std::make_shared<const std::string>(std::move(frame));
+	}
 };
 
 }
@@ -668,7 +842,7 @@ private:
 		// printf("[OnRequestCallback] request.uri %s\n", request.uri.c_str());
 		// printf("[OnRequestCallback] request.method %d\n", request.method);
 		// printf("[OnRequestCallback] request.response %s\n", request.body.c_str());
-		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, request});
+		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, std::move(request)});
 
 		return LvHttpServer::Response(LvHttpServer::Response::ReturnCodePending, ""); // set to pending to set response later
 	}
@@ -677,14 +851,14 @@ private:
 	{
 		// can do some file prepare etc. compress or save config to file
 		//printf("[OnServefileCallback] request.uri %s\n", request.uri.c_str());
-		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, request});
+		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, std::move(request)});
 
 		return LvHttpServer::Response(LvHttpServer::Response::ReturnCodePending, "");
 	}
 
 	static void OnFileStoredCallback(void *self, LvHttpServer::Request request, const std::string& filepath)
 	{
-		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, request});
+		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, std::move(request)});
 	}
 
 	static LvHttpServer::Response OnWebsocketCallback(void* self, LvHttpServer::Request request)
@@ -696,7 +870,7 @@ private:
 		// previous code do this for future need to pass the header out for check the login
 		// the previous code use Sec-WebSocket-Protocol header to store the password lol?
 		request.body = extract_header(request.header, "Sec-WebSocket-Protocol");
-		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, request});
+		(*(LvRestfulServer*)self).restfulQueue.push({request.cId, std::move(request)});
 
 		return LvHttpServer::Response(LvHttpServer::Response::ReturnCodePending, "");
 	}
@@ -856,14 +1030,17 @@ public:
 	{
 	}
 
-	int get(unsigned long &id, std::string &body, std::string *uri = NULL, std::string *method = NULL)
+	int get(unsigned long &id, std::string &body, std::string *uri = NULL, std::string *method = NULL, std::string *query = NULL,
+	        std::string *remoteIp = NULL)
 	{
 		if (restfulQueue.empty()) return -1;
 
 		id = restfulQueue.front().first;
-		body = restfulQueue.front().second.body;
-		if (uri != NULL) *uri = restfulQueue.front().second.uri;
+		body.swap(restfulQueue.front().second.body); // popped right after, no need to copy
+		if (uri != NULL) uri->swap(restfulQueue.front().second.uri);
 		if (method != NULL) *method = (restfulQueue.front().second.method == LvHttpServer::MethodGet) ? "GET" : "POST";
+		if (query != NULL) query->swap(restfulQueue.front().second.query);
+		if (remoteIp != NULL) remoteIp->swap(restfulQueue.front().second.remoteIp);
 
 		restfulQueue.pop();
 		return 0;
@@ -0,0 +1,63 @@
+// #include "LvSPSCQueue.h"
+#ifndef LV_SPSC_QUEUE_H
+#define LV_SPSC_QUEUE_H
+
+#include <atomic> // std::atomic
+#include <cstddef> // size_t
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The element is written and read in place: claim() / publish() at the producer,
+// front() / release() at the consumer, so a large element is never copied.
+// Capacity must be power of 2.
+template <typename T, size_t Capacity>
+class LvSPSCQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of 2");
+public:
+	LvSPSCQueue()
+	{
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	// producer only, the slot to fill or NULL when full
+	T *claim()
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		if (pos - tail.load(std::memory_order_acquire) == Capacity) return NULL;
+		return &cells[pos & (Capacity - 1)];
+	}
+
+	// producer only, make the claimed slot visible to the consumer
+	void publish()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// consumer only, the oldest element or NULL when empty
+	T *front()
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		if (pos == head.load(std::memory_order_acquire)) return NULL;
+		return &cells[pos & (Capacity - 1)];
+	}
+
+	// consumer only, give the slot of front() back to the producer
+	void release()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// either thread, may be stale
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	T cells[Capacity];
+	alignas(64) std::atomic<size_t> head; // next slot to fill, written by the producer
+	alignas(64) std::atomic<size_t> tail; // next slot to read, written by the consumer
+};
+
+#endif // LV_SPSC_QUEUE_H
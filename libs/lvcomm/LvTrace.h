@@ -0,0 +1,225 @@
+// #include "LvTrace.h"
+#ifndef LV_TRACE_H
+#define LV_TRACE_H
+
+#include <string>
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm> // std::remove_if
+#include <cstdio> // fopen, snprintf
+#include <cstdint> // uint64_t
+#include <unistd.h> // getpid
+
+#define LV_TRACE_CONCAT_(a, b) a##b
+#define LV_TRACE_CONCAT(a, b) LV_TRACE_CONCAT_(a, b)
+
+// LV_TRACE_SCOPE("camera.poll") traces the rest of the enclosing block, the name must be a string literal
+#define LV_TRACE_SCOPE(name) LvTrace::Scope LV_TRACE_CONCAT(lvTraceScope, __LINE__)(name)
+
+// Flight recorder of the time spent in named scopes, dumped as Chrome trace events
+// (open the file in chrome://tracing or ui.perfetto.dev for a flame chart per thread).
+// Always compiled in, off until enable(true): a scope then costs one relaxed atomic load.
+// When on, each thread writes complete events (begin + duration) into its own ring,
+// the oldest events are overwritten so the dump holds the last ringSize scopes of every thread.
+class LvTrace
+{
+public:
+	static LvTrace &instance()
+	{
+		static LvTrace trace;
+		return trace;
+	}
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char *_name)
+			: name(_name), startUs(LvTrace::instance().isEnabled() ? nowUs() : 0)
+		{}
+		~Scope()
+		{
+			if (startUs != 0) LvTrace::instance().add(name, startUs, nowUs() - startUs);
+		}
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		const char *name;
+		uint64_t startUs; // 0 when the trace was off at the begin
+	};
+
+	void enable(bool on)
+	{
+		enabled.store(on, std::memory_order_relaxed);
+	}
+
+	bool isEnabled() const
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	// name shown for the calling thread, string literal
+	void setThreadName(const char *name)
+	{
+		ThreadRing &ring = threadRing();
+		std::lock_guard<std::mutex> lock(ring.mtx);
+		ring.name = name;
+	}
+
+	// {"traceEvents":[...],"displayTimeUnit":"ms"}, safe at any thread
+	std::string json()
+	{
+		std::vector<std::shared_ptr<ThreadRing>> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(ringsMtx);
+			snapshot = rings;
+		}
+
+		int pid = getpid();
+		std::string out = "{\"traceEvents\":[";
+		bool first = true;
+		char buf[160];
+		for (const auto &ring : snapshot)
+		{
+			std::lock_guard<std::mutex> lock(ring->mtx);
+			if (ring->name != NULL)
+			{
+				snprintf(buf, sizeof(buf), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+				         first ? "" : ",", pid, ring->tid);
+				out += buf;
+				appendString(out, ring->name);
+				out += "}}";
+				first = false;
+			}
+			size_t count = ring->written < ring->events.size() ? ring->written : ring->events.size();
+			for (size_t i = ring->written - count; i < ring->written; ++i)
+			{
+				const Event &event = ring->events[i % ring->events.size()];
+				snprintf(buf, sizeof(buf), "%s{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%llu,\"dur\":%u,\"name\":",
+				         first ? "" : ",", pid, ring->tid, (unsigned long long)(event.startUs - originUs), event.durUs);
+				out += buf;
+				appendString(out, event.name);
+				out += "}";
+				first = false;
+			}
+		}
+		out += "],\"displayTimeUnit\":\"ms\"}";
+		removeEndedRings();
+		return out;
+	}
+
+	// return 0 OK, -1 cannot write the file
+	int dump(const std::string &filepath)
+	{
+		std::string content = json();
+		FILE *file = fopen(filepath.c_str(), "w");
+		if (file == NULL) return -1;
+		size_t written = fwrite(content.data(), 1, content.size(), file);
+		fclose(file);
+		return written == content.size() ? 0 : -1;
+	}
+
+	// events kept per thread, applies to the threads that start tracing afterward
+	void setRingSize(size_t size)
+	{
+		if (size > 0) ringSize.store(size, std::memory_order_relaxed);
+	}
+
+	static uint64_t nowUs()
+	{
+		using namespace std::chrono;
+		return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	struct Event
+	{
+		const char *name;
+		uint64_t startUs;
+		uint32_t durUs;
+	};
+
+	struct ThreadRing
+	{
+		std::mutex mtx; // the owner thread and a dump only, no contention outside a dump
+		std::vector<Event> events;
+		uint64_t written = 0; // events ever written, the next slot is written % size
+		const char *name = NULL;
+		uint32_t tid;
+		std::atomic<bool> ended{false}; // thread ended, removed after its next dump
+	};
+
+	// registered at the first event of a thread, marked ended when the thread ends
+	struct RingHolder
+	{
+		std::shared_ptr<ThreadRing> ring;
+		RingHolder(LvTrace &trace)
+			: ring(std::make_shared<ThreadRing>())
+		{
+			trace.addRing(ring);
+		}
+		~RingHolder()
+		{
+			ring->ended = true;
+		}
+	};
+
+	std::atomic<bool> enabled{false};
+	std::atomic<size_t> ringSize{8192}; // 24 B each
+	const uint64_t originUs = nowUs(); // trace time 0
+	std::vector<std::shared_ptr<ThreadRing>> rings;
+	std::mutex ringsMtx; // only taken when a thread starts tracing and by a dump
+	uint32_t nextTid = 1;
+
+	LvTrace() {}
+
+	ThreadRing &threadRing()
+	{
+		thread_local RingHolder holder(*this);
+		return *holder.ring;
+	}
+
+	void addRing(const std::shared_ptr<ThreadRing> &ring)
+	{
+		ring->events.resize(ringSize.load(std::memory_order_relaxed));
+		std::lock_guard<std::mutex> lock(ringsMtx);
+		ring->tid = nextTid++;
+		rings.push_back(ring);
+	}
+
+	void add(const char *name, uint64_t startUs, uint64_t durUs)
+	{
+		ThreadRing &ring = threadRing();
+		std::lock_guard<std::mutex> lock(ring.mtx);
+		Event &event = ring.events[ring.written % ring.events.size()];
+		event.name = name;
+		event.startUs = startUs;
+		event.durUs = durUs > UINT32_MAX ? UINT32_MAX : (uint32_t)durUs;
+		ring.written++;
+	}
+
+	void removeEndedRings()
+	{
+		std::lock_guard<std::mutex> lock(ringsMtx);
+		rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<ThreadRing> &ring)
+		{
+			return ring->ended.load();
+		}), rings.end());
+	}
+
+	static void appendString(std::string &out, const char *str)
+	{
+		out += '"';
+		for (const char *p = str; *p; ++p)
+		{
+			if (*p == '"' || *p == '\\') out += '\\';
+			out += *p;
+		}
+		out += '"';
+	}
+};
+
+#endif // LV_TRACE_H
@@ -0,0 +1,107 @@
+#include "FakeCamera.h"
+#include <pthread.h>
+#include <time.h>
+
+//Constructor
+FakeCameras::FakeCameras(CountCallback countCallback, void* self)
+    : countCallback(countCallback), self(self) {
+    mg_mgr_init(&mgr);
+}
+
+FakeCameras::~FakeCameras() {
+    stop();
+    mg_mgr_free(&mgr);
+}
+
+int FakeCameras::add(int port) {
+    cameras.push_back({this, cameras.size()});
+    std::string address = "http://127.0.0.1:" + std::to_string(port);
+    if (mg_http_listen(&mgr, address.c_str(), handler, &cameras.back()) == NULL) {
+        cameras.pop_back();
+        return -1;
+    }
+    return 0;
+}
+
+void FakeCameras::setLatency(int latencyMs, int jitterMs, unsigned int seed) {
+    this->latencyMs = latencyMs;
+    this->jitterMs = jitterMs;
+    rng.seed(seed);
+}
+
+void FakeCameras::start() {
+    running = true;
+    serverThread = std::thread(&FakeCameras::run, this);
+}
+
+void FakeCameras::stop() {
+    running = false;
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
+}
+
+double FakeCameras::getCpuSeconds() {
+    clockid_t clock;
+    struct timespec ts;
+    if (!serverThread.joinable() || pthread_getcpuclockid(serverThread.native_handle(), &clock) != 0 ||
+        clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void FakeCameras::run() {
+    while (running) {
+        mg_mgr_poll(&mgr, delayed.empty() ? 10 : 1); // 1 ms steps while answers are held back
+    }
+}
+
+void FakeCameras::reply(struct mg_connection* c, int status, const std::string& body) {
+    if (status == 0) {
+        return; // no answer at all, the client gives up on its own
+    }
+    mg_http_reply(c, status, "Content-Type: application/json\r\n", "%s", body.c_str());
+}
+
+// the accepted connections get the fn_data of their listener, so the camera is known here
+// the held back answers go out from the poll event of their connection
+void FakeCameras::handler(struct mg_connection* c, int ev, void* ev_data) {
+    Camera& camera = *(Camera*)c->fn_data;
+    FakeCameras& owner = *camera.owner;
+    if (ev == MG_EV_POLL || ev == MG_EV_CLOSE) {
+        auto it = owner.delayed.find(c->id);
+        if (it != owner.delayed.end() && (ev == MG_EV_CLOSE || mg_millis() >= it->second.dueMs)) {
+            if (ev == MG_EV_POLL) {
+                owner.reply(c, it->second.status, it->second.body);
+            }
+            owner.delayed.erase(it);
+        }
+        return;
+    }
+    if (ev != MG_EV_HTTP_MSG) {
+        return;
+    }
+    struct mg_http_message* hm = (struct mg_http_message*)ev_data;
+    owner.requests++;
+
+    if (mg_vcmp(&hm->method, "HEAD") == 0) {
+        mg_http_reply(c, 200, "", "");
+        return;
+    }
+    if (!mg_http_match_uri(hm, "/api/v1/count")) {
+        mg_http_reply(c, 404, "", "Not found\n");
+        return;
+    }
+    std::string body;
+    int status = owner.countCallback(owner.self, camera.index, body);
+    if (owner.latencyMs <= 0 && owner.jitterMs <= 0) {
+        owner.reply(c, status, body);
+        return;
+    }
+    int delayMs = owner.latencyMs;
+    if (owner.jitterMs > 0) {
+        delayMs += std::uniform_int_distribution<int>(0, owner.jitterMs)(owner.rng);
+    }
+    owner.delayed[c->id] = {(uint64_t)mg_millis() + delayMs, status, body};
+}
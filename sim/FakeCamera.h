@@ -0,0 +1,67 @@
+#ifndef FAKE_CAMERA_H
+#define FAKE_CAMERA_H
+
+#include "mongoose.h"
+#include <string>
+#include <deque>
+#include <map>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+// Local stand-ins for the cameras, each one an HTTP listener on 127.0.0.1:<port> answering
+// GET /api/v1/count and the HEAD probe of CameraLiveness, served at their own thread.
+// The count body comes from a callback so the simulation decides what every camera sees.
+// An answer can be held back for a latency plus a random jitter, the other cameras are served meanwhile.
+class FakeCameras {
+public:
+    // Method to fill the count body of a camera (index in the add order), returns the HTTP status code,
+    // 0 to leave the request without answer (the client times out), called at the server thread
+    typedef int (*CountCallback)(void* self, size_t camera, std::string& body);
+
+    FakeCameras(CountCallback countCallback, void* self);
+    ~FakeCameras();
+
+    // Method to add a camera before start, returns -1 when the port cannot be listened on
+    int add(int port);
+    // Method to hold every count answer latencyMs plus up to jitterMs, before start
+    void setLatency(int latencyMs, int jitterMs, unsigned int seed);
+    void start();
+    void stop();
+
+    uint64_t getRequests() const { return requests.load(); }
+    // CPU time of the server thread, to tell the cameras apart from the box in the same process
+    double getCpuSeconds();
+
+private:
+    struct Camera {
+        FakeCameras* owner;
+        size_t index;
+    };
+
+    // count answer held back for the latency, by connection id
+    struct Answer {
+        uint64_t dueMs;
+        int status;
+        std::string body;
+    };
+
+    struct mg_mgr mgr;
+    std::deque<Camera> cameras; // stable addresses, given to mongoose as fn_data
+    CountCallback countCallback;
+    void* self;
+    std::thread serverThread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> requests{0};
+    int latencyMs = 0;
+    int jitterMs = 0;
+    std::mt19937 rng;
+    std::map<unsigned long, Answer> delayed; // server thread only
+
+    static void handler(struct mg_connection* c, int ev, void* ev_data);
+    void run();
+    void reply(struct mg_connection* c, int status, const std::string& body);
+};
+
+#endif // FAKE_CAMERA_H
@@ -0,0 +1,17 @@
+#ifndef QUIET_H
+#define QUIET_H
+
+#include <iostream>
+
+// Silences the std::cout chatter of the module constructors while in scope, used by the bench.
+// Only while no module thread runs, swapping the buffer of std::cout while another thread writes is a data race,
+// the sim and the farm silence std::cout once in main() instead.
+class Quiet {
+public:
+    Quiet() : saved(std::cout.rdbuf(nullptr)) {}
+    ~Quiet() { std::cout.rdbuf(saved); }
+private:
+    std::streambuf* saved;
+};
+
+#endif // QUIET_H
@@ -0,0 +1,65 @@
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include "LvJSON.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+// Configs of the bench, the sim and the farm, written from a template of the box config.
+// The journal and state files are moved under the run prefix so a run never touches the box files.
+class SimConfig {
+public:
+    static std::string readFile(const std::string& filepath) {
+        std::ifstream file(filepath.c_str());
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    // Method to parse a config template, throws std::string when it has no camera to copy
+    static void load(LvJSON& doc, const std::string& templateFile) {
+        doc.Parse(readFile(templateFile).c_str());
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("camera_config") || !doc["camera_config"].IsArray() ||
+            doc["camera_config"].Empty()) {
+            throw std::string("Cannot use the config template " + templateFile);
+        }
+    }
+
+    // Method to replace the cameras with copies of the first template camera, one per address
+    static void copyFirstCamera(LvJSON& doc, const std::vector<std::string>& ips) {
+        auto& allocator = doc.GetAllocator();
+        LvJSON::Value cameras(rapidjson::kArrayType);
+        for (const auto& ip : ips) {
+            LvJSON::Value camera(doc["camera_config"][0], allocator);
+            camera["ip_address"].SetString(ip.c_str(), allocator);
+            cameras.PushBack(camera, allocator);
+        }
+        doc["camera_config"] = cameras;
+    }
+
+    // Method to put the journal and the state file under prefix
+    static void useFiles(LvJSON& doc, const std::string& prefix, int journalCapacity) {
+        auto& allocator = doc.GetAllocator();
+        LvJSON::Value journal(rapidjson::kObjectType);
+        journal.AddMember("file", LvJSON::Value((prefix + "events.journal").c_str(), allocator), allocator);
+        journal.AddMember("capacity", journalCapacity, allocator);
+        journal.AddMember("flush_interval_ms", 5000, allocator);
+        doc.RemoveMember("journal");
+        doc.AddMember("journal", journal, allocator);
+        LvJSON::Value state(rapidjson::kObjectType);
+        state.AddMember("file", LvJSON::Value((prefix + "iotbox.state").c_str(), allocator), allocator);
+        state.AddMember("flush_interval_ms", 1000, allocator);
+        doc.RemoveMember("state");
+        doc.AddMember("state", state, allocator);
+    }
+
+    // Method to write the config, returns filepath
+    static std::string write(LvJSON& doc, const std::string& filepath) {
+        std::ofstream(filepath.c_str()) << doc.stringify();
+        return filepath;
+    }
+};
+
+#endif // SIM_CONFIG_H
@@ -0,0 +1,156 @@
+#include "SimHardware.h"
+
+#define SIM_IODIR_REG(port) (port)           // IODIRA 0x00, IODIRB 0x01
+#define SIM_GPIO_REG(port) (GPIOA_REG + (port)) // GPIOA 0x12, GPIOB 0x13
+#define SIM_OLAT_REG(port) (0x14 + (port))   // OLATA 0x14, OLATB 0x15
+
+//Constructor, both expanders at their power on state: all pins inputs, latches low
+SimHardware::SimHardware(int mcpAddress1, int mcpAddress2)
+    : nextFd(1000), i2cTransfers(0), gpioWrites(0) {
+    hardwareOps = {&SimHardware::simOpen, &SimHardware::simIoctl, &SimHardware::simClose, this};
+    for (int address : {mcpAddress1, mcpAddress2}) {
+        Expander expander;
+        memset(expander.registers, 0, sizeof(expander.registers));
+        expander.registers[SIM_IODIR_REG(0)] = 0xFF;
+        expander.registers[SIM_IODIR_REG(1)] = 0xFF;
+        expander.registers[SIM_GPIO_REG(0)] = 0xFF; // pulled up inputs
+        expander.registers[SIM_GPIO_REG(1)] = 0xFF;
+        expander.pointer = 0;
+        expanders[address] = expander;
+    }
+}
+
+//Method to set the input levels of port A
+void SimHardware::setInputs(int address, unsigned char portA) {
+    auto it = expanders.find(address);
+    if (it != expanders.end()) {
+        it->second.registers[SIM_GPIO_REG(0)] = portA;
+    }
+}
+
+//Method to get the port B latch, what the expander drives on the output pins
+unsigned char SimHardware::getOutputs(int address) const {
+    auto it = expanders.find(address);
+    return it != expanders.end() ? it->second.registers[SIM_OLAT_REG(1)] : 0;
+}
+
+//Method to get the last value written to an on-board GPIO line, 0 when never written
+int SimHardware::getGpioValue(const std::string& gpiochip, int line) const {
+    auto it = gpioValues.find(lineKey(gpiochip, line));
+    return it != gpioValues.end() ? it->second : 0;
+}
+
+std::string SimHardware::lineKey(const std::string& gpiochip, int line) {
+    return gpiochip + ":" + std::to_string(line);
+}
+
+int SimHardware::simOpen(void* self, const char* path, int /*flags*/) {
+    SimHardware& hardware = *(SimHardware*)self;
+    std::string device = path;
+    int fd = hardware.nextFd++;
+    if (device.compare(0, 9, "/dev/i2c-") == 0) {
+        return fd; // one bus, the fd itself is not looked at
+    }
+    if (device.compare(0, 13, "/dev/gpiochip") == 0) {
+        hardware.gpiochips[fd] = device;
+        return fd;
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+int SimHardware::simIoctl(void* self, int fd, unsigned long request, void* arg) {
+    SimHardware& hardware = *(SimHardware*)self;
+    switch (request) {
+        case I2C_RDWR:
+            return hardware.transfer((struct i2c_rdwr_ioctl_data*)arg);
+        case GPIO_GET_LINEHANDLE_IOCTL:
+            return hardware.lineHandle(fd, (struct gpiohandle_request*)arg);
+        case GPIOHANDLE_SET_LINE_VALUES_IOCTL:
+        case GPIOHANDLE_GET_LINE_VALUES_IOCTL: {
+            auto it = hardware.lineHandles.find(fd);
+            if (it == hardware.lineHandles.end()) {
+                errno = EBADF;
+                return -1;
+            }
+            struct gpiohandle_data* data = (struct gpiohandle_data*)arg;
+            int& value = hardware.gpioValues[lineKey(it->second.gpiochip, it->second.line)];
+            if (request == GPIOHANDLE_SET_LINE_VALUES_IOCTL) {
+                value = data->values[0];
+                hardware.gpioWrites++;
+            } else {
+                data->values[0] = value;
+            }
+            return 0;
+        }
+        default:
+            errno = ENOTTY;
+            return -1;
+    }
+}
+
+int SimHardware::simClose(void* self, int fd) {
+    SimHardware& hardware = *(SimHardware*)self;
+    hardware.gpiochips.erase(fd);
+    hardware.lineHandles.erase(fd);
+    return 0;
+}
+
+//Method to run the messages of one I2C_RDWR, a write sets the register pointer then writes from it,
+//a read reads from the pointer, returns the number of messages like the kernel
+int SimHardware::transfer(struct i2c_rdwr_ioctl_data* data) {
+    i2cTransfers++;
+    for (unsigned int i = 0; i < data->nmsgs; i++) {
+        struct i2c_msg& msg = data->msgs[i];
+        auto it = expanders.find(msg.addr);
+        if (it == expanders.end()) {
+            errno = ENXIO; // no ACK
+            return -1;
+        }
+        Expander& expander = it->second;
+        for (unsigned short n = 0; n < msg.len; n++) {
+            if (!(msg.flags & I2C_M_RD) && n == 0) {
+                expander.pointer = msg.buf[0] % sizeof(expander.registers);
+                continue;
+            }
+            unsigned char reg = expander.pointer;
+            expander.pointer = (expander.pointer + 1) % sizeof(expander.registers);
+            if (msg.flags & I2C_M_RD) {
+                // a GPIO read gives the pin levels, the latch for the outputs and the input level for the inputs
+                if (reg == SIM_GPIO_REG(0) || reg == SIM_GPIO_REG(1)) {
+                    int port = reg - SIM_GPIO_REG(0);
+                    unsigned char iodir = expander.registers[SIM_IODIR_REG(port)];
+                    msg.buf[n] = (expander.registers[reg] & iodir) | (expander.registers[SIM_OLAT_REG(port)] & ~iodir);
+                } else {
+                    msg.buf[n] = expander.registers[reg];
+                }
+                continue;
+            }
+            // a GPIO write goes to the output latch, the input levels stay with the simulation
+            if (reg == SIM_GPIO_REG(0) || reg == SIM_GPIO_REG(1)) {
+                reg = SIM_OLAT_REG(reg - SIM_GPIO_REG(0));
+            }
+            expander.registers[reg] = msg.buf[n];
+            if (reg == SIM_OLAT_REG(1)) {
+                writes.push_back({LvClock::nowMs(), msg.addr, msg.buf[n]});
+            }
+        }
+    }
+    return data->nmsgs;
+}
+
+//Method to hand out a line handle fd of an open gpiochip
+int SimHardware::lineHandle(int fd, struct gpiohandle_request* request) {
+    auto it = gpiochips.find(fd);
+    if (it == gpiochips.end() || request->lines != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    LineHandle handle = {it->second, (int)request->lineoffsets[0]};
+    request->fd = nextFd++;
+    lineHandles[request->fd] = handle;
+    if (request->flags & GPIOHANDLE_REQUEST_OUTPUT) {
+        gpioValues[lineKey(handle.gpiochip, handle.line)] = request->default_values[0];
+    }
+    return 0;
+}
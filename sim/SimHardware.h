@@ -0,0 +1,65 @@
+#ifndef SIM_HARDWARE_H
+#define SIM_HARDWARE_H
+
+#include "ControlModule.h"
+#include "LvClock.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Simulated MCP23017 pair on the I2C bus and on-board GPIO chips, given to ControlModule as its HardwareOps.
+// The port A inputs are set by the simulation, every port B write is kept with the (virtual) time it was written.
+// Not thread safe, ControlModule already serializes its calls and the simulation sets the inputs between them.
+class SimHardware {
+public:
+    struct Write {
+        uint64_t timeMs;
+        int address;
+        unsigned char portB;
+    };
+
+    SimHardware(int mcpAddress1, int mcpAddress2);
+
+    const ControlModule::HardwareOps& ops() const { return hardwareOps; }
+
+    // Method to set the levels on port A of an expander, the pins are pulled up so a low bit is an active input
+    void setInputs(int address, unsigned char portA);
+    unsigned char getOutputs(int address) const;
+    const std::vector<Write>& getWrites() const { return writes; }
+    int getGpioValue(const std::string& gpiochip, int line) const;
+
+    uint64_t getI2CTransfers() const { return i2cTransfers; }
+    uint64_t getGpioWrites() const { return gpioWrites; }
+
+private:
+    struct Expander {
+        unsigned char registers[0x16]; // IOCON.BANK = 0 layout, 0x00 to 0x15
+        unsigned char pointer;
+    };
+
+    struct LineHandle {
+        std::string gpiochip;
+        int line;
+    };
+
+    ControlModule::HardwareOps hardwareOps;
+    std::map<int, Expander> expanders; // by I2C address
+    std::map<int, std::string> gpiochips; // open chip fds
+    std::map<int, LineHandle> lineHandles; // open line fds
+    std::map<std::string, int> gpioValues; // "<gpiochip>:<line>" to value
+    std::vector<Write> writes;
+    int nextFd;
+    uint64_t i2cTransfers;
+    uint64_t gpioWrites;
+
+    static int simOpen(void* self, const char* path, int flags);
+    static int simIoctl(void* self, int fd, unsigned long request, void* arg);
+    static int simClose(void* self, int fd);
+
+    int transfer(struct i2c_rdwr_ioctl_data* data);
+    int lineHandle(int fd, struct gpiohandle_request* request);
+    static std::string lineKey(const std::string& gpiochip, int line);
+};
+
+#endif // SIM_HARDWARE_H
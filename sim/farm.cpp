@@ -0,0 +1,439 @@
+// Camera farm load generator: N fake cameras on localhost (FakeCameras) with answer latency, jitter,
+// errors, timeouts and moving counts, polled by the real CameraManager on the real clock, one step per N.
+// Shows where a box in gateway mode stops keeping up as the camera count grows: a pass polls the due cameras
+// one after the other, so the pass time and the gap between two polls of a camera grow with N.
+//
+// Usage: meow_farm [--profile sim/scenarios/farm_scaling.json] [--config json/config.json]
+//                  [--cameras 1,8,64] [--step <s>]
+//   --profile   camera counts, step length, answer latency and failures, traffic, see sim/scenarios
+//   --config    box config, the first camera is repeated N times on the fake camera ports,
+//               the journal and state files go to /tmp, run from the repo root for the defaults
+//   --cameras   overrides cameras of the profile
+//   --step      overrides step_s of the profile
+//
+// One JSON line on stdout per step:
+//   cameras, step_s
+//   passes           CameraManager::loop calls that polled, pass_ms their wall time
+//   polls            count requests the cameras got, polls_per_s; errors (503) and timeouts (no answer) among them
+//   poll_gap_ms      time between two count requests of a camera, seen by the camera,
+//                    to read against min_interval_ms (phases_red keeps every camera at the fastest rate);
+//                    late_polls the gaps above max_interval_ms
+//   cpu_box_pct      CPU of the box threads (main loop, liveness prober, broker) over the step, one core is 100
+//   cpu_cameras_pct  CPU of the fake camera thread, left out of cpu_box_pct
+//   rss_kb           resident memory of the process at the end of the step, the fake cameras included
+
+#include "ConfigManager.h"
+#include "ControlModule.h"
+#include "CommModule.h"
+#include "CameraManager.h"
+#include "CameraCapture.h"
+#include "CameraLiveness.h"
+#include "CountHistory.h"
+#include "EventJournal.h"
+#include "StateStore.h"
+#include "LatencyTracker.h"
+#include "SimHardware.h"
+#include "FakeCamera.h"
+#include "SimConfig.h"
+#include "LvClock.h"
+#include "LvHdrHistogram.h"
+#include "LvJSON.h"
+#include "mongoose.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define FARM_MCP23017_ADDR1 0x20
+#define FARM_MCP23017_ADDR2 0x21
+
+struct FarmProfile {
+    std::vector<int> cameras; // camera count of every step
+    uint64_t stepMs;
+    int tickMs; // sleep between two main loop iterations, as the box
+    unsigned int seed;
+    int basePort;
+    int latencyMs; // count answer held back latencyMs plus up to jitterMs
+    int jitterMs;
+    double errorRate; // share of the count requests answered 503
+    double timeoutRate; // share left without answer
+    double vehiclesPerHour; // per detect loop
+    int dwellMinMs;
+    int dwellMaxMs;
+    bool phasesRed; // all AC red inputs on, every camera is polled at the fastest rate
+};
+
+// Method to load the farm profile, throws std::string when malformed
+static FarmProfile loadProfile(const std::string& filepath) {
+    LvJSON doc;
+    if (doc.Parse(SimConfig::readFile(filepath).c_str()).HasParseError() || !doc.IsObject()) {
+        throw std::string("Cannot parse the farm profile " + filepath);
+    }
+    FarmProfile profile;
+    LvJSON::checkType(doc, "cameras", LvJSON::Array);
+    for (const auto& count : doc["cameras"].GetArray()) {
+        if (!count.IsInt() || count.GetInt() <= 0) {
+            throw std::string("Property \"cameras\" must be an array of positive Int");
+        }
+        profile.cameras.push_back(count.GetInt());
+    }
+    LvJSON::checkType(doc, "step_s", LvJSON::Int);
+    LvJSON::checkType(doc, "tick_ms", LvJSON::Int);
+    LvJSON::checkType(doc, "seed", LvJSON::Int);
+    LvJSON::checkType(doc, "base_port", LvJSON::Int);
+    profile.stepMs = (uint64_t)doc["step_s"].GetInt() * 1000;
+    profile.tickMs = doc["tick_ms"].GetInt();
+    profile.seed = doc["seed"].GetInt();
+    profile.basePort = doc["base_port"].GetInt();
+    if (profile.tickMs <= 0) {
+        throw std::string("tick_ms must be positive");
+    }
+
+    LvJSON::checkType(doc, "answer", LvJSON::Object);
+    const auto& answer = doc["answer"];
+    LvJSON::checkType(answer, "latency_ms", LvJSON::Int);
+    LvJSON::checkType(answer, "jitter_ms", LvJSON::Int);
+    LvJSON::checkType(answer, "error_rate", LvJSON::Double);
+    LvJSON::checkType(answer, "timeout_rate", LvJSON::Double);
+    profile.latencyMs = answer["latency_ms"].GetInt();
+    profile.jitterMs = answer["jitter_ms"].GetInt();
+    profile.errorRate = answer["error_rate"].GetDouble();
+    profile.timeoutRate = answer["timeout_rate"].GetDouble();
+    if (profile.latencyMs < 0 || profile.jitterMs < 0 || profile.errorRate < 0 || profile.timeoutRate < 0 ||
+        profile.errorRate + profile.timeoutRate > 1) {
+        throw std::string("latency_ms and jitter_ms must not be negative, error_rate and timeout_rate must be shares");
+    }
+
+    LvJSON::checkType(doc, "traffic", LvJSON::Object);
+    const auto& traffic = doc["traffic"];
+    LvJSON::checkType(traffic, "vehicles_per_hour", LvJSON::Double);
+    LvJSON::checkType(traffic, "dwell_min_ms", LvJSON::Int);
+    LvJSON::checkType(traffic, "dwell_max_ms", LvJSON::Int);
+    profile.vehiclesPerHour = traffic["vehicles_per_hour"].GetDouble();
+    profile.dwellMinMs = traffic["dwell_min_ms"].GetInt();
+    profile.dwellMaxMs = traffic["dwell_max_ms"].GetInt();
+    if (profile.vehiclesPerHour <= 0 || profile.dwellMinMs <= 0 || profile.dwellMaxMs < profile.dwellMinMs) {
+        throw std::string("vehicles_per_hour and dwell_min_ms must be positive, dwell_min_ms not above dwell_max_ms");
+    }
+
+    LvJSON::checkType(doc, "phases_red", LvJSON::Bool);
+    profile.phasesRed = doc["phases_red"].GetBool();
+    return profile;
+}
+
+// Method to read the resident memory of the process
+static long residentKb() {
+    long pages = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == NULL) {
+        return 0;
+    }
+    if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(file);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// One step: N fake cameras and a box polling them for the step length
+class FarmStep {
+public:
+    FarmStep(const FarmProfile& profile, const std::string& configTemplate, size_t cameraCount)
+        : profile(profile), cameraCount(cameraCount), prefix("/tmp/meow_farm_" + std::to_string(getpid()) + "_"),
+          rng(profile.seed), fakeCameras(&FarmStep::onCount, this), hardware(FARM_MCP23017_ADDR1, FARM_MCP23017_ADDR2),
+          gaps(3600000) {
+        configFile = makeConfig(configTemplate);
+        configManager.reset(new ConfigManager(configFile));
+        maxIntervalMs = configManager->getPollingConfig().max_interval_ms;
+        startTraffic();
+    }
+
+    ~FarmStep() {
+        fakeCameras.stop();
+        configManager.reset();
+        unlink(configFile.c_str());
+        unlink((prefix + "events.journal").c_str());
+        unlink((prefix + "iotbox.state").c_str());
+    }
+
+    int run(std::string& result);
+
+private:
+    // Counts of one demand of a camera, drawn as the requests come
+    struct LoopTraffic {
+        int detectLoop;
+        int countLoop;
+        double nextArrivalMs;
+        int arrived;
+        std::vector<uint64_t> leaveMs; // vehicles on the detect loop
+    };
+
+    struct CameraTraffic {
+        std::vector<LoopTraffic> loops;
+        uint64_t lastRequestMs = 0;
+    };
+
+    const FarmProfile profile;
+    const size_t cameraCount;
+    const std::string prefix;
+    std::string configFile;
+    std::mt19937 rng; // fake camera thread once started
+    std::unique_ptr<ConfigManager> configManager;
+    FakeCameras fakeCameras;
+    SimHardware hardware;
+    std::vector<CameraTraffic> cameraTraffic; // fake camera thread once started
+    LvHdrHistogram gaps;
+    std::atomic<uint64_t> countRequests{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> latePolls{0};
+    uint64_t maxIntervalMs = 0;
+
+    std::string makeConfig(const std::string& templateFile);
+    void startTraffic();
+    static int onCount(void* self, size_t camera, std::string& body);
+};
+
+// Method to write the config of the step, the first template camera on every fake camera port
+std::string FarmStep::makeConfig(const std::string& templateFile) {
+    LvJSON doc;
+    SimConfig::load(doc, templateFile);
+    std::vector<std::string> ips;
+    for (size_t i = 0; i < cameraCount; i++) {
+        ips.push_back("127.0.0.1:" + std::to_string(profile.basePort + i));
+    }
+    SimConfig::copyFirstCamera(doc, ips);
+    SimConfig::useFiles(doc, prefix, 65536);
+    doc.RemoveMember("capture");
+    return SimConfig::write(doc, prefix + "config.json");
+}
+
+// Method to set the first arrival of every demand of every camera
+void FarmStep::startTraffic() {
+    std::exponential_distribution<double> gap(profile.vehiclesPerHour / 3600000.0);
+    double now = (double)mg_millis();
+    for (const auto& camConfig : configManager->getCameraConfigs()) {
+        CameraTraffic traffic;
+        for (const auto& demand : camConfig.demands) {
+            traffic.loops.push_back({demand.detect_loop, demand.count_loop, now + gap(rng), 0, {}});
+        }
+        cameraTraffic.push_back(traffic);
+    }
+}
+
+// Count body of a camera now, some requests fail as the profile says, fake camera thread
+int FarmStep::onCount(void* self, size_t camera, std::string& body) {
+    FarmStep& step = *(FarmStep*)self;
+    uint64_t now = mg_millis();
+    CameraTraffic& traffic = step.cameraTraffic[camera];
+    if (traffic.lastRequestMs != 0) {
+        step.gaps.record(now - traffic.lastRequestMs);
+        if (now - traffic.lastRequestMs > step.maxIntervalMs) {
+            step.latePolls++;
+        }
+    }
+    traffic.lastRequestMs = now;
+    step.countRequests++;
+
+    double draw = std::uniform_real_distribution<double>(0, 1)(step.rng);
+    if (draw < step.profile.errorRate) {
+        step.errors++;
+        body = "{\"error\":\"unavailable\"}";
+        return 503;
+    }
+    if (draw < step.profile.errorRate + step.profile.timeoutRate) {
+        step.timeouts++;
+        return 0;
+    }
+
+    std::exponential_distribution<double> gap(step.profile.vehiclesPerHour / 3600000.0);
+    std::uniform_int_distribution<int> dwell(step.profile.dwellMinMs, step.profile.dwellMaxMs);
+    int frameCounts[5] = {0, 0, 0, 0, 0}; // by loop id 1 to 4
+    int accumulateCounts[5] = {0, 0, 0, 0, 0};
+    for (auto& loop : traffic.loops) {
+        while (loop.nextArrivalMs <= now) {
+            loop.arrived++;
+            loop.leaveMs.push_back((uint64_t)loop.nextArrivalMs + dwell(step.rng));
+            loop.nextArrivalMs += gap(step.rng);
+        }
+        loop.leaveMs.erase(std::remove_if(loop.leaveMs.begin(), loop.leaveMs.end(), [now](uint64_t leave) { return leave <= now; }),
+                           loop.leaveMs.end());
+        if (loop.detectLoop >= 1 && loop.detectLoop <= 4) {
+            frameCounts[loop.detectLoop] += loop.leaveMs.size();
+        }
+        if (loop.countLoop >= 1 && loop.countLoop <= 4) {
+            accumulateCounts[loop.countLoop] += loop.arrived;
+        }
+    }
+    body = "{\"data\":[";
+    for (int id = 1; id <= 4; id++) {
+        body += (id > 1 ? ",{\"id\":" : "{\"id\":") + std::to_string(id) +
+                ",\"frame_count\":[" + std::to_string(frameCounts[id]) +
+                "],\"accumulate_count\":[" + std::to_string(accumulateCounts[id]) + "]}";
+    }
+    body += "]}";
+    return 200;
+}
+
+// Method to run the step, std::cout is already silenced by main()
+int FarmStep::run(std::string& result) {
+    for (size_t i = 0; i < cameraCount; i++) {
+        if (fakeCameras.add(profile.basePort + i) != 0) {
+            std::cerr << "Cannot listen on port " << profile.basePort + i << std::endl;
+            return 1;
+        }
+    }
+    fakeCameras.setLatency(profile.latencyMs, profile.jitterMs, profile.seed);
+    fakeCameras.start();
+    hardware.setInputs(FARM_MCP23017_ADDR1, profile.phasesRed ? 0x00 : 0xFF);
+
+    std::unique_ptr<StateStore> stateStore;
+    std::unique_ptr<ControlModule> controlModule;
+    std::unique_ptr<CommModule> commModule;
+    std::unique_ptr<EventJournal> eventJournal;
+    std::unique_ptr<CameraLiveness> cameraLiveness;
+    std::unique_ptr<CountHistory> countHistory;
+    std::unique_ptr<LatencyTracker> latencyTracker;
+    std::unique_ptr<CameraCapture> cameraCapture;
+    std::unique_ptr<CameraManager> cameraManager;
+    {
+        stateStore.reset(new StateStore(*configManager));
+        controlModule.reset(new ControlModule("/dev/i2c-0", FARM_MCP23017_ADDR1, FARM_MCP23017_ADDR2, *configManager, *stateStore,
+                                              &hardware.ops()));
+        commModule.reset(new CommModule("127.0.0.1:" + std::to_string(profile.basePort - 1)));
+        eventJournal.reset(new EventJournal(*configManager));
+        cameraLiveness.reset(new CameraLiveness(*configManager));
+        cameraLiveness->start();
+        countHistory.reset(new CountHistory(*configManager));
+        latencyTracker.reset(new LatencyTracker(*configManager));
+        cameraCapture.reset(new CameraCapture(*configManager));
+        cameraManager.reset(new CameraManager(*configManager, *controlModule, *commModule, *cameraLiveness, *countHistory,
+                                              *eventJournal, *stateStore, *latencyTracker, *cameraCapture));
+        commModule->start();
+    }
+
+    // Same order and sleep as the main loop of the box, on the real clock
+    LvHdrHistogram passes;
+    double cpuStart = cpuSeconds();
+    double camerasCpuStart = fakeCameras.getCpuSeconds();
+    uint64_t start_ms = LvClock::nowMs();
+    for (uint64_t now_ms = start_ms; now_ms - start_ms < profile.stepMs; now_ms = LvClock::nowMs()) {
+        uint64_t requestsBefore = countRequests.load();
+        uint64_t passStartUs = LatencyTracker::nowUs();
+        cameraManager->loop(now_ms);
+        if (countRequests.load() != requestsBefore) {
+            passes.record(LatencyTracker::nowUs() - passStartUs);
+        }
+        eventJournal->loop(now_ms);
+        cameraCapture->loop(now_ms);
+        stateStore->loop(now_ms);
+        commModule->loop(now_ms);
+        std::this_thread::sleep_for(std::chrono::milliseconds(profile.tickMs));
+    }
+    double stepSeconds = (LvClock::nowMs() - start_ms) / 1000.0;
+    double camerasCpu = fakeCameras.getCpuSeconds() - camerasCpuStart;
+    double boxCpu = cpuSeconds() - cpuStart - camerasCpu;
+    long rssKb = residentKb();
+
+    {
+        cameraManager.reset();
+        cameraCapture.reset();
+        cameraLiveness.reset();
+        eventJournal.reset();
+        commModule.reset();
+        controlModule.reset();
+        stateStore.reset();
+    }
+
+    const auto& pollingConfig = configManager->getPollingConfig();
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "{\"cameras\":%zu,\"step_s\":%.0f,\"passes\":%llu,\"pass_ms\":{\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f},"
+             "\"polls\":%llu,\"polls_per_s\":%.1f,\"errors\":%llu,\"timeouts\":%llu,"
+             "\"min_interval_ms\":%d,\"max_interval_ms\":%d,"
+             "\"poll_gap_ms\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu},\"late_polls\":%llu,"
+             "\"cpu_box_pct\":%.1f,\"cpu_cameras_pct\":%.1f,\"rss_kb\":%ld}",
+             cameraCount, stepSeconds, (unsigned long long)passes.count(),
+             passes.percentile(50) / 1000.0, passes.percentile(99) / 1000.0, passes.max() / 1000.0,
+             (unsigned long long)countRequests.load(), stepSeconds > 0 ? countRequests.load() / stepSeconds : 0.0,
+             (unsigned long long)errors.load(), (unsigned long long)timeouts.load(),
+             pollingConfig.min_interval_ms, pollingConfig.max_interval_ms,
+             (unsigned long long)gaps.percentile(50), (unsigned long long)gaps.percentile(99), (unsigned long long)gaps.max(),
+             (unsigned long long)latePolls.load(),
+             stepSeconds > 0 ? boxCpu * 100 / stepSeconds : 0.0, stepSeconds > 0 ? camerasCpu * 100 / stepSeconds : 0.0, rssKb);
+    result = buf;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string profileFile = "sim/scenarios/farm_scaling.json";
+    std::string templateFile = "json/config.json";
+    std::string camerasOption;
+    int stepS = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--profile") {
+            profileFile = argv[i + 1];
+        } else if (option == "--config") {
+            templateFile = argv[i + 1];
+        } else if (option == "--cameras") {
+            camerasOption = argv[i + 1];
+        } else if (option == "--step") {
+            stepS = atoi(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    mg_log_set(MG_LL_NONE); // the timed out requests are closed by the client, mongoose would log each one
+    // The liveness prober and the broker talk on std::cout at their own threads, so std::cout is silenced
+    // here for good before any thread starts, swapping its buffer while they write would be a data race.
+    // The results go to the original buffer.
+    std::ostream results(std::cout.rdbuf());
+    std::cout.rdbuf(nullptr);
+
+    try {
+        FarmProfile profile = loadProfile(profileFile);
+        if (!camerasOption.empty()) {
+            profile.cameras.clear();
+            std::stringstream list(camerasOption);
+            std::string count;
+            while (std::getline(list, count, ',')) {
+                if (atoi(count.c_str()) <= 0) {
+                    throw std::string("--cameras must be a list of positive counts");
+                }
+                profile.cameras.push_back(atoi(count.c_str()));
+            }
+        }
+        if (stepS > 0) {
+            profile.stepMs = (uint64_t)stepS * 1000;
+        }
+        for (int count : profile.cameras) {
+            std::string result;
+            FarmStep step(profile, templateFile, count);
+            if (step.run(result) != 0) {
+                return 1;
+            }
+            results << result << std::endl;
+        }
+        return 0;
+    } catch (const std::string& err) {
+        std::cerr << "Farm failed: " << err << std::endl;
+        return 1;
+    }
+}
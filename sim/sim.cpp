@@ -0,0 +1,626 @@
+// Full-box simulation: the real CameraManager, ACMonitor, DCInput, ControlModule, CommModule, EventJournal
+// and StateStore run against a virtual clock, a simulated MCP23017 pair and on-board GPIO (SimHardware)
+// and local fake cameras (FakeCameras) whose counts follow the traffic of a scenario file.
+// The virtual clock jumps one tick at a time, so a 24 hour scenario takes seconds to minutes.
+//
+// Usage: meow_sim [--scenario sim/scenarios/junction_24h.json] [--config json/config.json] [--duration <s>]
+//                 [--record <capture> | --replay <capture>]
+//   --scenario  traffic, signal plan, buttons and camera outages, see sim/scenarios
+//   --config    box config, the camera addresses are replaced by the fake cameras,
+//               the journal and state files go to /tmp, run from the repo root for the defaults
+//   --duration  overrides duration_s of the scenario
+//   --record    keeps the camera poll answers in a capture file (see CameraCapture)
+//   --replay    the polls are answered from a capture file instead of the fake cameras, at the capture
+//               speed of the config; a capture recorded with the same scenario replays the same vehicles,
+//               so the two reports compare the demand pipeline of two builds on the same traffic
+//
+// One JSON report on stdout when done:
+//   virtual_s, wall_s, speedup, ticks
+//   polls            count requests the cameras (or the capture) answered, poll_wall_us the real time of a poll tick
+//   vehicles         arrivals on the detect loops; served (the output went high while the vehicle was there),
+//                    absorbed (the output was already high), missed (never seen by the box)
+//   latency_ms       arrival to output high of the served vehicles, in virtual time so the poll schedule
+//   hold_error_ms    output pulse length minus the configured hold time
+//   i2c_transfers, gpio_writes, cpu_user_s, cpu_sys_s, max_rss_kb
+//
+// A camera in outage answers the count with 503 and the HEAD probe with 200 (the application is down,
+// not the network), so the prober puts it back at once and every poll tick sees the failure.
+// Virtual time covers everything read through LvClock and the now_ms of the loops, the HTTP poll
+// timeout and the liveness prober backoff still run on real time.
+
+#include "ConfigManager.h"
+#include "ControlModule.h"
+#include "CommModule.h"
+#include "CameraManager.h"
+#include "CameraCapture.h"
+#include "CameraLiveness.h"
+#include "CountHistory.h"
+#include "EventJournal.h"
+#include "StateStore.h"
+#include "LatencyTracker.h"
+#include "ACMonitor.h"
+#include "DCinput.h"
+#include "SimHardware.h"
+#include "FakeCamera.h"
+#include "SimConfig.h"
+#include "LvClock.h"
+#include "LvHdrHistogram.h"
+#include "LvJSON.h"
+#include "mongoose.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iterator>
+#include <cmath>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define SIM_MCP23017_ADDR1 0x20
+#define SIM_MCP23017_ADDR2 0x21
+#define SIM_BUTTON_PRESS_MS 500
+
+struct Outage {
+    int camera; // index in the config
+    uint64_t startMs;
+    uint64_t endMs;
+};
+
+struct Scenario {
+    uint64_t durationMs;
+    int tickMs;
+    int ioIntervalMs;
+    unsigned int seed;
+    int basePort;
+    uint64_t startEpochMs;
+    std::vector<double> vehiclesPerHour; // 24 values, per detect loop, hour 0 is the scenario start
+    int dwellMinMs;
+    int dwellMaxMs;
+    int cycleMs; // signal plan, the phases get their green one after the other
+    int greenMs;
+    double buttonsPerHour; // per push button
+    std::vector<Outage> outages;
+    std::string captureMode = "off"; // --record / --replay
+    std::string captureFile;
+};
+
+struct Vehicle {
+    uint64_t arriveMs; // virtual ms since the scenario start
+    uint64_t leaveMs;
+};
+
+// Vehicles of one demand, the detect loop sees them while they are there, the count loop counts the arrivals
+struct LoopTraffic {
+    size_t camera;
+    int detectLoop;
+    int countLoop;
+    std::vector<Vehicle> vehicles; // by arrival
+};
+
+// Output high interval of one expander pin
+struct Pulse {
+    uint64_t startMs;
+    uint64_t endMs; // UINT64_MAX when still high at the end
+};
+
+// Method to load the scenario, throws std::string when malformed
+static Scenario loadScenario(const std::string& filepath) {
+    LvJSON doc;
+    if (doc.Parse(SimConfig::readFile(filepath).c_str()).HasParseError() || !doc.IsObject()) {
+        throw std::string("Cannot parse the scenario " + filepath);
+    }
+    Scenario scenario;
+    LvJSON::checkType(doc, "duration_s", LvJSON::Int);
+    LvJSON::checkType(doc, "tick_ms", LvJSON::Int);
+    LvJSON::checkType(doc, "io_interval_ms", LvJSON::Int);
+    LvJSON::checkType(doc, "seed", LvJSON::Int);
+    LvJSON::checkType(doc, "base_port", LvJSON::Int);
+    scenario.durationMs = (uint64_t)doc["duration_s"].GetInt() * 1000;
+    scenario.tickMs = doc["tick_ms"].GetInt();
+    scenario.ioIntervalMs = doc["io_interval_ms"].GetInt();
+    scenario.seed = doc["seed"].GetInt();
+    scenario.basePort = doc["base_port"].GetInt();
+    scenario.startEpochMs = 1700000000000ULL;
+    if (doc.HasMember("start_epoch_ms") && doc["start_epoch_ms"].IsUint64()) {
+        scenario.startEpochMs = doc["start_epoch_ms"].GetUint64();
+    }
+    if (scenario.tickMs <= 0 || scenario.ioIntervalMs <= 0) {
+        throw std::string("tick_ms and io_interval_ms must be positive");
+    }
+
+    LvJSON::checkType(doc, "traffic", LvJSON::Object);
+    const auto& traffic = doc["traffic"];
+    LvJSON::checkType(traffic, "vehicles_per_hour", LvJSON::Array);
+    LvJSON::checkType(traffic, "dwell_min_ms", LvJSON::Int);
+    LvJSON::checkType(traffic, "dwell_max_ms", LvJSON::Int);
+    if (traffic["vehicles_per_hour"].Size() != 24) {
+        throw std::string("Property \"vehicles_per_hour\" must hold 24 values");
+    }
+    for (const auto& rate : traffic["vehicles_per_hour"].GetArray()) {
+        if (!rate.IsNumber()) {
+            throw std::string("Property \"vehicles_per_hour\" must be an array of Number");
+        }
+        scenario.vehiclesPerHour.push_back(rate.GetDouble());
+    }
+    scenario.dwellMinMs = traffic["dwell_min_ms"].GetInt();
+    scenario.dwellMaxMs = traffic["dwell_max_ms"].GetInt();
+    if (scenario.dwellMinMs <= 0 || scenario.dwellMaxMs < scenario.dwellMinMs) {
+        throw std::string("dwell_min_ms must be positive and not above dwell_max_ms");
+    }
+
+    LvJSON::checkType(doc, "signal", LvJSON::Object);
+    LvJSON::checkType(doc["signal"], "cycle_s", LvJSON::Int);
+    LvJSON::checkType(doc["signal"], "green_s", LvJSON::Int);
+    scenario.cycleMs = doc["signal"]["cycle_s"].GetInt() * 1000;
+    scenario.greenMs = doc["signal"]["green_s"].GetInt() * 1000;
+    if (scenario.cycleMs <= 0) {
+        throw std::string("cycle_s must be positive");
+    }
+
+    LvJSON::checkType(doc, "buttons_per_hour", LvJSON::Double);
+    scenario.buttonsPerHour = doc["buttons_per_hour"].GetDouble();
+
+    if (doc.HasMember("camera_outages")) {
+        LvJSON::checkType(doc, "camera_outages", LvJSON::Array);
+        for (const auto& outage : doc["camera_outages"].GetArray()) {
+            LvJSON::checkType(outage, "camera", LvJSON::Int);
+            LvJSON::checkType(outage, "start_s", LvJSON::Int);
+            LvJSON::checkType(outage, "duration_s", LvJSON::Int);
+            uint64_t startMs = (uint64_t)outage["start_s"].GetInt() * 1000;
+            scenario.outages.push_back({outage["camera"].GetInt(), startMs, startMs + (uint64_t)outage["duration_s"].GetInt() * 1000});
+        }
+    }
+    return scenario;
+}
+
+// Method to draw Poisson arrivals with the hourly rate, perHour indexed by the hour of the scenario
+static std::vector<uint64_t> poissonArrivals(const std::vector<double>& perHour, uint64_t durationMs, std::mt19937& rng) {
+    std::vector<uint64_t> arrivals;
+    double t = 0;
+    while (t < durationMs) {
+        size_t hour = (size_t)(t / 3600000) % perHour.size();
+        double nextHour = (std::floor(t / 3600000) + 1) * 3600000;
+        if (perHour[hour] <= 0) {
+            t = nextHour;
+            continue;
+        }
+        std::exponential_distribution<double> gap(perHour[hour] / 3600000.0);
+        double next = t + gap(rng);
+        if (next >= nextHour) {
+            t = nextHour; // memoryless, draw again with the rate of the next hour
+            continue;
+        }
+        t = next;
+        if (t < durationMs) {
+            arrivals.push_back((uint64_t)t);
+        }
+    }
+    return arrivals;
+}
+
+class Simulation {
+public:
+    Simulation(const Scenario& scenario, const std::string& configTemplate)
+        : scenario(scenario), prefix("/tmp/meow_sim_" + std::to_string(getpid()) + "_"), rng(scenario.seed),
+          virtualMs(scenario.startEpochMs), fakeCameras(&Simulation::onCount, this),
+          hardware(SIM_MCP23017_ADDR1, SIM_MCP23017_ADDR2), countRequests(0) {
+        configFile = makeConfig(configTemplate);
+        LvClock::inject(&Simulation::now, this);
+        configManager.reset(new ConfigManager(configFile));
+        generateTraffic();
+        generateButtons();
+    }
+
+    ~Simulation() {
+        fakeCameras.stop();
+        configManager.reset();
+        LvClock::inject(NULL, NULL);
+        unlink(configFile.c_str());
+        unlink((prefix + "events.journal").c_str());
+        unlink((prefix + "iotbox.state").c_str());
+    }
+
+    int run(std::string& result);
+
+private:
+    const Scenario scenario;
+    const std::string prefix;
+    std::string configFile;
+    std::mt19937 rng;
+    std::atomic<uint64_t> virtualMs; // read by the fake camera thread
+    std::unique_ptr<ConfigManager> configManager;
+    FakeCameras fakeCameras;
+    SimHardware hardware;
+    std::vector<LoopTraffic> traffic;
+    std::vector<std::vector<uint64_t>> buttonPresses; // per DC config, press start times
+    std::vector<size_t> nextPress;
+    std::atomic<uint64_t> countRequests;
+    uint64_t maxDwellMs = 0;
+
+    static uint64_t now(void* self) {
+        return ((Simulation*)self)->virtualMs.load(std::memory_order_relaxed);
+    }
+
+    std::string makeConfig(const std::string& templateFile);
+    void generateTraffic();
+    void generateButtons();
+    static int onCount(void* self, size_t camera, std::string& body);
+    int presentVehicles(const LoopTraffic& loop, uint64_t t) const;
+    int arrivedVehicles(const LoopTraffic& loop, uint64_t t) const;
+    unsigned char inputLevels(uint64_t t);
+    std::string report(double wallSeconds, uint64_t ticks, uint64_t polls, const LvHdrHistogram& pollWall);
+};
+
+// Method to write the config of the run, the template cameras get a fake camera port each
+std::string Simulation::makeConfig(const std::string& templateFile) {
+    LvJSON doc;
+    SimConfig::load(doc, templateFile);
+    auto& allocator = doc.GetAllocator();
+    auto& cameras = doc["camera_config"];
+    for (rapidjson::SizeType i = 0; i < cameras.Size(); i++) {
+        std::string ip = "127.0.0.1:" + std::to_string(scenario.basePort + i);
+        cameras[i]["ip_address"].SetString(ip.c_str(), allocator);
+    }
+    SimConfig::useFiles(doc, prefix, 65536);
+    if (scenario.captureMode != "off") {
+        double speed = doc.HasMember("capture") && doc["capture"].HasMember("speed") ? doc["capture"]["speed"].GetDouble() : 1.0;
+        LvJSON::Value capture(rapidjson::kObjectType);
+        capture.AddMember("mode", LvJSON::Value(scenario.captureMode.c_str(), allocator), allocator);
+        capture.AddMember("file", LvJSON::Value(scenario.captureFile.c_str(), allocator), allocator);
+        capture.AddMember("speed", speed, allocator);
+        doc.RemoveMember("capture");
+        doc.AddMember("capture", capture, allocator);
+    }
+    return SimConfig::write(doc, prefix + "config.json");
+}
+
+// Method to draw the vehicles of every configured demand
+void Simulation::generateTraffic() {
+    std::uniform_int_distribution<int> dwell(scenario.dwellMinMs, scenario.dwellMaxMs);
+    maxDwellMs = scenario.dwellMaxMs;
+    const auto& camConfigs = configManager->getCameraConfigs();
+    for (size_t camera = 0; camera < camConfigs.size(); camera++) {
+        for (const auto& demand : camConfigs[camera].demands) {
+            LoopTraffic loop;
+            loop.camera = camera;
+            loop.detectLoop = demand.detect_loop;
+            loop.countLoop = demand.count_loop;
+            for (uint64_t arriveMs : poissonArrivals(scenario.vehiclesPerHour, scenario.durationMs, rng)) {
+                loop.vehicles.push_back({arriveMs, arriveMs + dwell(rng)});
+            }
+            traffic.push_back(loop);
+        }
+    }
+}
+
+// Method to draw the push button presses, each held SIM_BUTTON_PRESS_MS
+void Simulation::generateButtons() {
+    std::vector<double> perHour(24, scenario.buttonsPerHour);
+    for (size_t i = 0; i < configManager->getDCConfigs().size(); i++) {
+        buttonPresses.push_back(poissonArrivals(perHour, scenario.durationMs, rng));
+        nextPress.push_back(0);
+    }
+}
+
+int Simulation::presentVehicles(const LoopTraffic& loop, uint64_t t) const {
+    auto end = std::upper_bound(loop.vehicles.begin(), loop.vehicles.end(), t,
+        [](uint64_t value, const Vehicle& vehicle) { return value < vehicle.arriveMs; });
+    int present = 0;
+    for (auto it = end; it != loop.vehicles.begin(); ) {
+        --it;
+        if (it->arriveMs + maxDwellMs <= t) {
+            break; // older ones are all gone
+        }
+        if (it->leaveMs > t) {
+            present++;
+        }
+    }
+    return present;
+}
+
+int Simulation::arrivedVehicles(const LoopTraffic& loop, uint64_t t) const {
+    return std::upper_bound(loop.vehicles.begin(), loop.vehicles.end(), t,
+        [](uint64_t value, const Vehicle& vehicle) { return value < vehicle.arriveMs; }) - loop.vehicles.begin();
+}
+
+// Count body of a camera at the current virtual time, 503 while the camera is out, fake camera thread
+int Simulation::onCount(void* self, size_t camera, std::string& body) {
+    Simulation& sim = *(Simulation*)self;
+    uint64_t t = sim.virtualMs.load(std::memory_order_relaxed) - sim.scenario.startEpochMs;
+    for (const auto& outage : sim.scenario.outages) {
+        if (outage.camera == (int)camera && t >= outage.startMs && t < outage.endMs) {
+            body = "{\"error\":\"unavailable\"}";
+            return 503;
+        }
+    }
+    sim.countRequests++;
+
+    int frameCounts[5] = {0, 0, 0, 0, 0}; // by loop id 1 to 4
+    int accumulateCounts[5] = {0, 0, 0, 0, 0};
+    for (const auto& loop : sim.traffic) {
+        if (loop.camera != camera) {
+            continue;
+        }
+        if (loop.detectLoop >= 1 && loop.detectLoop <= 4) {
+            frameCounts[loop.detectLoop] += sim.presentVehicles(loop, t);
+        }
+        if (loop.countLoop >= 1 && loop.countLoop <= 4) {
+            accumulateCounts[loop.countLoop] += sim.arrivedVehicles(loop, t);
+        }
+    }
+    body = "{\"data\":[";
+    for (int id = 1; id <= 4; id++) {
+        body += (id > 1 ? ",{\"id\":" : "{\"id\":") + std::to_string(id) +
+                ",\"frame_count\":[" + std::to_string(frameCounts[id]) +
+                "],\"accumulate_count\":[" + std::to_string(accumulateCounts[id]) + "]}";
+    }
+    body += "]}";
+    return 200;
+}
+
+// Method to get port A of the first expander at t: the AC lights of the signal plan and the pressed buttons pull their pin low
+unsigned char Simulation::inputLevels(uint64_t t) {
+    unsigned char levels = 0xFF;
+    const auto& acConfigs = configManager->getACconfigs();
+    uint64_t inCycle = t % scenario.cycleMs;
+    for (size_t i = 0; i < acConfigs.size(); i++) {
+        uint64_t greenStart = (uint64_t)scenario.greenMs * i % scenario.cycleMs;
+        bool green = (inCycle + scenario.cycleMs - greenStart) % scenario.cycleMs < (uint64_t)scenario.greenMs;
+        levels &= ~(1 << (green ? acConfigs[i].green_gpio_pin : acConfigs[i].red_gpio_pin));
+    }
+    const auto& dcConfigs = configManager->getDCConfigs();
+    for (size_t i = 0; i < dcConfigs.size(); i++) {
+        const auto& presses = buttonPresses[i];
+        size_t& next = nextPress[i];
+        while (next < presses.size() && presses[next] + SIM_BUTTON_PRESS_MS <= t) {
+            next++;
+        }
+        if (next < presses.size() && presses[next] <= t) {
+            levels &= ~(1 << dcConfigs[i].gpio_pin);
+        }
+    }
+    return levels;
+}
+
+int Simulation::run(std::string& result) {
+    const auto& camConfigs = configManager->getCameraConfigs();
+    for (size_t i = 0; i < camConfigs.size(); i++) {
+        if (fakeCameras.add(scenario.basePort + i) != 0) {
+            std::cerr << "Cannot listen on port " << scenario.basePort + i << std::endl;
+            return 1;
+        }
+    }
+    fakeCameras.start();
+    hardware.setInputs(SIM_MCP23017_ADDR1, inputLevels(0));
+
+    std::unique_ptr<StateStore> stateStore;
+    std::unique_ptr<ControlModule> controlModule;
+    std::unique_ptr<CommModule> commModule;
+    std::unique_ptr<EventJournal> eventJournal;
+    std::unique_ptr<DCInput> dcInput;
+    std::unique_ptr<ACMonitor> acMonitor;
+    std::unique_ptr<CameraLiveness> cameraLiveness;
+    std::unique_ptr<CountHistory> countHistory;
+    std::unique_ptr<LatencyTracker> latencyTracker;
+    std::unique_ptr<CameraCapture> cameraCapture;
+    std::unique_ptr<CameraManager> cameraManager;
+    {
+        stateStore.reset(new StateStore(*configManager));
+        controlModule.reset(new ControlModule("/dev/i2c-0", SIM_MCP23017_ADDR1, SIM_MCP23017_ADDR2, *configManager, *stateStore,
+                                              &hardware.ops()));
+        commModule.reset(new CommModule("127.0.0.1:" + std::to_string(scenario.basePort + 1000)));
+        eventJournal.reset(new EventJournal(*configManager));
+        dcInput.reset(new DCInput(*configManager, *controlModule, *commModule, *eventJournal));
+        acMonitor.reset(new ACMonitor(*configManager, *controlModule, *commModule, *eventJournal));
+        cameraLiveness.reset(new CameraLiveness(*configManager));
+        cameraLiveness->start();
+        countHistory.reset(new CountHistory(*configManager));
+        latencyTracker.reset(new LatencyTracker(*configManager));
+        cameraCapture.reset(new CameraCapture(*configManager));
+        cameraManager.reset(new CameraManager(*configManager, *controlModule, *commModule, *cameraLiveness, *countHistory,
+                                              *eventJournal, *stateStore, *latencyTracker, *cameraCapture));
+        commModule->start();
+    }
+    if (scenario.captureMode == "record" && !cameraCapture->isRecording()) {
+        std::cerr << "Cannot record to " << scenario.captureFile << std::endl;
+        return 1;
+    }
+    if (scenario.captureMode == "replay" && !cameraCapture->isReplaying()) {
+        std::cerr << "Cannot replay " << scenario.captureFile << std::endl;
+        return 1;
+    }
+    // the replayed polls do not reach the fake cameras
+    auto polls = [&]() { return countRequests.load() + (cameraCapture->isReplaying() ? cameraCapture->getRecords() : 0); };
+
+    // Same order as the main loop of the box, a tick of virtual time per iteration
+    LvHdrHistogram pollWall;
+    uint64_t ticks = 0;
+    uint64_t last_io_loop_ms = 0;
+    auto wallStart = std::chrono::steady_clock::now();
+    for (uint64_t t = 0; t < scenario.durationMs; t += scenario.tickMs, ticks++) {
+        uint64_t now_ms = scenario.startEpochMs + t;
+        virtualMs.store(now_ms, std::memory_order_relaxed);
+        hardware.setInputs(SIM_MCP23017_ADDR1, inputLevels(t));
+
+        uint64_t pollsBefore = polls();
+        uint64_t loopStartUs = LatencyTracker::nowUs();
+        cameraManager->loop(now_ms);
+        if (polls() != pollsBefore) {
+            pollWall.record(LatencyTracker::nowUs() - loopStartUs);
+        }
+        eventJournal->loop(now_ms);
+        cameraCapture->loop(now_ms);
+        stateStore->loop(now_ms);
+        commModule->loop(now_ms);
+
+        if (now_ms - last_io_loop_ms >= (uint64_t)scenario.ioIntervalMs) {
+            last_io_loop_ms = now_ms;
+            acMonitor->loop(now_ms);
+            dcInput->loop(now_ms);
+        }
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    result = report(wallSeconds, ticks, polls(), pollWall);
+    {
+        cameraManager.reset();
+        cameraCapture.reset();
+        cameraLiveness.reset();
+        acMonitor.reset();
+        dcInput.reset();
+        eventJournal.reset();
+        commModule.reset();
+        controlModule.reset();
+        stateStore.reset();
+    }
+    return 0;
+}
+
+// Method to compare the output pulses with the vehicles and build the JSON report
+std::string Simulation::report(double wallSeconds, uint64_t ticks, uint64_t polls, const LvHdrHistogram& pollWall) {
+    // pulses of every expander pin, from the port B writes
+    std::map<int, std::vector<Pulse>> pulses; // address * 8 + pin
+    std::map<int, unsigned char> lastOutputs;
+    for (const auto& write : hardware.getWrites()) {
+        unsigned char before = lastOutputs[write.address];
+        uint64_t t = write.timeMs - scenario.startEpochMs;
+        for (int pin = 0; pin < 8; pin++) {
+            bool wasHigh = (before >> pin) & 1;
+            bool isHigh = (write.portB >> pin) & 1;
+            std::vector<Pulse>& pinPulses = pulses[write.address * 8 + pin];
+            if (!wasHigh && isHigh) {
+                pinPulses.push_back({t, UINT64_MAX});
+            } else if (wasHigh && !isHigh && !pinPulses.empty()) {
+                pinPulses.back().endMs = t;
+            }
+        }
+        lastOutputs[write.address] = write.portB;
+    }
+
+    // every vehicle: served when a pulse started while it was there, absorbed when the output was already high
+    LvHdrHistogram latency;
+    uint64_t vehicles = 0, served = 0, absorbed = 0, missed = 0;
+    std::map<int, int> holdByPin; // address * 8 + pin to the hold time the box applies
+    const auto& camConfigs = configManager->getCameraConfigs();
+    for (const auto& loop : traffic) {
+        auto gpio = configManager->getDemandGpioConfig(camConfigs[loop.camera].ip_address, loop.detectLoop);
+        int address = (gpio.gpio_type == I2C_MCP23017_0x20) ? SIM_MCP23017_ADDR1 : SIM_MCP23017_ADDR2;
+        int key = address * 8 + gpio.gpio_pin;
+        if (holdByPin.find(key) == holdByPin.end()) {
+            holdByPin[key] = configManager->getDemandHoldTime(loop.detectLoop);
+        }
+        const std::vector<Pulse>& pinPulses = pulses[key];
+        for (const auto& vehicle : loop.vehicles) {
+            vehicles++;
+            auto next = std::lower_bound(pinPulses.begin(), pinPulses.end(), vehicle.arriveMs,
+                [](const Pulse& pulse, uint64_t value) { return pulse.startMs < value; });
+            if (next != pinPulses.begin() && std::prev(next)->endMs > vehicle.arriveMs) {
+                absorbed++;
+            } else if (next != pinPulses.end() && next->startMs <= vehicle.leaveMs) {
+                served++;
+                latency.record(next->startMs - vehicle.arriveMs);
+            } else {
+                missed++;
+            }
+        }
+    }
+
+    uint64_t pulseCount = 0;
+    int64_t holdErrorMin = 0, holdErrorMax = 0;
+    double holdErrorSum = 0;
+    for (const auto& entry : pulses) {
+        auto hold = holdByPin.find(entry.first);
+        if (hold == holdByPin.end()) {
+            continue;
+        }
+        for (const auto& pulse : entry.second) {
+            if (pulse.endMs == UINT64_MAX) {
+                continue;
+            }
+            int64_t error = (int64_t)(pulse.endMs - pulse.startMs) - hold->second;
+            holdErrorMin = pulseCount == 0 ? error : std::min(holdErrorMin, error);
+            holdErrorMax = pulseCount == 0 ? error : std::max(holdErrorMax, error);
+            holdErrorSum += error;
+            pulseCount++;
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double virtualSeconds = scenario.durationMs / 1000.0;
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "{\"virtual_s\":%.0f,\"wall_s\":%.2f,\"speedup\":%.0f,\"ticks\":%llu,"
+             "\"polls\":%llu,\"poll_wall_us\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu},"
+             "\"vehicles\":%llu,\"served\":%llu,\"absorbed\":%llu,\"missed\":%llu,"
+             "\"latency_ms\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu},"
+             "\"pulses\":%llu,\"hold_error_ms\":{\"min\":%lld,\"mean\":%.1f,\"max\":%lld},"
+             "\"i2c_transfers\":%llu,\"gpio_writes\":%llu,"
+             "\"cpu_user_s\":%.2f,\"cpu_sys_s\":%.2f,\"max_rss_kb\":%ld}",
+             virtualSeconds, wallSeconds, wallSeconds > 0 ? virtualSeconds / wallSeconds : 0, (unsigned long long)ticks,
+             (unsigned long long)polls, (unsigned long long)pollWall.percentile(50),
+             (unsigned long long)pollWall.percentile(99), (unsigned long long)pollWall.max(),
+             (unsigned long long)vehicles, (unsigned long long)served, (unsigned long long)absorbed, (unsigned long long)missed,
+             (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(90),
+             (unsigned long long)latency.percentile(99), (unsigned long long)latency.max(),
+             (unsigned long long)pulseCount, (long long)holdErrorMin, pulseCount ? holdErrorSum / pulseCount : 0.0, (long long)holdErrorMax,
+             (unsigned long long)hardware.getI2CTransfers(), (unsigned long long)hardware.getGpioWrites(),
+             usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+             usage.ru_maxrss);
+    return buf;
+}
+
+int main(int argc, char* argv[]) {
+    std::string scenarioFile = "sim/scenarios/junction_24h.json";
+    std::string templateFile = "json/config.json";
+    int durationS = 0;
+    std::string captureMode = "off";
+    std::string captureFile;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--scenario") {
+            scenarioFile = argv[i + 1];
+        } else if (option == "--config") {
+            templateFile = argv[i + 1];
+        } else if (option == "--duration") {
+            durationS = atoi(argv[i + 1]);
+        } else if (option == "--record" || option == "--replay") {
+            captureMode = option.substr(2);
+            captureFile = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    mg_log_set(MG_LL_ERROR);
+    // The liveness prober and the broker talk on std::cout at their own threads, so std::cout is silenced
+    // here for good before any thread starts, swapping its buffer while they write would be a data race.
+    // The report goes to the original buffer.
+    std::ostream results(std::cout.rdbuf());
+    std::cout.rdbuf(nullptr);
+
+    try {
+        Scenario scenario = loadScenario(scenarioFile);
+        if (durationS > 0) {
+            scenario.durationMs = (uint64_t)durationS * 1000;
+        }
+        scenario.captureMode = captureMode;
+        scenario.captureFile = captureFile;
+        Simulation simulation(scenario, templateFile);
+        std::string result;
+        if (simulation.run(result) != 0) {
+            return 1;
+        }
+        results << result << std::endl;
+        return 0;
+    } catch (const std::string& err) {
+        std::cerr << "Simulation failed: " << err << std::endl;
+        return 1;
+    }
+}
@@ -1,16 +1,20 @@
 #include "ACMonitor.h"
 
 // Constructor
-ACMonitor::ACMonitor(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule) 
-    : configManager(configManager), controlModule(controlModule), commModule(commModule) {
+ACMonitor::ACMonitor(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, EventJournal& eventJournal) 
+    : configManager(configManager), controlModule(controlModule), commModule(commModule), eventJournal(eventJournal) {
     // Initialize acStatus with the AC configurations
     for (const auto& acConfig : configManager.getACconfigs()) {
         ACStatus acStat;
         acStat.phase = acConfig.phase;
         acStat.red_state = 0;
         acStat.green_state = 0;
+        acStat.last_red_state = 0;
+        acStat.last_green_state = 0;
         acStatus.push_back(acStat);
     }
+
+    commModule.addStateTopic("AC_status");
 }
 
 // Method to monitor the AC status
@@ -39,6 +43,15 @@ void ACMonitor::checkACStatus(const ConfigManager::AC_in_config& acConfig) {
                 acStat.green_state = 1;
             }
 
+            if (acStat.red_state != acStat.last_red_state) {
+                eventJournal.record(EventJournal::SourcePhaseRed, acStat.phase, acStat.red_state);
+                acStat.last_red_state = acStat.red_state;
+            }
+            if (acStat.green_state != acStat.last_green_state) {
+                eventJournal.record(EventJournal::SourcePhaseGreen, acStat.phase, acStat.green_state);
+                acStat.last_green_state = acStat.green_state;
+            }
+
             return; // Phase found and processed, exit the loop
         }
     }
@@ -4,6 +4,7 @@
 #include "ConfigManager.h"
 #include "ControlModule.h"
 #include "CommModule.h"
+#include "EventJournal.h"
 #include "LvJSON.h"
 #include <vector>
 #include <string>
@@ -13,25 +14,29 @@
 
 class ACMonitor {
 public:
-    ACMonitor(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule);
+    ACMonitor(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, EventJournal& eventJournal);
     void loop(uint64_t now_ms);
+    // Method to build the AC_status JSON, public for the benchmarks
+    std::string generateJSON();
 
 private:
     const ConfigManager& configManager;
     ControlModule& controlModule;
     CommModule& commModule;
+    EventJournal& eventJournal;
 
     struct ACStatus {
         int phase;
         bool red_state;
         bool green_state;
+        bool last_red_state; // kept across the reset, a change goes to the journal
+        bool last_green_state;
     };
 
     std::vector<ACStatus> acStatus;
 
     void checkACStatus(const ConfigManager::AC_in_config& acConfig);
     void resetACStatus();
-    std::string generateJSON();
 };
 
 #endif // AC_MONITOR_H
\ No newline at end of file
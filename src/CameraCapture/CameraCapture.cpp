@@ -0,0 +1,117 @@
+#include "CameraCapture.h"
+
+//Constructor
+CameraCapture::CameraCapture(const ConfigManager& configManager)
+    : speed(configManager.getCaptureConfig().speed) {
+    const auto& captureConfig = configManager.getCaptureConfig();
+    if (captureConfig.mode == "record") {
+        if (capture.openWrite(captureConfig.file) != 0) {
+            std::cerr << "Failed to open the camera capture: " << captureConfig.file << ", polls are not recorded" << std::endl;
+            return;
+        }
+        recording = true;
+        std::cout << "Recording the camera polls to " << captureConfig.file << std::endl;
+    } else if (captureConfig.mode == "replay") {
+        if (capture.openRead(captureConfig.file) != 0) {
+            std::cerr << "Failed to open the camera capture: " << captureConfig.file << ", nothing to replay" << std::endl;
+            return;
+        }
+        replaying = true;
+        readPending();
+        firstMs = pending.timeMs;
+        std::cout << "Replaying the camera polls from " << captureConfig.file << " at speed " << speed << std::endl;
+    }
+}
+
+void CameraCapture::record(const std::string& ip, int status, const std::string& body, uint64_t requestWallMs, uint64_t durationUs) {
+    if (!recording) {
+        return;
+    }
+    LvHttpCapture::Record record;
+    record.timeMs = requestWallMs;
+    record.durationUs = durationUs > UINT32_MAX ? UINT32_MAX : (uint32_t)durationUs;
+    record.status = status;
+    record.host = ip;
+    record.body = body;
+    if (capture.write(record) != 0) {
+        LV_LOG_ERROR("Failed to write the camera capture, recording stopped");
+        capture.close();
+        recording = false;
+        return;
+    }
+    records++;
+    dirty = true;
+}
+
+bool CameraCapture::replay(const std::string& ip, uint64_t now_ms, int& status, std::string& body, uint64_t& durationMs) {
+    durationMs = 0;
+    if (!replaying) {
+        return false;
+    }
+
+    if (speed <= 0) {
+        // next answer of this camera, the answers of the other cameras read on the way wait in their queue
+        std::deque<LvHttpCapture::Record>& queue = queued[ip];
+        while (queue.empty() && hasPending) {
+            queued[pending.host].push_back(pending);
+            readPending();
+        }
+        if (queue.empty()) {
+            return false;
+        }
+        status = queue.front().status;
+        body = queue.front().body;
+        queue.pop_front();
+        records++;
+        return true;
+    }
+
+    // the capture runs from the first replayed poll, every camera answers what it answered at that point
+    if (!started) {
+        startMs = now_ms;
+        started = true;
+    }
+    uint64_t captureMs = firstMs + (uint64_t)((now_ms - startMs) * speed);
+    while (hasPending && pending.timeMs <= captureMs) {
+        latest[pending.host] = pending;
+        readPending();
+    }
+    auto it = latest.find(ip);
+    if (it == latest.end() || (!hasPending && captureMs > it->second.timeMs + 60000)) {
+        return false; // not seen yet, or the capture ended a while ago
+    }
+    status = it->second.status;
+    body = it->second.body;
+    durationMs = (uint64_t)(it->second.durationUs / 1000.0 / speed);
+    records++;
+    return true;
+}
+
+bool CameraCapture::isReplayDone() const {
+    if (!replaying || hasPending) {
+        return false;
+    }
+    for (const auto& entry : queued) {
+        if (!entry.second.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CameraCapture::loop(uint64_t now_ms) {
+    if (!dirty || now_ms - lastFlushMs < 1000) {
+        return;
+    }
+    capture.flush();
+    dirty = false;
+    lastFlushMs = now_ms;
+}
+
+void CameraCapture::readPending() {
+    int rc = capture.read(pending);
+    hasPending = rc == 1;
+    if (rc < 0) {
+        LV_LOG_ERROR("Camera capture corrupt, replay ends here");
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CAMERA_CAPTURE_H
+#define CAMERA_CAPTURE_H
+
+#include "ConfigManager.h"
+#include "LvHttpCapture.h"
+#include "LvLog.h"
+#include <string>
+#include <map>
+#include <deque>
+#include <iostream>
+
+// Record / replay of the camera count polls, to reproduce field incidents and benchmark the demand pipeline on real traffic.
+// record: every poll answer (status, body, time and duration, or no answer) goes to a capture file, see LvHttpCapture.
+// replay: CameraManager takes the answers from the capture instead of the network. With speed > 0 a poll gets the
+// last answer the camera gave at that point of the capture (speed 2 runs the capture twice faster),
+// with speed 0 every poll gets the next answer of the camera, so the pipeline runs as fast as it polls.
+// With speed > 0 the recorded poll duration comes along, a timed out poll keeps the camera loop busy
+// as long as it did in the field; the answer itself is processed at the start of that time.
+// Under the simulator the virtual clock keeps the original timing and still runs as fast as possible.
+// Camera loop only, the pushed counts are not captured. Replay is for meow_sim and meow_farm, meow refuses it.
+class CameraCapture {
+public:
+    CameraCapture(const ConfigManager& configManager);
+
+    bool isRecording() const { return recording; }
+    bool isReplaying() const { return replaying; }
+
+    // Method to keep a poll answer, status 0 when the camera did not answer
+    void record(const std::string& ip, int status, const std::string& body, uint64_t requestWallMs, uint64_t durationUs);
+    // Method to get the answer of the camera at now_ms, returns false when the capture has none for it (yet or anymore)
+    // durationMs is how long the poll took at the capture speed, 0 with speed 0
+    bool replay(const std::string& ip, uint64_t now_ms, int& status, std::string& body, uint64_t& durationMs);
+    // Method to check if the whole capture was served
+    bool isReplayDone() const;
+    // Method to hand the recorded answers to the file once per second, called from the main loop
+    void loop(uint64_t now_ms);
+
+    uint64_t getRecords() const { return records; }
+
+private:
+    const double speed;
+    LvHttpCapture capture;
+    bool recording = false;
+    bool replaying = false;
+    bool dirty = false;
+    uint64_t lastFlushMs = 0;
+    uint64_t records = 0; // recorded or replayed
+
+    // replay, the capture is streamed, pending is the next record not served yet
+    LvHttpCapture::Record pending;
+    bool hasPending = false;
+    uint64_t firstMs = 0; // capture time of the first record
+    uint64_t startMs = 0; // now_ms of the first replayed poll
+    bool started = false;
+    std::map<std::string, LvHttpCapture::Record> latest; // speed > 0, last answer of each camera so far
+    std::map<std::string, std::deque<LvHttpCapture::Record>> queued; // speed 0, read ahead answers of the other cameras
+
+    void readPending();
+};
+
+#endif // CAMERA_CAPTURE_H
@@ -0,0 +1,177 @@
+#include "CameraLiveness.h"
+
+//Constructor
+CameraLiveness::CameraLiveness(const ConfigManager& configManager,
+                               uint64_t probeTimeoutMs, uint64_t backoffBaseMs, uint64_t backoffMaxMs)
+    : probeTimeoutMs(probeTimeoutMs), backoffBaseMs(backoffBaseMs), backoffMaxMs(backoffMaxMs),
+      rng(std::random_device{}()) {
+    mg_mgr_init(&mgr);
+
+    // Every camera starts alive so the first pass polls all of them
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        ProbeState state;
+        state.ip = camConfig.ip_address;
+        state.isAlive = true;
+        state.failures = 0;
+        state.nextProbeMs = 0;
+        state.probeStartMs = 0;
+        state.conn = NULL;
+        probeStates.push_back(state);
+    }
+}
+
+//Destructor
+CameraLiveness::~CameraLiveness() {
+    stop();
+    mg_mgr_free(&mgr);
+}
+
+// Method to run the probes at its own thread
+void CameraLiveness::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    probeThread = std::thread(&CameraLiveness::run, this);
+}
+
+void CameraLiveness::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (probeThread.joinable()) {
+        probeThread.join();
+    }
+}
+
+// Method to check if the camera should be polled, unknown camera is always polled
+bool CameraLiveness::isAlive(const std::string& ip) {
+    std::lock_guard<std::mutex> lock(probeMtx);
+    for (const auto& state : probeStates) {
+        if (state.ip == ip) {
+            return state.isAlive;
+        }
+    }
+    return true;
+}
+
+// Method to feed back the result of a demand poll, a failed poll hands the camera to the prober
+void CameraLiveness::reportPoll(const std::string& ip, bool ok) {
+    std::lock_guard<std::mutex> lock(probeMtx);
+    for (auto& state : probeStates) {
+        if (state.ip != ip) {
+            continue;
+        }
+        if (ok) {
+            state.failures = 0;
+        } else if (state.isAlive) {
+            std::cout << "Camera: " << ip << " poll failed, probing." << std::endl;
+            state.isAlive = false;
+            state.nextProbeMs = 0; // probe right away
+        }
+    }
+}
+
+// Method to start a HEAD probe, caller holds probeMtx
+void CameraLiveness::startProbe(size_t index, uint64_t now_ms) {
+    ProbeState& state = probeStates[index];
+    std::string url = "tcp://" + state.ip;
+    if (state.ip.find(':') == std::string::npos) {
+        url += ":80";
+    }
+    state.probeStartMs = now_ms;
+    openingIndex = index;
+    state.conn = mg_connect(&mgr, url.c_str(), &CameraLiveness::probeHandler, this);
+    if (state.conn == NULL) {
+        finishProbe(index, false, now_ms);
+    }
+}
+
+// Method to record the probe result, caller holds probeMtx
+void CameraLiveness::finishProbe(size_t index, bool ok, uint64_t now_ms) {
+    ProbeState& state = probeStates[index];
+    state.conn = NULL;
+
+    if (ok) {
+        if (!state.isAlive) {
+            std::cout << "Camera: " << state.ip << " answered the probe, polling again." << std::endl;
+        }
+        state.isAlive = true;
+        state.failures = 0;
+        return;
+    }
+
+    state.failures++;
+    state.nextProbeMs = now_ms + backoffMs(state.failures);
+    if (state.failures == 1) {
+        std::cout << "Camera: " << state.ip << " is unreachable, backing off." << std::endl;
+    }
+}
+
+// Method to get the wait before the next probe, base * 2^(failures - 1) up to max, +-20% jitter
+uint64_t CameraLiveness::backoffMs(int failures) {
+    uint64_t delay = backoffBaseMs;
+    for (int i = 1; i < failures && delay < backoffMaxMs; i++) {
+        delay *= 2;
+    }
+    if (delay > backoffMaxMs) {
+        delay = backoffMaxMs;
+    }
+    std::uniform_int_distribution<int64_t> jitter(-(int64_t)delay / 5, (int64_t)delay / 5);
+    return delay + jitter(rng);
+}
+
+// Mongoose handler for the probe connections, runs at the probe thread without probeMtx
+void CameraLiveness::probeHandler(struct mg_connection* c, int ev, void* /*ev_data*/) {
+    CameraLiveness& liveness = *(CameraLiveness*)c->fn_data;
+    size_t index;
+    if (ev == MG_EV_OPEN) {
+        memcpy(c->data, &liveness.openingIndex, sizeof(index));
+        return;
+    }
+    memcpy(&index, c->data, sizeof(index));
+
+    if (ev == MG_EV_CONNECT) {
+        mg_printf(c, "HEAD /api/v1/count HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n",
+                  liveness.probeStates[index].ip.c_str());
+    } else if (ev == MG_EV_READ && c->recv.len >= 5) {
+        // Any HTTP answer means the camera is up, the demand poll will tell the rest
+        liveness.probeResults.push_back({index, c, memcmp(c->recv.buf, "HTTP/", 5) == 0});
+        c->is_closing = 1;
+    } else if (ev == MG_EV_ERROR || ev == MG_EV_CLOSE) {
+        liveness.probeResults.push_back({index, c, false});
+    }
+}
+
+// Probe thread
+void CameraLiveness::run() {
+    while (running) {
+        mg_mgr_poll(&mgr, 10);
+
+        uint64_t now_ms = mg_millis();
+        std::lock_guard<std::mutex> lock(probeMtx);
+        // only the first result of a connection counts, the later ones find conn cleared
+        for (const auto& result : probeResults) {
+            if (probeStates[result.index].conn == result.conn) {
+                finishProbe(result.index, result.ok, now_ms);
+            }
+        }
+        probeResults.clear();
+
+        for (size_t i = 0; i < probeStates.size(); i++) {
+            ProbeState& state = probeStates[i];
+            if (state.isAlive) {
+                continue;
+            }
+            if (state.conn != NULL) {
+                if (now_ms - state.probeStartMs > probeTimeoutMs) {
+                    state.conn->is_closing = 1; // still open, no close seen yet
+                    finishProbe(i, false, now_ms);
+                }
+            } else if (now_ms >= state.nextProbeMs) {
+                startProbe(i, now_ms);
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef CAMERA_LIVENESS_H
+#define CAMERA_LIVENESS_H
+
+#include "ConfigManager.h"
+#include "mongoose.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <unistd.h>
+
+// Decides which cameras are worth polling. A camera whose poll fails is taken out and probed
+// with a HEAD request at its own thread, any HTTP answer brings it back at once,
+// no answer backs off exponentially (with jitter so the dead cameras dont probe together).
+class CameraLiveness {
+public:
+    CameraLiveness(const ConfigManager& configManager,
+                   uint64_t probeTimeoutMs = 1000, uint64_t backoffBaseMs = 1000, uint64_t backoffMaxMs = 30000);
+    ~CameraLiveness();
+
+    // Method to run the probes at its own thread
+    void start();
+    void stop();
+
+    // Method to check if the camera should be polled
+    bool isAlive(const std::string& ip);
+    // Method to feed back the result of a demand poll
+    void reportPoll(const std::string& ip, bool ok);
+
+private:
+    struct ProbeState {
+        std::string ip;
+        bool isAlive;
+        int failures;
+        uint64_t nextProbeMs;
+        uint64_t probeStartMs;
+        struct mg_connection* conn; // probe in flight
+    };
+
+    const uint64_t probeTimeoutMs;
+    const uint64_t backoffBaseMs;
+    const uint64_t backoffMaxMs;
+
+    std::vector<ProbeState> probeStates;
+    std::mutex probeMtx; // probeStates is read by the camera loop and written by the probe thread
+    struct mg_mgr mgr;
+    std::mt19937 rng;
+    struct ProbeResult {
+        size_t index;
+        struct mg_connection* conn;
+        bool ok;
+    };
+    std::vector<ProbeResult> probeResults; // probe thread only, filled by probeHandler and applied after the poll
+    size_t openingIndex = 0; // camera of the connection being opened, picked up at MG_EV_OPEN
+    std::thread probeThread;
+    std::atomic<bool> running{false};
+
+    static void probeHandler(struct mg_connection* c, int ev, void* ev_data);
+    void startProbe(size_t index, uint64_t now_ms);
+    void finishProbe(size_t index, bool ok, uint64_t now_ms);
+    uint64_t backoffMs(int failures);
+    void run();
+};
+
+#endif // CAMERA_LIVENESS_H
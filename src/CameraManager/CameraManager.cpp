@@ -1,14 +1,12 @@
 #include "CameraManager.h"
 
-uint64_t getcurrenttime_ms(){
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-    //the function returns the current time in milliseconds, which looks like this: 1634020000000
-}
-
 //Constructor
-CameraManager::CameraManager(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule)
-    : configManager(configManager), controlModule(controlModule), commModule(commModule) {
+CameraManager::CameraManager(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, CameraLiveness& cameraLiveness,
+                             CountHistory& countHistory, EventJournal& eventJournal, StateStore& stateStore, LatencyTracker& latencyTracker,
+                             CameraCapture& cameraCapture)
+    : configManager(configManager), controlModule(controlModule), commModule(commModule), cameraLiveness(cameraLiveness),
+      countHistory(countHistory), eventJournal(eventJournal), stateStore(stateStore), latencyTracker(latencyTracker),
+      cameraCapture(cameraCapture) {
     // Initialize cameraStatus with the camera configurations
     for (const auto& camConfig : configManager.getCameraConfigs()) {
         CameraStatus camStatus;
@@ -24,12 +22,36 @@ CameraManager::CameraManager(const ConfigManager& configManager, ControlModule&
             demandStatus.isHandled = false;
             demandStatus.lastHandledTime = 0;
             demandStatus.previousCount = 2147483647; 
+            demandStatus.lastFrameCount = -1;
+            demandStatus.lastAccumulateCount = -1;
+            demandStatus.activations = &LvMetrics::instance().counter("iotbox_demand_activations_total",
+                "Demands set by a detected vehicle", "demand=\"" + std::to_string(demand.detect_loop) + "\"");
+
+            // Warm resume, the saved count keeps the first poll from looking like a new car
+            StateStore::DemandState saved;
+            if (stateStore.loadDemand(camConfig.ip_address, demand.detect_loop, saved)) {
+                demandStatus.previousCount = saved.previousCount;
+                demandStatus.isHandled = saved.isHandled;
+                demandStatus.lastHandledTime = LvClock::fromWallMs(saved.lastHandledTime);
+            }
             camStatus.demandStatus.push_back(demandStatus);
         }
 
         cameraStatus.push_back(camStatus);
+        std::string labels = "camera=\"" + camConfig.ip_address + "\"";
+        PollStatus poll;
+        poll.nextPollMs = 0;
+        poll.intervalMs = configManager.getPollingConfig().min_interval_ms;
+        poll.polls = &LvMetrics::instance().counter("iotbox_camera_polls_total", "Count polls sent to the camera", labels);
+        poll.pollErrors = &LvMetrics::instance().counter("iotbox_camera_poll_errors_total",
+            "Count polls without a valid answer", labels);
+        poll.pollDuration = &LvMetrics::instance().histogram("iotbox_camera_poll_duration_ms", "Count poll round trip",
+            {5, 10, 25, 50, 100, 250, 500}, labels);
+        pollStatus.push_back(poll);
     }
 
+    commModule.addStateTopic("Camera_status");
+
     // print the whole cameraStatus
     for (const auto& camStatus : cameraStatus) {
         std::cout << "Camera IP: " << camStatus.ip << std::endl;
@@ -47,15 +69,60 @@ CameraManager::CameraManager(const ConfigManager& configManager, ControlModule&
     }
 }
 
-//Method to check the demand for the camera
-void CameraManager::checkDemand(const ConfigManager::CameraConfig& camConfig) {
+//Method to check the demand for the camera, returns false when the camera did not answer properly
+//activity is set when a vehicle is on the detect loop or the counts moved since the last poll
+//the answer comes from the network, or from the capture when replaying
+bool CameraManager::checkDemand(const ConfigManager::CameraConfig& camConfig, bool& activity, uint64_t now_ms) {
+    LV_TRACE_SCOPE("camera.checkDemand");
+    activity = false;
+    LatencyTracker::Stamps stamps;
+    stamps.requestUs = LatencyTracker::nowUs();
+    int statusCode = 0;
+    std::string responseBody;
+
+    if (cameraCapture.isReplaying()) {
+        uint64_t duration_ms = 0;
+        if (!cameraCapture.replay(camConfig.ip_address, now_ms, statusCode, responseBody, duration_ms)) {
+            LV_LOG_DEBUG("No captured answer for camera: {}", camConfig.ip_address);
+            return false;
+        }
+        replayBusyUntilMs = now_ms + duration_ms;
+        stamps.responseUs = LatencyTracker::nowUs();
+    } else {
+        uint64_t request_wall_ms = cameraCapture.isRecording() ? LvClock::wallMs() : 0;
+        requestCount(camConfig, statusCode, responseBody);
+        stamps.responseUs = LatencyTracker::nowUs();
+        cameraCapture.record(camConfig.ip_address, statusCode, responseBody, request_wall_ms, stamps.responseUs - stamps.requestUs);
+    }
+
+    if (statusCode == 0) {
+        return false; // no answer, logged by requestCount
+    }
+    if (statusCode != 200) {
+        LV_LOG_ERROR("HTTP request failed with status code: {}", statusCode);
+        return false;
+    }
+
+    LV_LOG_DEBUG("Camera found for IP: {}", camConfig.ip_address);
+    try {
+        activity = processCount(camConfig, responseBody, stamps, now_ms);
+    } catch (const std::string& err) {
+        LV_LOG_ERROR("Invalid count from camera {}: {}", camConfig.ip_address, err);
+        return false;
+    }
+    return true;
+}
+
+//Method to GET /api/v1/count of the camera, statusCode is left at 0 when there is no answer
+//the timeout is network time, mg_millis() and not the tick time now_ms
+void CameraManager::requestCount(const ConfigManager::CameraConfig& camConfig, int& statusCode, std::string& responseBody) {
     LvRestfulClient client;
     std::string url = "http://" + camConfig.ip_address + "/api/v1/count";
     unsigned long request_id;
 
     // Start the HTTP GET request
     if (client.put(url, LvRestfulClient::METHOD_GET, "", 1000, &request_id) != 0) {
-        std::cerr << "Failed to start HTTP GET request." << std::endl;
+        LV_LOG_ERROR("Failed to start HTTP GET request.");
         client.clear_all_conn();
         return;
     }
@@ -67,117 +134,215 @@ void CameraManager::checkDemand(const ConfigManager::CameraConfig& camConfig) {
     while (true) {
         // Check if the timeout has been exceeded
         if (mg_millis() - start_time > 500) {  // 500 milliseconds timeout
-            std::cerr << "Timeout waiting for response from camera: " << camConfig.ip_address << std::endl;
+            LV_LOG_ERROR("Timeout waiting for response from camera: {}", camConfig.ip_address);
             client.clear_all_conn();
             return;
         }
 
-        client.loop(mg_millis());
-        std::string responseBody;
+        client.loop(mg_millis(), 5); // sleeps in poll() until the socket is ready, no 10 ms steps
         LvRestfulClient::METHOD method;
-        int statusCode;
+        if (client.get(url, method, responseBody, statusCode, &request_id) == 0) {
+            client.clear_all_conn();
+            return;
+        }
+    }
+}
 
-        while (client.get(url, method, responseBody, statusCode, &request_id) == 0) {
-            if (statusCode != 200) {
-                std::cerr << "HTTP request failed with status code: " << statusCode << std::endl;
-                client.clear_all_conn();
-                return;
-            }
+//Method to take a count JSON pushed by the camera, same format as /api/v1/count, throws std::string when rejected
+void CameraManager::ingestCount(const std::string& ip, const std::string& body) {
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        if (camConfig.ip_address == ip) {
+            LV_LOG_INFO("Count pushed by camera: {}", ip);
+            // nothing was asked, the latency starts when the count arrived
+            LatencyTracker::Stamps stamps;
+            stamps.requestUs = stamps.responseUs = LatencyTracker::nowUs();
+            processCount(camConfig, body, stamps, LvClock::nowMs());
+            return;
+        }
+    }
+    throw std::string("Unknown camera \"" + ip + "\"");
+}
 
-            std::cout << "Camera found for IP: " << camConfig.ip_address << std::endl;
+//Method to apply the count JSON to the demands, shared by the poll and the push, throws std::string when malformed
+//the whole body is checked before anything is applied, so a rejected count leaves no demand raised
+//returns true when there is activity on the camera
+//stamps hold the request and response time, the later stages are stamped here
+bool CameraManager::processCount(const ConfigManager::CameraConfig& camConfig, const std::string& body, LatencyTracker::Stamps stamps,
+                                 uint64_t now_ms) {
+    // Parse the JSON response
+    LvJSON json;
+    {
+        LV_TRACE_SCOPE("camera.parse");
+        LV_PROBE2(camera_parse_start, camConfig.ip_address.c_str(), body.size());
+        bool parsed = !json.Parse(body.c_str()).HasParseError() && json.IsObject();
+        LV_PROBE2(camera_parse_done, camConfig.ip_address.c_str(), parsed);
+        if (!parsed) {
+            throw std::string("Failed to parse JSON response.");
+        }
+    }
+    LvJSON::checkType(json, "data", LvJSON::Array);
+    const auto& dataArray = json["data"];
+    stamps.parsedUs = LatencyTracker::nowUs();
+
+    // Check the whole body first, a malformed entry rejects the count before any demand is raised
+    struct Entry {
+        int id;
+        int frameCount;
+        int countLoop;
+        int currentCount;
+    };
+    std::vector<Entry> entries;
+    LV_LOG_DEBUG("Processing the JSON response...");
+    for (const auto& data : dataArray.GetArray()) {
+        if (!data.IsObject() || !data.HasMember("id") || !data["id"].IsInt()) {
+            throw std::string("Property \"id\" must be of type Int");
+        }
+        int id = data["id"].GetInt();
 
-            // Parse the JSON response
-            LvJSON json;
-            if (json.Parse(responseBody.c_str()).HasParseError()) {
-                std::cerr << "Failed to parse JSON response." << std::endl;
-                return;
-            }
+        if (id != 1 && id != 2) {
+            continue;
+        }
 
-            std::cout << "Processing the JSON response..." << std::endl;
-            for (const auto& data : json["data"].GetArray()) {
-                int id = data["id"].GetInt();
+        int frameCount = firstInt(data, "frame_count");
+        auto countConfig = configManager.getDemandCountConfig(camConfig.ip_address, id);
+        if (countConfig.count_loop == 0) {
+            continue; // demand not configured for this camera
+        }
+        if (countConfig.count_loop < 1 || countConfig.count_loop > (int)dataArray.Size()) {
+            throw std::string("Count loop " + std::to_string(countConfig.count_loop) + " not in the data");
+        }
+        int currentCount = firstInt(dataArray[countConfig.count_loop - 1], "accumulate_count");
+        entries.push_back({id, frameCount, countConfig.count_loop, currentCount});
+    }
+    recordHistory(camConfig, dataArray, now_ms);
 
-                if (id != 1 && id != 2) {
-                    continue;
-                }
+    std::lock_guard<std::mutex> lock(cameraMtx);
+    if (cameraStatus.size() == 0) {
+        throw std::string("Camera status not initialized.");
+    }
+    bool activity = false;
+    for (const auto& entry : entries) {
+        int id = entry.id;
+        int frameCount = entry.frameCount;
+        int CurrentCount = entry.currentCount;
+        LV_LOG_DEBUG("Processing demand ID {}", id);
+        LV_LOG_DEBUG("Frame count is at ID {} with value {}", id, frameCount);
+        LV_LOG_DEBUG("Count loop is at ID {} with value {}", entry.countLoop, CurrentCount);
+
+        for (auto& camStatus : cameraStatus) {
+            if (camStatus.ip == camConfig.ip_address) {
+                camStatus.isAlive = true;
+                //camStatus.deadCount = 0;
+                camStatus.lastHeartbeat = now_ms;
+
+                for (auto& demandStatus : camStatus.demandStatus) {
+                    if (demandStatus.demandId != id) {
+                        continue;
+                    }
 
-                std::cout << "Processing demand ID " << id << std::endl;
+                    demandStatus.isFound = true;
 
-                int frameCount = data["frame_count"][0].GetInt();
-                auto countConfig = configManager.getDemandCountConfig(camConfig.ip_address, id);
-                int CurrentCount = json["data"][countConfig.count_loop - 1]["accumulate_count"][0].GetInt();
+                    if (frameCount > 0 || frameCount != demandStatus.lastFrameCount ||
+                            CurrentCount != demandStatus.lastAccumulateCount) {
+                        activity = true;
+                    }
+                    demandStatus.lastFrameCount = frameCount;
+                    demandStatus.lastAccumulateCount = CurrentCount;
 
-                std::cout << "Frame count is at ID " << id << " with value " << std::dec << frameCount << std::endl;
-                std::cout << "Count loop is at ID " << countConfig.count_loop << " with value " << std::dec << CurrentCount << std::endl;
+                    //skip if the demand is already handled
+                    if (demandStatus.isHandled) {
+                        LV_LOG_DEBUG("Demand already handled for demand ID {}", id);
+                        continue;
+                    }
 
-                if (cameraStatus.size() == 0) {
-                    std::cerr << "Camera status not initialized." << std::endl;
-                    return;
-                }
+                    if (demandStatus.previousCount == CurrentCount) {
+                        LV_LOG_DEBUG("Demand already processed for count loop ID {}", entry.countLoop);
+                        continue;
+                    }
 
-                for (auto& camStatus : cameraStatus) {
-                    if (camStatus.ip == camConfig.ip_address) {
-                        camStatus.isAlive = true;
-                        //camStatus.deadCount = 0;
-                        camStatus.lastHeartbeat = getcurrenttime_ms();
-
-                        for (auto& demandStatus : camStatus.demandStatus) {
-                            if (demandStatus.demandId != id) {
-                                continue;
-                            }
-
-                            demandStatus.isFound = true;
-
-                            //skip if the demand is already handled
-                            if (demandStatus.isHandled) {
-                                std::cout << "Demand already handled for demand ID " << id << std::endl;
-                                continue;
-                            }
-
-                            if (demandStatus.previousCount == CurrentCount) {
-                                std::cout << "Demand already processed for count loop ID " << countConfig.count_loop << std::endl;
-                                continue;
-                            }
-
-                            std::cout << "Storing the current count for count loop ID " << countConfig.count_loop << std::endl;
-                            demandStatus.previousCount = CurrentCount;
-
-                            if (frameCount > 0) {
-                                std::cout << "Car detected for demand ID: " << id << std::endl;
-                                auto gpioConfig = configManager.getDemandGpioConfig(camConfig.ip_address, id);
-                                controlModule.handleDemand(id, frameCount, gpioConfig.gpio_type, gpioConfig.gpio_pin);
-                                demandStatus.isHandled = true;
-                                demandStatus.lastHandledTime = getcurrenttime_ms();
-                                std::cout << "Recorded the last handled time for demand ID: " << id << std::endl;
-                            } else {
-                                std::cout << "No car detected for demand ID: " << id << std::endl;
-                                continue;
-                            }
-                        }
+                    LV_LOG_DEBUG("Storing the current count for count loop ID {}", entry.countLoop);
+                    demandStatus.previousCount = CurrentCount;
+                    saveDemandState(camConfig.ip_address, demandStatus);
+
+                    if (frameCount > 0) {
+                        LV_LOG_INFO("Car detected for demand ID: {}", id);
+                        auto gpioConfig = configManager.getDemandGpioConfig(camConfig.ip_address, id);
+                        stamps.handleUs = LatencyTracker::nowUs();
+                        controlModule.handleDemand(id, frameCount, gpioConfig.gpio_type, gpioConfig.gpio_pin);
+                        stamps.writtenUs = LatencyTracker::nowUs();
+                        latencyTracker.record(camConfig.ip_address, id, stamps);
+                        demandStatus.activations->inc();
+                        eventJournal.record(EventJournal::SourceDemand, id, frameCount);
+                        demandStatus.isHandled = true;
+                        demandStatus.lastHandledTime = now_ms;
+                        saveDemandState(camConfig.ip_address, demandStatus);
+                        LV_LOG_DEBUG("Recorded the last handled time for demand ID: {}", id);
+                    } else {
+                        LV_LOG_DEBUG("No car detected for demand ID: {}", id);
+                        continue;
                     }
                 }
             }
-            client.clear_all_conn();
-            return;
         }
     }
+    return activity;
+}
+
+//Method to keep the configured count loops of the response in the history, malformed entries are left to the demand check
+//the history is served to the dashboard, so it takes the wall time of now_ms
+void CameraManager::recordHistory(const ConfigManager::CameraConfig& camConfig, const LvJSON::Value& dataArray, uint64_t now_ms) {
+    uint64_t wall_ms = LvClock::toWallMs(now_ms);
+    for (const auto& data : dataArray.GetArray()) {
+        if (!data.IsObject() || !data.HasMember("id") || !data["id"].IsInt() ||
+                !data.HasMember("accumulate_count") || !data["accumulate_count"].IsArray()) {
+            continue;
+        }
+        int loop = data["id"].GetInt();
+        bool counted = false;
+        for (const auto& demand : camConfig.demands) {
+            counted = counted || demand.count_loop == loop;
+        }
+        if (!counted) {
+            continue;
+        }
+        int frameCount = 0;
+        if (data.HasMember("frame_count") && data["frame_count"].IsArray() &&
+                data["frame_count"].Size() > 0 && data["frame_count"][0].IsInt()) {
+            frameCount = data["frame_count"][0].GetInt();
+        }
+        std::vector<int> inboundCounts;
+        for (const auto& count : data["accumulate_count"].GetArray()) {
+            inboundCounts.push_back(count.IsInt() ? count.GetInt() : 0);
+        }
+        countHistory.record(camConfig.ip_address, loop, wall_ms, frameCount, inboundCounts);
+    }
+}
+
+//Method to get the first element of an int array member, e.g. "frame_count": [3]
+int CameraManager::firstInt(const LvJSON::Value& obj, const char* key) {
+    if (!obj.IsObject() || !obj.HasMember(key) || !obj[key].IsArray() ||
+            obj[key].Size() == 0 || !obj[key][0].IsInt()) {
+        throw std::string("Property \"" + std::string(key) + "\" must be an array of Int");
+    }
+    return obj[key][0].GetInt();
 }
 
 //Method to check the heartbeat for the camera, if last heartbeat is greater than 1000ms, the camera is considered dead, and the gpio pin is toggled to low
-void CameraManager::checkHeartbeat(const ConfigManager::CameraConfig& camConfig) {
+void CameraManager::checkHeartbeat(const ConfigManager::CameraConfig& camConfig, uint64_t now_ms) {
+    std::lock_guard<std::mutex> lock(cameraMtx);
     for (auto& camStatus : cameraStatus) {
         if (camStatus.ip != camConfig.ip_address) {
             continue;
         }
 
-        uint64_t now_ms = getcurrenttime_ms();
-        if (now_ms - camStatus.lastHeartbeat > 1000) {
+        // a count pushed at the ingest thread may be stamped after this tick started
+        if (now_ms > camStatus.lastHeartbeat + 1000) {
             camStatus.deadCount++;
             if (camStatus.deadCount > 2) {
                 camStatus.isAlive = false;
                 //toggle gpio pin that represents the camera status to low using handleHeartbeat method
                 controlModule.handleHeartbeat(camStatus.ip, false);
-                std::cout << "Camera: " << camConfig.ip_address << " is dead." << std::endl;
+                LV_LOG_INFO("Camera: {} is dead.", camConfig.ip_address);
             }
         } else {
             camStatus.deadCount = 0;
@@ -222,37 +387,110 @@ std::string CameraManager::generateAliveStatusJSON() {
 
 //Method to publish the JSON output to the MQTT server
 void CameraManager::publishAliveStatus() {
-    std::string jsonOutput = generateAliveStatusJSON();
+    LV_TRACE_SCOPE("camera.publishAlive");
+    std::string jsonOutput;
+    {
+        std::lock_guard<std::mutex> lock(cameraMtx);
+        jsonOutput = generateAliveStatusJSON();
+    }
     commModule.publish("Camera_status", jsonOutput);
 }
 
 // New method to reset the demand status
 // If the demand is handled and the lastHandledTime is greater than the hold time, the demand is reset
-void CameraManager::resetDemandStatus() {
+void CameraManager::resetDemandStatus(uint64_t now_ms) {
+    LV_TRACE_SCOPE("camera.resetDemand");
+    std::lock_guard<std::mutex> lock(cameraMtx);
     for (auto& camStatus : cameraStatus) {
         for (auto& demandStatus : camStatus.demandStatus) {
-            uint64_t now_ms = getcurrenttime_ms();
             int hold_time = configManager.getDemandHoldTime(demandStatus.demandId);
 
-            if (demandStatus.isHandled && now_ms - demandStatus.lastHandledTime > hold_time) {
-                std::cout << "Demand: " << demandStatus.demandId << " hold time exceeded." << std::endl;
+            if (demandStatus.isHandled && now_ms > demandStatus.lastHandledTime + hold_time) {
+                LV_LOG_INFO("Demand: {} hold time exceeded.", demandStatus.demandId);
                 auto gpioConfig = configManager.getDemandGpioConfig(camStatus.ip, demandStatus.demandId);
-                controlModule.resetDemand(demandStatus.demandId);
+                controlModule.resetDemand(demandStatus.demandId, gpioConfig.gpio_type, gpioConfig.gpio_pin);
+                eventJournal.record(EventJournal::SourceDemand, demandStatus.demandId, 0);
                 demandStatus.isHandled = false;
+                saveDemandState(camStatus.ip, demandStatus);
             }
         }
     }
 }
 
-//New method to loop through the camera configurations, checking, resetting the demand and checking the heartbeat
+//Method to checkpoint the demand so a restart resumes from it
+void CameraManager::saveDemandState(const std::string& ip, const DemandStatus& demandStatus) {
+    StateStore::DemandState state;
+    state.previousCount = demandStatus.previousCount;
+    state.isHandled = demandStatus.isHandled;
+    state.lastHandledTime = LvClock::toWallMs(demandStatus.lastHandledTime); // monotonic time does not outlive a reboot
+    stateStore.saveDemand(ip, demandStatus.demandId, state);
+}
+
+//Method to check if the AC phase of the camera approach is red, the expander input is low when the light is on
+bool CameraManager::isPhaseRed(const ConfigManager::CameraConfig& camConfig) {
+    if (camConfig.phase == 0) {
+        return false;
+    }
+    return !controlModule.readACStatus(configManager.getACConfig(camConfig.phase).red_gpio_pin);
+}
+
+//Method to set the next poll time, back to the fastest rate on activity, otherwise twice slower up to the max
+void CameraManager::schedulePoll(PollStatus& poll, bool activity, uint64_t now_ms) {
+    const auto& pollingConfig = configManager.getPollingConfig();
+    if (activity) {
+        poll.intervalMs = pollingConfig.min_interval_ms;
+    } else {
+        poll.intervalMs = std::min(poll.intervalMs * 2, pollingConfig.max_interval_ms);
+    }
+    poll.nextPollMs = now_ms + poll.intervalMs;
+}
+
+//New method to loop through the camera configurations, polling the cameras that are due, resetting the demand and checking the heartbeat
 void CameraManager::loop(uint64_t now_ms) {
-    for (const auto& camConfig : configManager.getCameraConfigs()) {
-        std::cout << "--------------------------------------------------------------------------------" << std::endl;
-        std::cout << "Searching for camera: " << camConfig.ip_address << std::endl;
-        checkDemand(camConfig);
-        checkHeartbeat(camConfig);
+    const auto& camConfigs = configManager.getCameraConfigs();
+    bool checked = false;
+    // a replay has no network, the capture says when the camera answered and how long the poll took
+    bool replaying = cameraCapture.isReplaying();
+    for (size_t i = 0; i < camConfigs.size(); i++) {
+        const auto& camConfig = camConfigs[i];
+        PollStatus& poll = pollStatus[i];
+        if (replaying && now_ms < replayBusyUntilMs) {
+            break; // the polls were sequential, the others wait like they did in the field
+        }
+        if (now_ms < poll.nextPollMs) {
+            continue;
+        }
+        checked = true;
+
+        LV_LOG_DEBUG("--------------------------------------------------------------------------------");
+        LV_LOG_DEBUG("Searching for camera: {}", camConfig.ip_address);
+        // A camera that stopped answering is left to the prober, dont spend the poll timeout on it
+        if (!replaying && !cameraLiveness.isAlive(camConfig.ip_address)) {
+            LV_LOG_INFO("Camera: {} unreachable, poll skipped.", camConfig.ip_address);
+            checkHeartbeat(camConfig, now_ms);
+            schedulePoll(poll, true, now_ms); // check again soon, the prober may bring it back
+            continue;
+        }
+        bool activity = false;
+        uint64_t poll_start_ms = mg_millis();
+        LV_PROBE1(camera_request_start, camConfig.ip_address.c_str());
+        bool ok = checkDemand(camConfig, activity, now_ms);
+        LV_PROBE2(camera_request_done, camConfig.ip_address.c_str(), ok);
+        poll.pollDuration->observe(mg_millis() - poll_start_ms);
+        poll.polls->inc();
+        if (!ok) {
+            poll.pollErrors->inc();
+        }
+        if (!replaying) {
+            cameraLiveness.reportPoll(camConfig.ip_address, ok);
+        }
+        checkHeartbeat(camConfig, now_ms);
+        schedulePoll(poll, activity || isPhaseRed(camConfig), now_ms);
+        LV_LOG_DEBUG("Camera: {} next poll in {} ms", camConfig.ip_address, poll.intervalMs);
+    }
+
+    if (checked) {
         publishAliveStatus();
-        resetDemandStatus();
-        usleep(500000);
     }
-}
\ No newline at end of file
+    resetDemandStatus(now_ms);
+}
@@ -4,47 +4,93 @@
 #include "ConfigManager.h"
 #include "ControlModule.h"
 #include "CommModule.h"
+#include "CameraLiveness.h"
+#include "CountHistory.h"
+#include "EventJournal.h"
+#include "StateStore.h"
+#include "LatencyTracker.h"
+#include "CameraCapture.h"
 #include "LvRestfulClient.h"
 #include "LvJSON.h"
+#include "LvLog.h"
+#include "LvMetrics.h"
+#include "LvTrace.h"
+#include "LvProbe.h"
+#include "LvClock.h"
 #include <string>
 #include <vector>
 #include <iostream>
 #include <chrono>
 #include <unistd.h>
 #include <map>
+#include <mutex>
+#include <algorithm>
 
 class CameraManager {
 public:
-    CameraManager(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule);
+    CameraManager(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, CameraLiveness& cameraLiveness,
+                  CountHistory& countHistory, EventJournal& eventJournal, StateStore& stateStore, LatencyTracker& latencyTracker,
+                  CameraCapture& cameraCapture);
     void loop(uint64_t now_ms);
-    
+
+    // Method to take a count JSON pushed by a camera, safe to call at other thread, throws std::string when rejected
+    void ingestCount(const std::string& ip, const std::string& body);
+
 private:
     const ConfigManager& configManager;
     ControlModule& controlModule;
     CommModule& commModule;
+    CameraLiveness& cameraLiveness;
+    CountHistory& countHistory;
+    EventJournal& eventJournal;
+    StateStore& stateStore;
+    LatencyTracker& latencyTracker;
+    CameraCapture& cameraCapture;
 
     struct DemandStatus{
         int demandId;
         bool isFound;
         bool isHandled;
-        uint64_t lastHandledTime;
+        uint64_t lastHandledTime; // LvClock::nowMs() time
         int previousCount;
+        int lastFrameCount; // last seen values, a change counts as activity for the poll rate
+        int lastAccumulateCount;
+        LvMetrics::Counter* activations;
     };
 
     struct CameraStatus{
         std::string ip;
         bool isAlive;
         int deadCount;
-        uint64_t lastHeartbeat;
+        uint64_t lastHeartbeat; // LvClock::nowMs() time
         std::vector<DemandStatus> demandStatus;
     };
 
     std::vector<CameraStatus> cameraStatus;
-    void checkDemand(const ConfigManager::CameraConfig& camConfig);
-    void checkHeartbeat(const ConfigManager::CameraConfig& camConfig);
+    std::mutex cameraMtx; // cameraStatus is updated by the camera loop and by the pushed counts
+    // Poll schedule, camera loop only, same order as the camera configs
+    struct PollStatus{
+        uint64_t nextPollMs;
+        int intervalMs;
+        LvMetrics::Counter* polls;
+        LvMetrics::Counter* pollErrors;
+        LvMetrics::Histogram* pollDuration;
+    };
+    std::vector<PollStatus> pollStatus;
+    uint64_t replayBusyUntilMs = 0; // a replayed poll holds the camera loop as long as it took in the capture
+
+    bool checkDemand(const ConfigManager::CameraConfig& camConfig, bool& activity, uint64_t now_ms);
+    void requestCount(const ConfigManager::CameraConfig& camConfig, int& statusCode, std::string& responseBody);
+    bool processCount(const ConfigManager::CameraConfig& camConfig, const std::string& body, LatencyTracker::Stamps stamps, uint64_t now_ms);
+    bool isPhaseRed(const ConfigManager::CameraConfig& camConfig);
+    void schedulePoll(PollStatus& poll, bool activity, uint64_t now_ms);
+    void recordHistory(const ConfigManager::CameraConfig& camConfig, const LvJSON::Value& dataArray, uint64_t now_ms);
+    static int firstInt(const LvJSON::Value& obj, const char* key);
+    void checkHeartbeat(const ConfigManager::CameraConfig& camConfig, uint64_t now_ms);
     std::string generateAliveStatusJSON();
     void publishAliveStatus();
-    void resetDemandStatus();
+    void resetDemandStatus(uint64_t now_ms);
+    void saveDemandState(const std::string& ip, const DemandStatus& demandStatus);
 };
 
 #endif // CAMERA_MANAGER_H
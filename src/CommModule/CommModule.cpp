@@ -1,34 +1,113 @@
 #include "CommModule.h"
 
 // Constructor to initialize the MQTT server with the provided address
-CommModule::CommModule(const std::string& address)
-    : mqttServer(address.c_str()) // Initialize LvMQTTServer with the address
+CommModule::CommModule(const std::string& address, const std::string& wsAddress)
+    : mqttServer(address.c_str(), wsAddress.c_str()), // Initialize LvMQTTServer with the address
+      publishCounter(LvMetrics::instance().counter("iotbox_mqtt_published_total", "Messages published by the modules"))
 {
+    LvMetrics::instance().gaugeCallback("iotbox_mqtt_queue_depth", "Published messages waiting for the broker thread",
+                                        &CommModule::pendingCount, this);
+    LvMetrics::instance().counterCallback("iotbox_mqtt_dropped_total", "Published messages dropped, queue full",
+                                          &CommModule::droppedCount, this);
+
     std::cout << "CommModule initialized on address: " << address << std::endl;
+    if (!wsAddress.empty())
+    {
+        std::cout << "MQTT over websocket on address: " << wsAddress << "/mqtt" << std::endl;
+    }
 }
 
 // Method to publish a message to a specified topic
 void CommModule::publish(const std::string& topic, const std::string& payload)
 {
-    if (mqttServer.put(topic, payload) != 0)
+    LV_TRACE_SCOPE("mqtt.publish");
+    int rc = mqttServer.put(topic, payload);
+    LV_PROBE3(mqtt_publish, topic.c_str(), payload.size(), rc);
+    if (rc != 0)
     {
-        std::cerr << "Error publishing to topic: " << topic << std::endl;
+        LV_LOG_ERROR("Error publishing to topic: {}", topic);
     }
     else
     {
-        std::cout << "Published to topic: " << topic << "\n" <<"Payload: " << payload << std::endl;
+        publishCounter.inc();
+        LV_LOG_DEBUG("Published to topic: {}\nPayload: {}", topic, payload);
     }
+
+    for (const auto& callback : onPublishCallbacks)
+    {
+        callback.first(callback.second, topic, payload);
+    }
+}
+
+// Metrics callbacks, read at export time
+double CommModule::pendingCount(void* self)
+{
+    return ((CommModule*)self)->mqttServer.pending_count();
 }
 
-// Method to subscribe to a specific topic
-void CommModule::subscribe(const std::string& topic)
+double CommModule::droppedCount(void* self)
+{
+    return ((CommModule*)self)->mqttServer.dropped_count();
+}
+
+// Method to subscribe to a specific topic, set it before the broker thread is started
+void CommModule::subscribe(const std::string& topic, LvMqttServer::OnMessageCallback callback, void* self)
 {
     mqttServer.interest_topic_add(topic);
+    if (subscriptions.empty())
+    {
+        mqttServer.set_on_interest_message(&CommModule::onMessage, this);
+    }
+    subscriptions.push_back({topic, callback, self});
     std::cout << "Subscribed to topic: " << topic << std::endl;
 }
 
+// Method to get the address of the client that sent the message being passed to a subscription
+std::string CommModule::messageSourceIp()
+{
+    return mqttServer.message_source_ip();
+}
+
+// Callback from the broker thread for every subscribed topic message, passed to every matching subscription
+void CommModule::onMessage(void* self, const std::string topic, const std::string payload)
+{
+    CommModule& commModule = *(CommModule*)self;
+    for (const auto& subscription : commModule.subscriptions)
+    {
+        if (mg_globmatch(subscription.topic.c_str(), subscription.topic.size(), topic.c_str(), topic.size()))
+        {
+            subscription.callback(subscription.self, topic, payload);
+        }
+    }
+}
+
+// Method to get a copy of every published message, set it before the broker thread is started
+void CommModule::addOnPublishCallback(LvMqttServer::OnMessageCallback callback, void* self)
+{
+    onPublishCallbacks.push_back({callback, self});
+}
+
+// Method to mark a topic as state, a newer message replaces the pending one instead of queueing behind it
+void CommModule::addStateTopic(const std::string& topic)
+{
+    mqttServer.state_topic_add(topic);
+    std::cout << "State topic: " << topic << std::endl;
+}
+
+// Method to run the MQTT broker at its own thread, call after all the modules registered their topics
+void CommModule::start()
+{
+    if (mqttServer.start() != 0)
+    {
+        std::cerr << "Failed to start MQTT broker thread, serviced from loop instead" << std::endl;
+        return;
+    }
+    std::cout << "MQTT broker thread started" << std::endl;
+}
+
 // Method to process MQTT events
 void CommModule::loop(uint64_t now_ms)
 {
+    LV_TRACE_SCOPE("mqtt.poll");
     mqttServer.loop(now_ms);
 }
@@ -2,26 +2,56 @@
 #define COMM_MODULE_H
 
 #include "LvMQTTServer.h"
+#include "LvLog.h"
+#include "LvMetrics.h"
+#include "LvTrace.h"
+#include "LvProbe.h"
 #include <string>
+#include <vector>
 #include <iostream>
 
 class CommModule
 {
 public:
-    // Constructor to initialize the MQTT server
-    CommModule(const std::string& address);
+    // Constructor to initialize the MQTT server, wsAddress accepts MQTT over websocket at /mqtt when not empty
+    CommModule(const std::string& address, const std::string& wsAddress = "");
 
     // Method to publish a message to a topic
     void publish(const std::string& topic, const std::string& payload);
 
-    // Method to subscribe to a topic
-    void subscribe(const std::string& topic);
+    // Method to subscribe to a topic, the matching messages are passed to the callback at the broker thread
+    void subscribe(const std::string& topic, LvMqttServer::OnMessageCallback callback, void* self);
 
-    // Method to process MQTT events
+    // Method to get the address of the client that sent the message, only valid inside a subscribe callback
+    std::string messageSourceIp();
+
+    // Method to get a copy of every published message, e.g. to forward it upstream
+    void addOnPublishCallback(LvMqttServer::OnMessageCallback callback, void* self);
+
+    // Method to mark a topic as state, only the latest pending message is kept
+    void addStateTopic(const std::string& topic);
+
+    // Method to run the MQTT broker at its own thread
+    void start();
+
+    // Method to process MQTT events, do nothing once the broker thread is started
     void loop(uint64_t now_ms);
 
 private:
     LvMQTTServer mqttServer;
+    LvMetrics::Counter& publishCounter;
+    std::vector<std::pair<LvMqttServer::OnMessageCallback, void*>> onPublishCallbacks;
+
+    struct Subscription {
+        std::string topic;
+        LvMqttServer::OnMessageCallback callback;
+        void* self;
+    };
+    std::vector<Subscription> subscriptions;
+
+    static double pendingCount(void* self);
+    static double droppedCount(void* self);
+    static void onMessage(void* self, const std::string topic, const std::string payload);
 };
 
 #endif // COMM_MODULE_H
@@ -0,0 +1,129 @@
+#include "CommandModule.h"
+
+//Constructor
+CommandModule::CommandModule(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule)
+    : configManager(configManager), controlModule(controlModule), commModule(commModule) {
+    // Dispatch table, first match wins
+    commands.push_back({"cmd/demand/*", &CommandModule::handleDemand});
+    commands.push_back({"cmd/output/*/*", &CommandModule::handleOutput});
+    commands.push_back({"cmd/reload", &CommandModule::handleReload});
+
+    commModule.subscribe("cmd/#", &CommandModule::onMessage, this);
+}
+
+// Callback from the MQTT broker thread for every subscribed topic message
+void CommandModule::onMessage(void* self, const std::string topic, const std::string payload) {
+    ((CommandModule*)self)->dispatch(topic, payload);
+}
+
+// Method to find the command handler for the topic, run it and acknowledge the result
+void CommandModule::dispatch(const std::string& topic, const std::string& payload) {
+    for (const auto& command : commands) {
+        if (!mg_globmatch(command.topic.c_str(), command.topic.size(), topic.c_str(), topic.size())) {
+            continue;
+        }
+
+        LvJSON doc;
+        if (doc.Parse(payload.size() ? payload.c_str() : "{}").HasParseError() || !doc.IsObject()) {
+            publishAck(topic, "Payload must be a JSON object");
+            return;
+        }
+
+        try {
+            (this->*command.handler)(splitTopic(topic), doc);
+        } catch (const std::string& err) {
+            publishAck(topic, err);
+            return;
+        }
+        publishAck(topic, "");
+        return;
+    }
+    publishAck(topic, "Unknown command");
+}
+
+// Method to force or release a demand, cmd/demand/<detect_loop>
+void CommandModule::handleDemand(const std::vector<std::string>& args, const LvJSON& doc) {
+    int detect_loop = toInt(args[2]);
+    LvJSON::checkType(doc, "value", LvJSON::Int, 2);
+    bool value = doc["value"].GetInt();
+
+    bool found = false;
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        for (const auto& demand : camConfig.demands) {
+            if (demand.detect_loop != detect_loop) {
+                continue;
+            }
+            found = true;
+            if (value) {
+                controlModule.handleDemand(detect_loop, 0, demand.gpio_type, demand.gpio_pin);
+            } else {
+                controlModule.setOutput(demand.gpio_type, demand.gpio_pin, false);
+            }
+        }
+    }
+    if (!found) {
+        throw std::string("Demand not found for virtual loop ID: " + args[2]);
+    }
+    std::cout << "Command: demand " << detect_loop << " set to " << value << std::endl;
+}
+
+// Method to drive an expander output, cmd/output/<gpio_type>/<pin>
+void CommandModule::handleOutput(const std::vector<std::string>& args, const LvJSON& doc) {
+    int gpio_type = toInt(args[2]);
+    int gpio_pin = toInt(args[3]);
+    if (gpio_type != I2C_MCP23017_0x20 && gpio_type != I2C_MCP23017_0x21) {
+        throw std::string("GPIO type must be an IO expander");
+    }
+    if (gpio_pin < 0 || gpio_pin > 7) {
+        throw std::string("GPIO pin must be from 0 to 7");
+    }
+    LvJSON::checkType(doc, "value", LvJSON::Int, 2);
+    controlModule.setOutput(gpio_type, gpio_pin, doc["value"].GetInt());
+}
+
+// Method to reinitialize the expanders, cmd/reload
+void CommandModule::handleReload(const std::vector<std::string>& /*args*/, const LvJSON& /*doc*/) {
+    controlModule.reinitialize();
+}
+
+// Method to publish the command result on ack/<command topic>
+void CommandModule::publishAck(const std::string& topic, const std::string& error) {
+    LvJSON doc;
+    auto& allocator = doc.GetAllocator();
+    doc.SetObject();
+
+    rapidjson::Value topicValue;
+    topicValue.SetString(topic.c_str(), allocator);
+    doc.AddMember("topic", topicValue, allocator);
+    doc.AddMember("result", rapidjson::StringRef(error.empty() ? "ok" : "error"), allocator);
+    if (!error.empty()) {
+        rapidjson::Value errorValue;
+        errorValue.SetString(error.c_str(), allocator);
+        doc.AddMember("message", errorValue, allocator);
+    }
+
+    commModule.publish("ack/" + topic, doc.stringify());
+}
+
+// Method to split the topic into its levels
+std::vector<std::string> CommandModule::splitTopic(const std::string& topic) {
+    std::vector<std::string> levels;
+    size_t start = 0;
+    size_t end;
+    while ((end = topic.find('/', start)) != std::string::npos) {
+        levels.push_back(topic.substr(start, end - start));
+        start = end + 1;
+    }
+    levels.push_back(topic.substr(start));
+    return levels;
+}
+
+// Method to convert a topic level to int, throw if it is not a number
+int CommandModule::toInt(const std::string& str) {
+    char* end = NULL;
+    long value = strtol(str.c_str(), &end, 10);
+    if (str.empty() || *end != '\0') {
+        throw std::string("\"" + str + "\" is not a number");
+    }
+    return (int)value;
+}
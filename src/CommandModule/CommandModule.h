@@ -0,0 +1,45 @@
+#ifndef COMMAND_MODULE_H
+#define COMMAND_MODULE_H
+
+#include "ConfigManager.h"
+#include "ControlModule.h"
+#include "CommModule.h"
+#include "LvJSON.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Handles the commands published by the central controller, runs at the MQTT broker thread
+// cmd/demand/<detect_loop>       {"value": 1|0}  force or release the demand output
+// cmd/output/<gpio_type>/<pin>   {"value": 1|0}  drive an expander output
+// cmd/reload                     {}              reinitialize the expanders and rewrite the outputs
+// every command is acknowledged on ack/<command topic>
+class CommandModule {
+public:
+    CommandModule(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule);
+
+private:
+    const ConfigManager& configManager;
+    ControlModule& controlModule;
+    CommModule& commModule;
+
+    typedef void (CommandModule::*CommandHandler)(const std::vector<std::string>& args, const LvJSON& doc);
+
+    struct Command {
+        std::string topic; // mg_globmatch pattern, '*' matches one level
+        CommandHandler handler;
+    };
+
+    std::vector<Command> commands;
+
+    static void onMessage(void* self, const std::string topic, const std::string payload);
+    void dispatch(const std::string& topic, const std::string& payload);
+    void handleDemand(const std::vector<std::string>& args, const LvJSON& doc);
+    void handleOutput(const std::vector<std::string>& args, const LvJSON& doc);
+    void handleReload(const std::vector<std::string>& args, const LvJSON& doc);
+    void publishAck(const std::string& topic, const std::string& error);
+    static std::vector<std::string> splitTopic(const std::string& topic);
+    static int toInt(const std::string& str);
+};
+
+#endif // COMMAND_MODULE_H
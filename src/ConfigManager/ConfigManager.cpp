@@ -75,6 +75,11 @@ bool ConfigManager::loadConfig() {
         LvJSON::checkType(cameras[i], "status_gpio_pin", LvJSON::Int);
         camConfig.status_gpio_pin = cameras[i]["status_gpio_pin"].GetInt();
 
+        // phase is optional, a red phase makes the camera polled at the fastest rate
+        if (cameras[i].HasMember("phase")) {
+            camConfig.phase = cameras[i]["phase"].GetInt();
+        }
+
         LvJSON::checkType(cameras[i], "Demand", LvJSON::Array);
         const LvJSON::Value& demands = cameras[i]["Demand"];
         for (LvJSON::SizeType j = 0; j < demands.Size(); j++) {
@@ -129,6 +134,63 @@ bool ConfigManager::loadConfig() {
         dcConfigs.push_back(dcConfig);
     }
 
+    // uplink is optional, box without it only serves the local broker
+    if (doc.HasMember("uplink")) {
+        const LvJSON::Value& uplink = doc["uplink"];
+        uplinkConfig.enabled = uplink["enabled"].GetBool();
+        uplinkConfig.url = uplink["url"].GetString();
+        uplinkConfig.client_id = uplink["client_id"].GetString();
+        for (const auto& topic : uplink["topics"].GetArray()) {
+            uplinkConfig.topics.push_back(topic.GetString());
+        }
+        uplinkConfig.buffer_file = uplink["buffer_file"].GetString();
+        uplinkConfig.buffer_size = uplink["buffer_size"].GetInt();
+        uplinkConfig.replay_rate = uplink["replay_rate"].GetInt();
+    }
+
+    // polling is optional, the defaults are used without it
+    if (doc.HasMember("polling")) {
+        const LvJSON::Value& polling = doc["polling"];
+        pollingConfig.min_interval_ms = polling["min_interval_ms"].GetInt();
+        pollingConfig.max_interval_ms = polling["max_interval_ms"].GetInt();
+    }
+
+    // journal is optional, the defaults are used without it
+    if (doc.HasMember("journal")) {
+        const LvJSON::Value& journal = doc["journal"];
+        journalConfig.file = journal["file"].GetString();
+        journalConfig.capacity = journal["capacity"].GetInt();
+        journalConfig.flush_interval_ms = journal["flush_interval_ms"].GetInt();
+    }
+
+    // state is optional, the defaults are used without it
+    if (doc.HasMember("state")) {
+        const LvJSON::Value& state = doc["state"];
+        stateConfig.file = state["file"].GetString();
+        stateConfig.flush_interval_ms = state["flush_interval_ms"].GetInt();
+    }
+
+    // trace is optional, the defaults are used without it
+    if (doc.HasMember("trace")) {
+        const LvJSON::Value& trace = doc["trace"];
+        traceConfig.enabled = trace["enabled"].GetBool();
+        traceConfig.file = trace["file"].GetString();
+        traceConfig.ring_events = trace["ring_events"].GetInt();
+    }
+
+    // capture is optional, the defaults are used without it
+    if (doc.HasMember("capture")) {
+        const LvJSON::Value& capture = doc["capture"];
+        captureConfig.mode = capture["mode"].GetString();
+        captureConfig.file = capture["file"].GetString();
+        captureConfig.speed = capture["speed"].GetDouble();
+    }
+
+    // dashboard is optional, the defaults are used without it
+    if (doc.HasMember("dashboard")) {
+        dashboardConfig.root_dir = doc["dashboard"]["root_dir"].GetString();
+    }
+
     return true;
 }
 
@@ -139,21 +201,21 @@ const std::vector<ConfigManager::CameraConfig>& ConfigManager::getCameraConfigs(
 
 //method to return demand GPIO config, specifically the gpio type and pin
 ConfigManager::GpioConfig ConfigManager::getDemandGpioConfig(const std::string& ip, int detect_loop) const {
-    std::cout << "Getting demand GPIO config for IP: " << ip << " and virtual loop ID: " << detect_loop << std::endl;
+    LV_LOG_DEBUG("Getting demand GPIO config for IP: {} and virtual loop ID: {}", ip, detect_loop);
     for (const auto& camConfig : cameraConfigs) { 
         if (camConfig.ip_address == ip) {
             for (const auto& demand : camConfig.demands) { 
                 if (demand.detect_loop == detect_loop) {
-                    std::cout << "Demand found for virtual loop ID: " << detect_loop << std::endl;
-                    std::cout << "The GPIO type is: " << demand.gpio_type << " and the GPIO pin is: " << demand.gpio_pin << std::endl;
+                    LV_LOG_DEBUG("Demand found for virtual loop ID: {}", detect_loop);
+                    LV_LOG_DEBUG("The GPIO type is: {} and the GPIO pin is: {}", demand.gpio_type, demand.gpio_pin);
                     return {demand.gpio_type, demand.gpio_pin};
                 }
             }
-            std::cerr << "Demand not found for virtual loop ID: " << detect_loop << std::endl;
+            LV_LOG_ERROR("Demand not found for virtual loop ID: {}", detect_loop);
             return {};
         }
     }
-    std::cerr << "Demand GPIO config not found for IP: " << ip << std::endl;
+    LV_LOG_ERROR("Demand GPIO config not found for IP: {}", ip);
     return {};
 }
 
@@ -173,7 +235,7 @@ ConfigManager::GpioConfig ConfigManager::getStatusGpioConfig(const std::string&
             return {camConfig.status_gpio_pin};
         }
     }
-    std::cerr << "Camera not found for IP: " << ip << std::endl;
+    LV_LOG_ERROR("Camera not found for IP: {}", ip);
     return {};
 }
 
@@ -184,7 +246,7 @@ ConfigManager::CameraConfig ConfigManager::getCameraConfig(const std::string& ip
             return camConfig;
         }
     }
-    std::cerr << "Camera config not found for IP: " << ip << std::endl;
+    LV_LOG_ERROR("Camera config not found for IP: {}", ip);
     return {};
 }
 
@@ -197,7 +259,7 @@ int ConfigManager::getDemandHoldTime(int detect_loop) const {
             }
         }
     }
-    std::cerr << "Hold time not found for virtual loop ID: " << detect_loop << std::endl;
+    LV_LOG_ERROR("Hold time not found for virtual loop ID: {}", detect_loop);
     return -1;
 }
 
@@ -207,15 +269,15 @@ ConfigManager::Demand ConfigManager::getDemandCountConfig(const std::string& ip,
         if (camConfig.ip_address == ip) {
             for (const auto& demand : camConfig.demands) {
                 if (demand.detect_loop == detect_loop) {
-                    std::cout << "Count loop for virtual loop ID: " << detect_loop << " is: " << demand.count_loop << std::endl;
+                    LV_LOG_DEBUG("Count loop for virtual loop ID: {} is: {}", detect_loop, demand.count_loop);
                     return demand;
                 }
             }
-            std::cerr << "Count loop not found for virtual loop ID: " << detect_loop << std::endl;
+            LV_LOG_ERROR("Count loop not found for virtual loop ID: {}", detect_loop);
             return {};
         }
     }
-    std::cerr << "Camera not found for IP: " << ip << std::endl;
+    LV_LOG_ERROR("Camera not found for IP: {}", ip);
     return {};
 }
 
@@ -231,7 +293,7 @@ ConfigManager::AC_in_config ConfigManager::getACConfig(int phase) const {
             return acConfig;
         }
     }
-    std::cerr << "AC config not found for phase: " << phase << std::endl;
+    LV_LOG_ERROR("AC config not found for phase: {}", phase);
     return {};
 }
 
@@ -247,10 +309,45 @@ ConfigManager::DC_in_config ConfigManager::getDCConfig(int push_button) const {
             return dcConfig;
         }
     }
-    std::cerr << "DC config not found for push button: " << push_button << std::endl;
+    LV_LOG_ERROR("DC config not found for push button: {}", push_button);
     return {};
 }
 
+//Get uplink config
+const ConfigManager::UplinkConfig& ConfigManager::getUplinkConfig() const {
+    return uplinkConfig;
+}
+
+//Get polling config
+const ConfigManager::PollingConfig& ConfigManager::getPollingConfig() const {
+    return pollingConfig;
+}
+
+//Get journal config
+const ConfigManager::JournalConfig& ConfigManager::getJournalConfig() const {
+    return journalConfig;
+}
+
+//Get state config
+const ConfigManager::StateConfig& ConfigManager::getStateConfig() const {
+    return stateConfig;
+}
+
+//Get trace config
+const ConfigManager::TraceConfig& ConfigManager::getTraceConfig() const {
+    return traceConfig;
+}
+
+//Get capture config
+const ConfigManager::CaptureConfig& ConfigManager::getCaptureConfig() const {
+    return captureConfig;
+}
+
+//Get dashboard config
+const ConfigManager::DashboardConfig& ConfigManager::getDashboardConfig() const {
+    return dashboardConfig;
+}
+
 //method to validate the configuration, checking the types of the values
 bool ConfigManager::validateConfig(const LvJSON& doc) {
     try {
@@ -266,6 +363,9 @@ bool ConfigManager::validateConfig(const LvJSON& doc) {
             LvJSON::checkType(cameras[i], "status_gpio_type", LvJSON::Int);
             LvJSON::checkType(cameras[i], "status_gpio_pin", LvJSON::Int);
             LvJSON::checkType(cameras[i], "Demand", LvJSON::Array);
+            if (cameras[i].HasMember("phase")) {
+                LvJSON::checkType(cameras[i], "phase", LvJSON::Int);
+            }
 
             const LvJSON::Value& demands = cameras[i]["Demand"];
             for (LvJSON::SizeType j = 0; j < demands.Size(); j++) {
@@ -293,6 +393,101 @@ bool ConfigManager::validateConfig(const LvJSON& doc) {
             LvJSON::checkType(dcconfigs[i], "push_button", LvJSON::Int);
             LvJSON::checkType(dcconfigs[i], "gpio_pin", LvJSON::Int);
         }
+
+        // Validate uplink, optional
+        if (doc.HasMember("uplink")) {
+            LvJSON::checkType(doc, "uplink", LvJSON::Object);
+            const LvJSON::Value& uplink = doc["uplink"];
+            LvJSON::checkType(uplink, "enabled", LvJSON::Bool);
+            LvJSON::checkType(uplink, "url", LvJSON::String);
+            LvJSON::checkType(uplink, "client_id", LvJSON::String);
+            LvJSON::checkType(uplink, "topics", LvJSON::Array);
+            for (const auto& topic : uplink["topics"].GetArray()) {
+                if (!topic.IsString()) {
+                    throw std::string("Property \"topics\" must be an Array of String");
+                }
+            }
+            LvJSON::checkType(uplink, "buffer_file", LvJSON::String);
+            LvJSON::checkType(uplink, "buffer_size", LvJSON::Int);
+            LvJSON::checkType(uplink, "replay_rate", LvJSON::Int);
+            // a message takes at most half of the ring, below this a status message would not fit
+            if (uplink["buffer_size"].GetInt() < UPLINK_MIN_BUFFER_SIZE) {
+                throw std::string("Property \"buffer_size\" must be at least " + std::to_string(UPLINK_MIN_BUFFER_SIZE));
+            }
+            // 0 would never send the buffered messages
+            if (uplink["replay_rate"].GetInt() < 1) {
+                throw std::string("Property \"replay_rate\" must be at least 1");
+            }
+        }
+
+        // Validate polling, optional
+        if (doc.HasMember("polling")) {
+            LvJSON::checkType(doc, "polling", LvJSON::Object);
+            const LvJSON::Value& polling = doc["polling"];
+            LvJSON::checkType(polling, "min_interval_ms", LvJSON::Int);
+            LvJSON::checkType(polling, "max_interval_ms", LvJSON::Int);
+            if (polling["min_interval_ms"].GetInt() <= 0 ||
+                    polling["max_interval_ms"].GetInt() < polling["min_interval_ms"].GetInt()) {
+                throw std::string("Property \"max_interval_ms\" must not be less than \"min_interval_ms\"");
+            }
+            if (polling["max_interval_ms"].GetInt() > POLLING_MAX_INTERVAL_LIMIT_MS) {
+                throw std::string("Property \"max_interval_ms\" must be at most " + std::to_string(POLLING_MAX_INTERVAL_LIMIT_MS));
+            }
+        }
+
+        // Validate journal, optional
+        if (doc.HasMember("journal")) {
+            LvJSON::checkType(doc, "journal", LvJSON::Object);
+            const LvJSON::Value& journal = doc["journal"];
+            LvJSON::checkType(journal, "file", LvJSON::String);
+            LvJSON::checkType(journal, "capacity", LvJSON::Int);
+            LvJSON::checkType(journal, "flush_interval_ms", LvJSON::Int);
+            if (journal["capacity"].GetInt() <= 0) {
+                throw std::string("Property \"capacity\" must be positive");
+            }
+        }
+
+        // Validate state, optional
+        if (doc.HasMember("state")) {
+            LvJSON::checkType(doc, "state", LvJSON::Object);
+            const LvJSON::Value& state = doc["state"];
+            LvJSON::checkType(state, "file", LvJSON::String);
+            LvJSON::checkType(state, "flush_interval_ms", LvJSON::Int);
+        }
+
+        // Validate trace, optional
+        if (doc.HasMember("trace")) {
+            LvJSON::checkType(doc, "trace", LvJSON::Object);
+            const LvJSON::Value& trace = doc["trace"];
+            LvJSON::checkType(trace, "enabled", LvJSON::Bool);
+            LvJSON::checkType(trace, "file", LvJSON::String);
+            LvJSON::checkType(trace, "ring_events", LvJSON::Int);
+            if (trace["ring_events"].GetInt() < 1) {
+                throw std::string("Property \"ring_events\" must be positive");
+            }
+        }
+
+        // Validate capture, optional
+        if (doc.HasMember("capture")) {
+            LvJSON::checkType(doc, "capture", LvJSON::Object);
+            const LvJSON::Value& capture = doc["capture"];
+            LvJSON::checkType(capture, "mode", LvJSON::String);
+            LvJSON::checkType(capture, "file", LvJSON::String);
+            LvJSON::checkType(capture, "speed", LvJSON::Double);
+            std::string mode = capture["mode"].GetString();
+            if (mode != "off" && mode != "record" && mode != "replay") {
+                throw std::string("Property \"mode\" must be \"off\", \"record\" or \"replay\"");
+            }
+            if (capture["speed"].GetDouble() < 0) {
+                throw std::string("Property \"speed\" must not be negative");
+            }
+        }
+
+        // Validate dashboard, optional
+        if (doc.HasMember("dashboard")) {
+            LvJSON::checkType(doc, "dashboard", LvJSON::Object);
+            LvJSON::checkType(doc["dashboard"], "root_dir", LvJSON::String);
+        }
     } catch (const std::string& err) {
         std::cerr << "Validation error: " << err << std::endl;
         return false;
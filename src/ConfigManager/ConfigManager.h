@@ -2,6 +2,7 @@
 #define CONFIG_MANAGER_H
 
 #include "LvJSON.h"
+#include "LvLog.h"
 #include <string>
 #include <vector>
 #include <map>
@@ -9,6 +10,9 @@
 #include <iostream>
 #include <regex>
 
+#define UPLINK_MIN_BUFFER_SIZE 65536 // bytes, smallest uplink ring
+#define POLLING_MAX_INTERVAL_LIMIT_MS 750 // a vehicle stays at least ~800 ms on a detect loop, a slower poll misses it
+
 class ConfigManager {
 public:
     // Nested structures for various configurations
@@ -29,6 +33,7 @@ public:
         std::string ip_address;
         int status_gpio_type;
         int status_gpio_pin;
+        int phase = 0; // AC phase the camera approach waits on, 0 when not set
         std::vector<Demand> demands;
     };
 
@@ -43,6 +48,48 @@ public:
         int gpio_pin;
     };
 
+    struct UplinkConfig {
+        bool enabled = false;
+        std::string url;
+        std::string client_id;
+        std::vector<std::string> topics;
+        std::string buffer_file;
+        int buffer_size = 0;
+        int replay_rate = 0;
+    };
+
+    struct PollingConfig {
+        int min_interval_ms = 500;
+        int max_interval_ms = 750;
+    };
+
+    struct JournalConfig {
+        std::string file = "events.journal";
+        int capacity = 65536; // records
+        int flush_interval_ms = 5000;
+    };
+
+    struct StateConfig {
+        std::string file = "iotbox.state";
+        int flush_interval_ms = 1000;
+    };
+
+    struct TraceConfig {
+        bool enabled = false;
+        std::string file = "trace.json"; // written on SIGUSR1
+        int ring_events = 8192; // per thread
+    };
+
+    struct CaptureConfig {
+        std::string mode = "off"; // "off", "record" or "replay" the camera polls
+        std::string file = "camera.capture";
+        double speed = 1.0; // replay, 1 the original timing, 2 twice faster, 0 the next answer at every poll
+    };
+
+    struct DashboardConfig {
+        std::string root_dir = "interface/public"; // static files of the dashboard, relative to the working directory
+    };
+
     // Constructor and Destructor
     explicit ConfigManager(const std::string& configFile);
     ~ConfigManager();
@@ -62,6 +109,16 @@ public:
     AC_in_config getACConfig(int phase) const;
     const std::vector<DC_in_config>& getDCConfigs() const;
     DC_in_config getDCConfig(int push_button) const;
+    const UplinkConfig& getUplinkConfig() const;
+    const PollingConfig& getPollingConfig() const;
+    const JournalConfig& getJournalConfig() const;
+    const StateConfig& getStateConfig() const;
+    const TraceConfig& getTraceConfig() const;
+    const CaptureConfig& getCaptureConfig() const;
+    const DashboardConfig& getDashboardConfig() const;
+
+    // Method to check the types and ranges of a parsed config, prints the first error, no state so the bench times it alone
+    static bool validateConfig(const LvJSON& doc);
 
 private:
     // Private member variables
@@ -70,10 +127,16 @@ private:
     std::vector<CameraConfig> cameraConfigs;
     std::vector<AC_in_config> acConfigs;
     std::vector<DC_in_config> dcConfigs;
+    UplinkConfig uplinkConfig;
+    PollingConfig pollingConfig;
+    JournalConfig journalConfig;
+    StateConfig stateConfig;
+    TraceConfig traceConfig;
+    CaptureConfig captureConfig;
+    DashboardConfig dashboardConfig;
 
     // Private methods
     bool loadConfig();
-    bool validateConfig(const LvJSON& doc);
     bool isValidIPAddress(const std::string& ip);
     void createDefaultConfig(const std::string& filepath = "");
 };
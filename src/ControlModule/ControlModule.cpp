@@ -1,55 +1,156 @@
 #include "ControlModule.h"
 
-ControlModule::ControlModule(const std::string& i2cDevice, int mcpAddress1, int mcpAddress2, const ConfigManager& configManager)
-    : mcpAddress1(mcpAddress1), mcpAddress2(mcpAddress2), configManager(configManager), cacheExpireDuration(250), cachedPortAValue(0x00), cachedPortBValue(0x00), lastCacheUpdateTime(0) {
-    
+ControlModule::ControlModule(const std::string& i2cDevice, int mcpAddress1, int mcpAddress2, const ConfigManager& configManager, StateStore& stateStore,
+                             const HardwareOps* hardwareOps)
+    : mcpAddress1(mcpAddress1), mcpAddress2(mcpAddress2), configManager(configManager), stateStore(stateStore),
+      i2cTransactions(LvMetrics::instance().counter("iotbox_i2c_transactions_total", "Transfers to the IO expanders")),
+      gpioErrors(LvMetrics::instance().counter("iotbox_gpio_errors_total", "Failed on-board GPIO reads and writes")),
+      cacheExpireDuration(250), cachedPortAValue(0x00), cachedPortBValue(0x00), lastCacheUpdateTime(0) {
+    if (hardwareOps != NULL) {
+        hardware = *hardwareOps;
+    } else {
+        hardware = {&ControlModule::systemOpen, &ControlModule::systemIoctl, &ControlModule::systemClose, NULL};
+    }
+
     // Open the I2C device file
-    i2cFile = open(i2cDevice.c_str(), O_RDWR);
+    i2cFile = deviceOpen(i2cDevice.c_str(), O_RDWR);
     if (i2cFile < 0) {
         perror("Failed to open I2C device");
         exit(1);
     }
 
-    // MCP23017 Initialization, note that GPA7 and GPB7 cannot be used as input, so this part needs to be modified later
-    // set all pins of port A as input except for GPA7
-    setPortDirection(i2cFile, 'A', 0b11111111, mcpAddress1);
-    // set all pins of port B as output except for GPB0
-    setPortDirection(i2cFile, 'B', 0b00000000, mcpAddress1);
-    // Initialization to set all GPIO pins related to demands to LOW
-    portValue = 0b00000000;
-    writePort('A', portValue, mcpAddress1);
-    writePort('B', portValue, mcpAddress1);
+    // Only the outputs of the demands still handled come back after a restart,
+    // a forced or command output was held by a client that has to ask again
+    unsigned char handledOutputs[2] = {0b00000000, 0b00000000};
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        for (const auto& demand : camConfig.demands) {
+            StateStore::DemandState demandState;
+            if (stateStore.loadDemand(camConfig.ip_address, demand.detect_loop, demandState) && demandState.isHandled) {
+                handledOutputs[expanderIndex(demand.gpio_type)] |= (1 << demand.gpio_pin);
+            }
+        }
+    }
+
+    for (int expander = 0; expander < 2; expander++) {
+        int address = expanderAddress(expander);
+        // MCP23017 Initialization, note that GPA7 and GPB7 cannot be used as input, so this part needs to be modified later
+        // set all pins of port A as input except for GPA7
+        setPortDirection(i2cFile, 'A', 0b11111111, address);
+        // set all pins of port B as output except for GPB0
+        setPortDirection(i2cFile, 'B', 0b00000000, address);
+        // Initialization to set all GPIO pins related to demands to LOW, or back to the saved outputs after a restart
+        portValues[expander] = 0b00000000;
+        if (stateStore.loadOutputs(expander, portValues[expander])) {
+            portValues[expander] &= handledOutputs[expander];
+            std::cout << "Restored outputs of 0x" << std::hex << address << std::dec << ": " << std::bitset<8>(portValues[expander]) << std::endl;
+        }
+        writePort('A', portValues[expander], address);
+        writePort('B', portValues[expander], address);
+    }
     std::cout << "Control Module Initialized." << std::endl;
 }
 
 ControlModule::~ControlModule() {
-    close(i2cFile);
+    deviceClose(i2cFile);
+}
+
+// Default hardware ops, the real devices
+int ControlModule::systemOpen(void* /*self*/, const char* path, int flags) {
+    return open(path, flags);
+}
+
+int ControlModule::systemIoctl(void* /*self*/, int fd, unsigned long request, void* arg) {
+    return ioctl(fd, request, arg);
+}
+
+int ControlModule::systemClose(void* /*self*/, int fd) {
+    return close(fd);
+}
+
+int ControlModule::deviceOpen(const char* path, int flags) {
+    return hardware.open(hardware.self, path, flags);
+}
+
+int ControlModule::deviceIoctl(int fd, unsigned long request, void* arg) {
+    return hardware.ioctl(hardware.self, fd, request, arg);
+}
+
+int ControlModule::deviceClose(int fd) {
+    return hardware.close(hardware.self, fd);
 }
 
 //handle demand method
 void ControlModule::handleDemand(int demandId, int frameCount, int gpioType, int gpioPin) {
-    std::cout << "Handling demand: " << demandId << " with frame count: " << frameCount << std::endl;
-    //set the bit of portValue based on the gpioPin, while keeping the other bits the same
-    portValue |= (1 << gpioPin);
-    //write the portValue to the MCP23017
-    writePort('B', portValue, (gpioType == I2C_MCP23017_0x20) ? mcpAddress1 : mcpAddress2);
+    LV_TRACE_SCOPE("control.handleDemand");
+    LV_PROBE3(handle_demand, demandId, frameCount, gpioPin);
+    std::lock_guard<std::mutex> lock(controlMtx);
+    LV_LOG_INFO("Handling demand: {} with frame count: {}", demandId, frameCount);
+    //set the bit of the expander port value based on the gpioPin, while keeping the other bits the same
+    int expander = expanderIndex(gpioType);
+    portValues[expander] |= (1 << gpioPin);
+    //write the port value to the MCP23017
+    writeOutputs(expander);
     
-    std::cout << "Written to port: " << portValue << std::endl;
-    std::cout << "Demand handled." << std::endl;
+    LV_LOG_DEBUG("Written to port: {}", portValues[expander]);
+    LV_LOG_DEBUG("Demand handled.");
     return;
 }
 
 //reset demand method
-void ControlModule::resetDemand(int demandId) {
+void ControlModule::resetDemand(int demandId, int gpioType, int gpioPin) {
+    LV_PROBE1(reset_demand, demandId);
+    std::lock_guard<std::mutex> lock(controlMtx);
     // Clear the demand, set the bit to low
-    portValue &= ~(1 << demandId-1);
-    // Write the portValue to the MCP23017
-    writePort('B', portValue, mcpAddress1);
-    std::cout << "Demand: " << demandId << " reset." << std::endl;
+    int expander = expanderIndex(gpioType);
+    portValues[expander] &= ~(1 << gpioPin);
+    // Write the port value to the MCP23017
+    writeOutputs(expander);
+    LV_LOG_INFO("Demand: {} reset.", demandId);
+}
+
+//set output method, drive a single output pin of port B high or low
+void ControlModule::setOutput(int gpioType, int gpioPin, bool value) {
+    std::lock_guard<std::mutex> lock(controlMtx);
+    int expander = expanderIndex(gpioType);
+    if (value) {
+        portValues[expander] |= (1 << gpioPin);
+    } else {
+        portValues[expander] &= ~(1 << gpioPin);
+    }
+    writeOutputs(expander);
+    LV_LOG_INFO("Output: {} set to {}", gpioPin, value);
+}
+
+//reinitialize method, restore the port directions and rewrite the current outputs, e.g. after the expander lost power
+void ControlModule::reinitialize() {
+    std::lock_guard<std::mutex> lock(controlMtx);
+    for (int expander = 0; expander < 2; expander++) {
+        setPortDirection(i2cFile, 'A', 0b11111111, expanderAddress(expander));
+        setPortDirection(i2cFile, 'B', 0b00000000, expanderAddress(expander));
+        writePort('B', portValues[expander], expanderAddress(expander));
+    }
+    lastCacheUpdateTime = 0; // force the inputs to be read again
+    LV_LOG_INFO("Control Module reinitialized.");
+}
+
+// Method to map a demand gpio type to its expander, 0x20 is the first one and any other type the second
+int ControlModule::expanderIndex(int gpioType) {
+    return (gpioType == I2C_MCP23017_0x20) ? 0 : 1;
+}
+
+int ControlModule::expanderAddress(int expander) const {
+    return (expander == 0) ? mcpAddress1 : mcpAddress2;
+}
+
+// Method to write the output shadow of an expander to its port B and keep it, caller holds controlMtx
+void ControlModule::writeOutputs(int expander) {
+    writePort('B', portValues[expander], expanderAddress(expander));
+    stateStore.saveOutputs(expander, portValues[expander]);
 }
 
 //handle heartbeat method
 void ControlModule::handleHeartbeat(const std::string& ip, bool isAlive) {
+    std::lock_guard<std::mutex> lock(controlMtx);
     // Get the heartbeat GPIO config from the config manager based on the IP
     auto gpioConfig = configManager.getStatusGpioConfig(ip);
 
@@ -75,21 +176,20 @@ void ControlModule::handleHeartbeat(const std::string& ip, bool isAlive) {
             line_offset = 7;
             break;
         default:
-            std::cerr << "Invalid GPIO pin for heartbeat in config" << std::endl;
+            LV_LOG_ERROR("Invalid GPIO pin for heartbeat in config");
             return;
     }
 
     // Write the corresponding GPIO value (HIGH = alive, LOW = dead)
     writeGPIO(gpiochip, line_offset, isAlive ? 0 : 1); // Inverted logic, HIGH = 0, LOW = 1, active low circuit
 
-    std::cout << "Heartbeat status updated for camera " << ip << ": " 
-              << (isAlive ? "Alive (HIGH)" : "Dead (LOW)") << std::endl;
+    LV_LOG_INFO("Heartbeat status updated for camera {}: {}", ip, (isAlive ? "Alive (HIGH)" : "Dead (LOW)"));
 }
 
 //method to refresh cached port values from the MCP23017 if the cache has expired
 void ControlModule::refreshPortValues() {
     // Get the current time in milliseconds
-    unsigned long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    unsigned long long now = LvClock::nowMs();
     // Check if the cache has expired
     if (now - lastCacheUpdateTime > cacheExpireDuration) {
         // Read the port values from the MCP23017
@@ -102,22 +202,26 @@ void ControlModule::refreshPortValues() {
 
 // Method to read AC status from port A of MCP23017, take the pin as input and return the status
 bool ControlModule::readACStatus(int pin) {
+    std::lock_guard<std::mutex> lock(controlMtx);
     refreshPortValues();
     return (cachedPortAValue >> pin) & 1; // Return the status of the pin as a boolean, 1 = HIGH, 0 = LOW
 }
 
 // Method to read DC status from port A of MCP23017, take the pin as input and return the status
 bool ControlModule::readDCStatus(int pin) {
+    std::lock_guard<std::mutex> lock(controlMtx);
     refreshPortValues();
     return (cachedPortAValue >> pin) & 1; // Return the status of the pin as a boolean, 1 = HIGH, 0 = LOW
 }
 
 // Method to write to an onboard GPIO pin (combined setup and write)
 void ControlModule::writeGPIO(const char* gpiochip, int line_offset, int value) {
+    LV_TRACE_SCOPE("gpio.write");
     //open the GPIO device file
-    gpioFile = open(gpiochip, O_WRONLY);
+    gpioFile = deviceOpen(gpiochip, O_WRONLY);
     if (gpioFile < 0) {
         perror("Failed to open GPIO device");
+        gpioErrors.inc();
         return;
     }
 
@@ -129,22 +233,24 @@ void ControlModule::writeGPIO(const char* gpiochip, int line_offset, int value)
     gpioRequestOutput.lineoffsets[0] = line_offset;
     gpioRequestOutput.default_values[0] = 0;  // Initial value LOW
 
-    if (ioctl(gpioFile, GPIO_GET_LINEHANDLE_IOCTL, &gpioRequestOutput) < 0) {
+    if (deviceIoctl(gpioFile, GPIO_GET_LINEHANDLE_IOCTL, &gpioRequestOutput) < 0) {
         perror("Failed to set GPIO as output");
+        gpioErrors.inc();
         return;
     }
 
     // Set the GPIO pin to the desired value (high or low)
     gpioDataOutput.values[0] = value;
-    if (ioctl(gpioRequestOutput.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &gpioDataOutput) < 0) {
+    if (deviceIoctl(gpioRequestOutput.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &gpioDataOutput) < 0) {
         perror("Error setting GPIO value");
+        gpioErrors.inc();
     } else {
-        printf("GPIO set to %d on line %d\n", value, line_offset);
+        LV_LOG_DEBUG("GPIO set to {} on line {}", value, line_offset);
     }
 
     // Clean up
-    close(gpioRequestOutput.fd);  // Close the handle
-    close(gpioFile);  // Close the GPIO device file
+    deviceClose(gpioRequestOutput.fd);  // Close the handle
+    deviceClose(gpioFile);  // Close the GPIO device file
 
     return;
 }
@@ -152,9 +258,10 @@ void ControlModule::writeGPIO(const char* gpiochip, int line_offset, int value)
 // Method to read from an onboard GPIO pin (combined setup and read)
 bool ControlModule::readGPIO(const char* gpiochip, int line_offset) {
     // Open the GPIO device file
-    gpioFile = open(gpiochip, O_RDONLY);
+    gpioFile = deviceOpen(gpiochip, O_RDONLY);
     if (gpioFile < 0) {
         perror("Failed to open GPIO device");
+        gpioErrors.inc();
         return false;
     }
 
@@ -164,23 +271,25 @@ bool ControlModule::readGPIO(const char* gpiochip, int line_offset) {
     gpioRequestInput.lineoffsets[0] = line_offset;
     strcpy(gpioRequestInput.consumer_label, "control_gpio_input");
 
-    if (ioctl(gpioFile, GPIO_GET_LINEHANDLE_IOCTL, &gpioRequestInput) < 0) {
+    if (deviceIoctl(gpioFile, GPIO_GET_LINEHANDLE_IOCTL, &gpioRequestInput) < 0) {
         perror("Failed to set GPIO as input");
+        gpioErrors.inc();
         return false;
     }
 
     // Read the GPIO value
-    if (ioctl(gpioRequestInput.fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &gpioDataInput) < 0) {
+    if (deviceIoctl(gpioRequestInput.fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &gpioDataInput) < 0) {
         perror("Error reading GPIO input");
-        close(gpioRequestInput.fd);
+        gpioErrors.inc();
+        deviceClose(gpioRequestInput.fd);
         return false;
     }
 
     bool value = gpioDataInput.values[0];  // Get the GPIO value
 
     // Clean up
-    close(gpioRequestInput.fd);  // Close the handle
-    close(gpioFile);  // Close the GPIO device file
+    deviceClose(gpioRequestInput.fd);  // Close the handle
+    deviceClose(gpioFile);  // Close the GPIO device file
 
     return value;
 }
@@ -202,7 +311,8 @@ void ControlModule::setPortDirection(int fd, unsigned char port, unsigned char d
     data.msgs = &msg;
     data.nmsgs = 1;
 
-    if (ioctl(fd, I2C_RDWR, &data) < 0) {
+    i2cTransactions.inc();
+    if (deviceIoctl(fd, I2C_RDWR, &data) < 0) {
         perror("ioctl error");
         exit(1);
     }
@@ -210,6 +320,7 @@ void ControlModule::setPortDirection(int fd, unsigned char port, unsigned char d
 
 // Method to write to a port (A or B) on the MCP23017
 void ControlModule::writePort(unsigned char port, unsigned char value, unsigned char address) {
+    LV_TRACE_SCOPE("i2c.writePort");
     struct i2c_msg msg;
     struct i2c_rdwr_ioctl_data data;
     unsigned char buf[2];
@@ -217,7 +328,7 @@ void ControlModule::writePort(unsigned char port, unsigned char value, unsigned
     buf[0] = (port == 'A') ? GPIOA_REG : GPIOB_REG;
     buf[1] = value;
 
-    std::cout << "Writing to port: " << port << ", Value: " << std::bitset<8>(value) << ", Address: " << std::hex << static_cast<int>(address) << std::endl;
+    LV_LOG_DEBUG("Writing to port: {}, Value: {}, Address: {}", (char)port, std::bitset<8>(value).to_string(), LvLog::Hex(static_cast<int>(address)));
     
     msg.addr = address;
     msg.flags = 0;
@@ -227,7 +338,11 @@ void ControlModule::writePort(unsigned char port, unsigned char value, unsigned
     data.msgs = &msg;
     data.nmsgs = 1;
 
-    if (ioctl(i2cFile, I2C_RDWR, &data) < 0) {
+    i2cTransactions.inc();
+    LV_PROBE3(i2c_write_start, port, value, address);
+    int rc = deviceIoctl(i2cFile, I2C_RDWR, &data);
+    LV_PROBE2(i2c_write_done, port, rc);
+    if (rc < 0) {
         perror("ioctl error");
         exit(1);
     }
@@ -235,6 +350,7 @@ void ControlModule::writePort(unsigned char port, unsigned char value, unsigned
 
 // Method to read from a port (A or B) on the MCP23017
 unsigned char ControlModule::readPort(unsigned char port, unsigned char address) {
+    LV_TRACE_SCOPE("i2c.readPort");
     struct i2c_msg msgs[2];
     struct i2c_rdwr_ioctl_data data;
     unsigned char buf[1];
@@ -255,7 +371,11 @@ unsigned char ControlModule::readPort(unsigned char port, unsigned char address)
     data.msgs = msgs;
     data.nmsgs = 2;
 
-    if (ioctl(i2cFile, I2C_RDWR, &data) < 0) {
+    i2cTransactions.inc();
+    LV_PROBE2(i2c_read_start, port, address);
+    int rc = deviceIoctl(i2cFile, I2C_RDWR, &data);
+    LV_PROBE3(i2c_read_done, port, read_buf[0], rc);
+    if (rc < 0) {
         perror("ioctl error");
         exit(1);
     }
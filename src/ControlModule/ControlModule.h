@@ -6,6 +6,12 @@
 #include <linux/gpio.h>
 #include <linux/i2c-dev.h>
 #include "ConfigManager.h"
+#include "StateStore.h"
+#include "LvLog.h"
+#include "LvMetrics.h"
+#include "LvTrace.h"
+#include "LvProbe.h"
+#include "LvClock.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -14,6 +20,7 @@
 #include <bitset>
 #include <chrono>
 #include <map>
+#include <mutex>
 #include <cstring> // std::strcpy
 #include <cerrno> // errno
 #include <cstdio> // perror
@@ -42,38 +49,64 @@ struct i2c_msg {
 
 class ControlModule {
 public:
-    ControlModule(const std::string& i2cDevice, int mcpAddress1, int mcpAddress2, const ConfigManager& configManager);
+    // Raw device access, the system calls unless a simulation gives its own expanders and GPIO chips
+    struct HardwareOps {
+        int (*open)(void* self, const char* path, int flags);
+        int (*ioctl)(void* self, int fd, unsigned long request, void* arg);
+        int (*close)(void* self, int fd);
+        void* self;
+    };
+
+    ControlModule(const std::string& i2cDevice, int mcpAddress1, int mcpAddress2, const ConfigManager& configManager, StateStore& stateStore,
+                  const HardwareOps* hardwareOps = NULL);
     ~ControlModule();
 
     void handleDemand(int demandId, int frameCount, int gpioType, int gpioPin);
-    void resetDemand(int demandId);
+    void resetDemand(int demandId, int gpioType, int gpioPin);
     void handleHeartbeat(const std::string& ip, bool isAlive);
+    void setOutput(int gpioType, int gpioPin, bool value);
+    void reinitialize();
     bool readACStatus(int pin);
     bool readDCStatus(int pin);
     const ConfigManager &getConfigManager() const { return configManager; }
 
 private:
+    HardwareOps hardware;
     int i2cFile;
     int gpioFile;
     int mcpAddress1;
     int mcpAddress2;
     ConfigManager configManager;
+    StateStore& stateStore; // keeps portValues so a restart drives the same outputs
+    LvMetrics::Counter& i2cTransactions;
+    LvMetrics::Counter& gpioErrors;
+    std::mutex controlMtx; // the public methods can be called from the main and the MQTT broker thread
 	
     struct gpiohandle_request gpioRequestInput;
     struct gpiohandle_request gpioRequestOutput;
     struct gpiohandle_data gpioDataInput;
     struct gpiohandle_data gpioDataOutput;
 
-    unsigned char portValue;
+    unsigned char portValues[2]; // port B output shadow of each expander, indexed by expanderIndex()
     unsigned char cachedPortAValue;
     unsigned char cachedPortBValue;
 
     unsigned long long lastCacheUpdateTime;
     unsigned long cacheExpireDuration;
 
+    static int systemOpen(void* self, const char* path, int flags);
+    static int systemIoctl(void* self, int fd, unsigned long request, void* arg);
+    static int systemClose(void* self, int fd);
+    int deviceOpen(const char* path, int flags);
+    int deviceIoctl(int fd, unsigned long request, void* arg);
+    int deviceClose(int fd);
+
     void writeGPIO(const char* gpiochip, int line_offset, int value);
     bool readGPIO(const char* gpiochip, int line_offset);
 
+    static int expanderIndex(int gpioType);
+    int expanderAddress(int expander) const;
+    void writeOutputs(int expander);
     void refreshPortValues();
     void setPortDirection(int fd, unsigned char port, unsigned char direction, unsigned char address);
     void writePort(unsigned char port, unsigned char value, unsigned char address);
@@ -0,0 +1,144 @@
+#include "CountHistory.h"
+
+//Constructor
+CountHistory::CountHistory(const ConfigManager& configManager) {
+    // Every series is allocated here, the buckets once per series, so the memory follows the config
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        for (const auto& demand : camConfig.demands) {
+            if (demand.count_loop == 0 || findSeries(camConfig.ip_address, demand.count_loop) != NULL) {
+                continue;
+            }
+            series.emplace_back();
+            series.back().ip = camConfig.ip_address;
+            series.back().loop = demand.count_loop;
+        }
+    }
+}
+
+// Method to record the counts of one loop from a poll
+void CountHistory::record(const std::string& ip, int loop, uint64_t time_ms, int frameCount, const std::vector<int>& inboundCounts) {
+    std::lock_guard<std::mutex> lock(historyMtx);
+    Series* s = findSeries(ip, loop);
+    if (s == NULL) {
+        if (!missingLogged) {
+            missingLogged = true;
+            LV_LOG_WARN("Count history has no series for camera {} loop {}, not recorded", ip, loop);
+        }
+        return;
+    }
+
+    int64_t values[1 + MaxInbound] = {frameCount};
+    for (size_t i = 0; i < inboundCounts.size() && i < MaxInbound; i++) {
+        values[1 + i] = inboundCounts[i];
+    }
+    s->raw.append(time_ms, values);
+
+    // The counter only goes up, a smaller value means the camera restarted its count
+    uint32_t vehicles = 0;
+    int count = inboundCounts.empty() ? 0 : inboundCounts[0];
+    if (s->hasLastCount) {
+        vehicles = count >= s->lastCount ? count - s->lastCount : count;
+    }
+    s->hasLastCount = true;
+    s->lastCount = count;
+
+    addToBucket(s->minuteBuckets, MinuteMs, time_ms, vehicles, frameCount);
+    addToBucket(s->quarterBuckets, QuarterMs, time_ms, vehicles, frameCount);
+}
+
+// Method to get the history as JSON
+// raw: {"ip","loop","samples":[{"time","frame_count","accumulate_count":[..]}]}
+// 1m/15m: {"ip","loop","bucket_ms","buckets":[{"start","vehicles","samples","max_frame_count"}]}
+std::string CountHistory::toJSON(const std::string& ip, int loop, const std::string& resolution, uint64_t since_ms) {
+    std::lock_guard<std::mutex> lock(historyMtx);
+    Series* s = findSeries(ip, loop);
+    if (s == NULL) {
+        throw std::string("No history for camera " + ip + " loop " + std::to_string(loop));
+    }
+
+    LvJSON doc;
+    auto& allocator = doc.GetAllocator();
+    doc.SetObject();
+    rapidjson::Value ipValue;
+    ipValue.SetString(ip.c_str(), allocator);
+    doc.AddMember("ip", ipValue, allocator);
+    doc.AddMember("loop", loop, allocator);
+
+    if (resolution == "raw") {
+        LvJSON::Value samples(rapidjson::kArrayType);
+        for (const auto& sample : s->raw.read(since_ms)) {
+            LvJSON::Value sampleObj(rapidjson::kObjectType);
+            sampleObj.AddMember("time", (uint64_t)sample.timeMs, allocator);
+            sampleObj.AddMember("frame_count", (int64_t)sample.values[0], allocator);
+            LvJSON::Value counts(rapidjson::kArrayType);
+            for (int i = 0; i < MaxInbound; i++) {
+                counts.PushBack((int64_t)sample.values[1 + i], allocator);
+            }
+            sampleObj.AddMember("accumulate_count", counts, allocator);
+            samples.PushBack(sampleObj, allocator);
+        }
+        doc.AddMember("samples", samples, allocator);
+        return doc.stringify();
+    }
+
+    const std::vector<Bucket>* buckets;
+    uint64_t bucketMs;
+    if (resolution == "1m") {
+        buckets = &s->minuteBuckets;
+        bucketMs = MinuteMs;
+    } else if (resolution == "15m") {
+        buckets = &s->quarterBuckets;
+        bucketMs = QuarterMs;
+    } else {
+        throw std::string("Resolution must be raw, 1m or 15m");
+    }
+
+    // The ring is indexed by time, start from the slot after the newest bucket to list them oldest first
+    size_t newest = 0;
+    for (size_t i = 0; i < buckets->size(); i++) {
+        if ((*buckets)[i].startMs > (*buckets)[newest].startMs) {
+            newest = i;
+        }
+    }
+    LvJSON::Value bucketArray(rapidjson::kArrayType);
+    for (size_t k = 1; k <= buckets->size(); k++) {
+        const Bucket& bucket = (*buckets)[(newest + k) % buckets->size()];
+        if (bucket.samples == 0 || bucket.startMs + bucketMs <= since_ms) {
+            continue;
+        }
+        LvJSON::Value bucketObj(rapidjson::kObjectType);
+        bucketObj.AddMember("start", (uint64_t)bucket.startMs, allocator);
+        bucketObj.AddMember("vehicles", bucket.vehicles, allocator);
+        bucketObj.AddMember("samples", bucket.samples, allocator);
+        bucketObj.AddMember("max_frame_count", bucket.maxFrameCount, allocator);
+        bucketArray.PushBack(bucketObj, allocator);
+    }
+    doc.AddMember("bucket_ms", (uint64_t)bucketMs, allocator);
+    doc.AddMember("buckets", bucketArray, allocator);
+    return doc.stringify();
+}
+
+// Method to find the series of a camera loop
+CountHistory::Series* CountHistory::findSeries(const std::string& ip, int loop) {
+    for (auto& s : series) {
+        if (s.ip == ip && s.loop == loop) {
+            return &s;
+        }
+    }
+    return NULL;
+}
+
+// Method to add a sample to the bucket of its time, a bucket left from the previous round of the ring is cleared
+void CountHistory::addToBucket(std::vector<Bucket>& buckets, uint64_t bucketMs, uint64_t time_ms, uint32_t vehicles, int frameCount) {
+    uint64_t startMs = time_ms - time_ms % bucketMs;
+    Bucket& bucket = buckets[(time_ms / bucketMs) % buckets.size()];
+    if (bucket.startMs != startMs) {
+        bucket = Bucket();
+        bucket.startMs = startMs;
+    }
+    bucket.vehicles += vehicles;
+    bucket.samples++;
+    if (frameCount > bucket.maxFrameCount) {
+        bucket.maxFrameCount = frameCount;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef COUNT_HISTORY_H
+#define COUNT_HISTORY_H
+
+#include "ConfigManager.h"
+#include "LvDeltaSeries.h"
+#include "LvJSON.h"
+#include "LvLog.h"
+#include <string>
+#include <vector>
+#include <mutex>
+
+// Vehicle count history kept in fixed memory, one series per camera and configured count loop.
+// Every poll is stored compressed (frame_count and the accumulate_count of each inbound),
+// and rolled up to 1 minute buckets for a day and 15 minute buckets for a week.
+class CountHistory {
+public:
+    CountHistory(const ConfigManager& configManager);
+
+    // Method to record the counts of one count loop from a poll, safe to call at any thread
+    // a loop without a series is not recorded and logged once
+    void record(const std::string& ip, int loop, uint64_t time_ms, int frameCount, const std::vector<int>& inboundCounts);
+
+    // Method to get the history as JSON, resolution is "raw", "1m" or "15m", throws std::string when not found
+    std::string toJSON(const std::string& ip, int loop, const std::string& resolution, uint64_t since_ms);
+
+private:
+    static const int MaxInbound = 4; // accumulate_count entries kept per sample
+    static const uint64_t MinuteMs = 60000;
+    static const uint64_t QuarterMs = 900000;
+
+    struct Bucket {
+        uint64_t startMs = 0;
+        uint32_t vehicles = 0; // increase of accumulate_count[0] within the bucket
+        uint32_t samples = 0;
+        int maxFrameCount = 0;
+    };
+
+    struct Series {
+        std::string ip;
+        int loop;
+        LvDeltaSeries raw{1 + MaxInbound};
+        bool hasLastCount = false;
+        int lastCount = 0;
+        std::vector<Bucket> minuteBuckets = std::vector<Bucket>(24 * 60);
+        std::vector<Bucket> quarterBuckets = std::vector<Bucket>(7 * 24 * 4);
+    };
+
+    std::vector<Series> series; // created from the config, never resized
+    bool missingLogged = false;
+    std::mutex historyMtx; // recorded by the camera loop and the pushed counts, read by the dashboard
+
+    Series* findSeries(const std::string& ip, int loop);
+    static void addToBucket(std::vector<Bucket>& buckets, uint64_t bucketMs, uint64_t time_ms, uint32_t vehicles, int frameCount);
+};
+
+#endif // COUNT_HISTORY_H
@@ -1,15 +1,18 @@
 #include "DCinput.h"
 
 // Constructor
-DCInput::DCInput(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule) 
-    : configManager(configManager), controlModule(controlModule), commModule(commModule) {
+DCInput::DCInput(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, EventJournal& eventJournal) 
+    : configManager(configManager), controlModule(controlModule), commModule(commModule), eventJournal(eventJournal) {
     // Initialize the DCStatus vector
     for (const auto& dcConfig : configManager.getDCConfigs()) {
         DCStatus dc;
         dc.push_button = dcConfig.push_button;
         dc.isPressed = false;
+        dc.wasPressed = false;
         dcStatus.push_back(dc);
     }
+
+    commModule.addStateTopic("DC_status");
 }
 
 // Method to check the DC status
@@ -31,6 +34,11 @@ void DCInput::checkDCStatus(const ConfigManager::DC_in_config& dcConfig) {
                 dc.isPressed = true;
             }
 
+            if (dc.isPressed != dc.wasPressed) {
+                eventJournal.record(EventJournal::SourceButton, dc.push_button, dc.isPressed);
+                dc.wasPressed = dc.isPressed;
+            }
+
             return; // Push button found and processed, exit the loop
         }
     }
@@ -4,6 +4,7 @@
 #include "ConfigManager.h"
 #include "ControlModule.h"
 #include "CommModule.h"
+#include "EventJournal.h"
 #include "LvJSON.h"
 #include <iostream>
 #include <vector>
@@ -11,24 +12,27 @@
 
 class DCInput{
 public:
-    DCInput(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule);
+    DCInput(const ConfigManager& configManager, ControlModule& controlModule, CommModule& commModule, EventJournal& eventJournal);
     void loop(uint64_t now_ms);
     void checkDCStatus(const ConfigManager::DC_in_config& dcConfig); 
+    // Method to build the DC_status JSON, public for the benchmarks
+    std::string generateJSON();
 
 private:
     const ConfigManager& configManager;
     ControlModule& controlModule;
     CommModule& commModule;
+    EventJournal& eventJournal;
 
     struct DCStatus{
         int push_button;
         bool isPressed;
+        bool wasPressed; // kept across the reset, a change goes to the journal
     };
 
     std::vector<DCStatus> dcStatus;
 
     void resetDCStatus();
-    std::string generateJSON();
 };
 
 #endif // DC_INPUT_H
\ No newline at end of file
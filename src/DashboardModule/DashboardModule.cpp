@@ -0,0 +1,170 @@
+#include "DashboardModule.h"
+
+//Constructor
+DashboardModule::DashboardModule(CommModule& commModule, CountHistory& countHistory, EventJournal& eventJournal, LatencyTracker& latencyTracker, const std::string& address, const std::string& rootDir)
+    : countHistory(countHistory), eventJournal(eventJournal), latencyTracker(latencyTracker), restfulServer(address.c_str()) {
+    // Order matters, the first matching uri is used
+    restfulServer.add_uri("/ws", LvRestfulServer::type_websocket);
+    restfulServer.add_uri("/api/v1/history/#", LvRestfulServer::type_restful);
+    restfulServer.add_uri("/api/events", LvRestfulServer::type_restful);
+    restfulServer.add_uri("/api/v1/latency", LvRestfulServer::type_restful);
+    restfulServer.add_uri("/api/v1/trace", LvRestfulServer::type_restful);
+    restfulServer.add_uri("/metrics", LvRestfulServer::type_restful);
+    restfulServer.add_uri("/#", LvRestfulServer::type_servedir, rootDir);
+
+    commModule.addOnPublishCallback(&DashboardModule::onPublish, this);
+    std::cout << "Dashboard on address: " << address << " serving: " << rootDir << std::endl;
+}
+
+//Destructor
+DashboardModule::~DashboardModule() {
+    stop();
+}
+
+// Method to run the dashboard server at its own thread
+void DashboardModule::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    dashboardThread = std::thread(&DashboardModule::run, this);
+}
+
+void DashboardModule::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (dashboardThread.joinable()) {
+        dashboardThread.join();
+    }
+}
+
+// Callback from CommModule for every published message, the status JSON is streamed as it is
+void DashboardModule::onPublish(void* self, const std::string topic, const std::string payload) {
+    if (topic != "Camera_status" && topic != "AC_status" && topic != "DC_status") {
+        return;
+    }
+    DashboardModule& dashboard = *(DashboardModule*)self;
+    if (!dashboard.statusQueue.push({topic, payload})) {
+        std::cerr << "Dashboard status queue full, dropped: " << topic << std::endl;
+    }
+}
+
+// Method to answer a history request, path is what follows /api/v1/history/
+std::string DashboardModule::historyJSON(const std::string& path) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        parts.push_back(path.substr(start, end - start));
+        start = end + 1;
+    }
+
+    std::string error;
+    try {
+        if (parts.size() < 3 || parts.size() > 4) {
+            throw std::string("Use /api/v1/history/<ip>/<loop>/<raw|1m|15m>[/<since_ms>]");
+        }
+        int loop = std::stoi(parts[1]);
+        uint64_t since_ms = parts.size() == 4 ? std::stoull(parts[3]) : 0;
+        return countHistory.toJSON(parts[0], loop, parts[2], since_ms);
+    } catch (const std::string& err) {
+        error = err;
+    } catch (const std::exception& e) {
+        error = "Loop and since_ms must be numbers";
+    }
+    return errorJSON(error);
+}
+
+// Method to answer an events request, since is in ms like the event time, from the oldest event without it
+std::string DashboardModule::eventsJSON(const std::string& query) {
+    char since[24] = "";
+    struct mg_str queryStr = mg_str_n(query.c_str(), query.size());
+    mg_http_get_var(&queryStr, "since", since, sizeof(since));
+    return eventJournal.toJSON(strtoull(since, NULL, 10));
+}
+
+// Method to answer a trace request, a POST with enable switches the tracing before the events are taken
+std::string DashboardModule::traceJSON(const std::string& method, const std::string& query) {
+    char enable[4] = "";
+    struct mg_str queryStr = mg_str_n(query.c_str(), query.size());
+    if (mg_http_get_var(&queryStr, "enable", enable, sizeof(enable)) > 0) {
+        if (method != "POST") {
+            return errorJSON("Use POST to switch the tracing");
+        }
+        LvTrace::instance().enable(strcmp(enable, "0") != 0);
+    }
+    return LvTrace::instance().json();
+}
+
+// Method to build the error answer of a request
+std::string DashboardModule::errorJSON(const std::string& message) {
+    LvJSON doc;
+    auto& allocator = doc.GetAllocator();
+    doc.SetObject();
+    doc.AddMember("result", "error", allocator);
+    rapidjson::Value errorValue;
+    errorValue.SetString(message.c_str(), allocator);
+    doc.AddMember("message", errorValue, allocator);
+    return doc.stringify();
+}
+
+// Dashboard thread
+void DashboardModule::run() {
+    while (running) {
+        // A browser connected last round, bring it up to date
+        if (resendStatus) {
+            resendStatus = false;
+            for (const auto& status : latestStatus) {
+                restfulServer.send_ws("/ws", status.second);
+            }
+        }
+
+        std::pair<std::string, std::string> status;
+        while (statusQueue.pop(status)) {
+            restfulServer.send_ws("/ws", status.second);
+            latestStatus[status.first].swap(status.second);
+        }
+
+        // Accept every websocket upgrade, the stream is read only
+        const std::string historyPrefix = "/api/v1/history/";
+        unsigned long id;
+        std::string body;
+        std::string uri;
+        std::string method;
+        std::string query;
+        while (restfulServer.get(id, body, &uri, &method, &query) == 0) {
+            if (uri.compare(0, historyPrefix.size(), historyPrefix) == 0) {
+                restfulServer.set(id, historyJSON(uri.substr(historyPrefix.size())));
+                continue;
+            }
+            if (uri == "/api/events") {
+                restfulServer.set(id, eventsJSON(query));
+                continue;
+            }
+            if (uri == "/api/v1/latency") {
+                restfulServer.set(id, latencyTracker.toJSON());
+                continue;
+            }
+            if (uri == "/api/v1/trace") {
+                restfulServer.set(id, traceJSON(method, query));
+                continue;
+            }
+            if (uri == "/metrics") {
+                restfulServer.set(id, LvMetrics::instance().prometheus());
+                continue;
+            }
+            restfulServer.set(id, "");
+            if (uri == "/ws") {
+                resendStatus = true;
+            }
+        }
+
+        restfulServer.loop(mg_millis());
+        usleep(10000);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef DASHBOARD_MODULE_H
+#define DASHBOARD_MODULE_H
+
+#include "CommModule.h"
+#include "CountHistory.h"
+#include "EventJournal.h"
+#include "LatencyTracker.h"
+#include "LvMetrics.h"
+#include "LvTrace.h"
+#include "LvRestfulServer.h"
+#include "LvMPSCQueue.h"
+#include <string>
+#include <map>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+
+// Serves the dashboard files and streams the module status JSON to the browsers at /ws,
+// GET /api/v1/history/<ip>/<loop>/<raw|1m|15m>[/<since_ms>] gives the count history,
+// GET /api/events?since=<ms> gives a page of the event journal, GET /api/v1/latency the demand latency percentiles,
+// GET /api/v1/trace the trace events for chrome://tracing, POST /api/v1/trace?enable=0|1 switches the tracing,
+// GET /metrics the metrics as Prometheus text,
+// runs at its own thread since LvRestfulServer needs to be polled often
+class DashboardModule {
+public:
+    DashboardModule(CommModule& commModule, CountHistory& countHistory, EventJournal& eventJournal, LatencyTracker& latencyTracker, const std::string& address, const std::string& rootDir);
+    ~DashboardModule();
+
+    // Method to run the dashboard server at its own thread
+    void start();
+    void stop();
+
+private:
+    CountHistory& countHistory;
+    EventJournal& eventJournal;
+    LatencyTracker& latencyTracker;
+    LvRestfulServer restfulServer;
+    LvMPSCQueue<std::pair<std::string, std::string>, 64> statusQueue; // <topic, json> from the publishing threads
+    std::map<std::string, std::string> latestStatus; // dashboard thread only, sent again when a browser connects
+    bool resendStatus = false;
+    std::thread dashboardThread;
+    std::atomic<bool> running{false};
+
+    static void onPublish(void* self, const std::string topic, const std::string payload);
+    std::string historyJSON(const std::string& path);
+    std::string eventsJSON(const std::string& query);
+    std::string traceJSON(const std::string& method, const std::string& query);
+    static std::string errorJSON(const std::string& message);
+    void run();
+};
+
+#endif // DASHBOARD_MODULE_H
@@ -0,0 +1,88 @@
+#include "EventJournal.h"
+
+//Constructor
+EventJournal::EventJournal(const ConfigManager& configManager)
+    : journal(configManager.getJournalConfig().flush_interval_ms) {
+    const auto& journalConfig = configManager.getJournalConfig();
+    if (journal.open(journalConfig.file, journalConfig.capacity) != 0) {
+        std::cerr << "Failed to open event journal: " << journalConfig.file << ", events are not kept" << std::endl;
+        return;
+    }
+    std::cout << "Event journal: " << journalConfig.file << " with " << journal.size() << " events" << std::endl;
+}
+
+// Method to record an event with the current wall time, the events are read off the box
+void EventJournal::record(Source source, int id, int64_t value) {
+    uint64_t now_ms = LvClock::wallMs();
+    std::lock_guard<std::mutex> lock(journalMtx);
+    journal.append(now_ms, source, id, value);
+}
+
+// Method to write back the batched events, the write is waited for outside the lock so recording goes on
+void EventJournal::loop(uint64_t now_ms) {
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(journalMtx);
+        due = journal.flushDue(now_ms);
+    }
+    if (due) {
+        journal.sync();
+    }
+}
+
+// Method to get the events as JSON, the records of a page are copied under the lock and serialized after it
+// {"events":[{"time":1634020000000,"source":"demand","id":1,"value":3}],"next":1634020005000}
+// next is only there when more events are left, it is the time of the first one left out
+std::string EventJournal::toJSON(uint64_t since_ms) {
+    std::vector<LvEventJournal::Record> page;
+    bool more = false;
+    uint64_t next_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(journalMtx);
+        page.reserve(journal.size() < MaxPage ? journal.size() : MaxPage);
+        journal.read(since_ms, [&](const LvEventJournal::Record& record) {
+            // a page ends where the time changes, so since=next neither repeats nor skips an event
+            if (page.size() >= MaxPage && record.timeMs != page.back().timeMs) {
+                more = true;
+                next_ms = record.timeMs;
+                return false;
+            }
+            page.push_back(record);
+            return true;
+        });
+    }
+
+    LvJSON doc;
+    auto& allocator = doc.GetAllocator();
+    doc.SetObject();
+    LvJSON::Value events(rapidjson::kArrayType);
+    for (const auto& record : page) {
+        LvJSON::Value event(rapidjson::kObjectType);
+        event.AddMember("time", (uint64_t)record.timeMs, allocator);
+        event.AddMember("source", rapidjson::StringRef(sourceName(record.source)), allocator);
+        event.AddMember("id", record.id, allocator);
+        event.AddMember("value", (int64_t)record.value, allocator);
+        events.PushBack(event, allocator);
+    }
+    doc.AddMember("events", events, allocator);
+    if (more) {
+        doc.AddMember("next", next_ms, allocator);
+    }
+    return doc.stringify();
+}
+
+// Method to get the name of the source for the JSON
+const char* EventJournal::sourceName(uint16_t source) {
+    switch (source) {
+        case SourceDemand:
+            return "demand";
+        case SourcePhaseRed:
+            return "phase_red";
+        case SourcePhaseGreen:
+            return "phase_green";
+        case SourceButton:
+            return "button";
+        default:
+            return "unknown";
+    }
+}
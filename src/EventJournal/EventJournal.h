@@ -0,0 +1,42 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include "ConfigManager.h"
+#include "LvEventJournal.h"
+#include "LvClock.h"
+#include "LvJSON.h"
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <chrono>
+#include <vector>
+
+// Journal of the demand, AC phase and push button events for incident forensics.
+// Kept in an mmap'd file that wraps around (see LvEventJournal), written back in batches from loop().
+class EventJournal {
+public:
+    enum Source {
+        SourceDemand = 1,       // id: detect loop, value: frame count when set, 0 when released
+        SourcePhaseRed = 2,     // id: AC phase, value: 1 on, 0 off
+        SourcePhaseGreen = 3,   // id: AC phase, value: 1 on, 0 off
+        SourceButton = 4,       // id: push button, value: 1 pressed, 0 released
+    };
+
+    EventJournal(const ConfigManager& configManager);
+
+    // Method to record an event with the current time, safe to call at any thread
+    void record(Source source, int id, int64_t value);
+    // Method to write back the batched events, called from the main loop
+    void loop(uint64_t now_ms);
+    // Method to get the events at or after since_ms as JSON, about MaxPage of them
+    std::string toJSON(uint64_t since_ms);
+
+private:
+    static const size_t MaxPage = 1000; // events per answer, the rest is asked with since=next
+    LvEventJournal journal;
+    std::mutex journalMtx; // recorded by the camera, ingest and main threads, read by the dashboard
+
+    static const char* sourceName(uint16_t source);
+};
+
+#endif // EVENT_JOURNAL_H
@@ -0,0 +1,100 @@
+#include "IngestModule.h"
+
+//Constructor
+IngestModule::IngestModule(CameraManager& cameraManager, CommModule& commModule, const std::string& address)
+    : cameraManager(cameraManager), commModule(commModule), restfulServer(address.c_str()) {
+    restfulServer.add_uri("/api/v1/push/*", LvRestfulServer::type_restful);
+    commModule.subscribe("push/#", &IngestModule::onMessage, this);
+    std::cout << "Count ingestion on address: " << address << std::endl;
+}
+
+//Destructor
+IngestModule::~IngestModule() {
+    stop();
+}
+
+// Method to run the ingestion server at its own thread
+void IngestModule::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    ingestThread = std::thread(&IngestModule::run, this);
+}
+
+void IngestModule::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (ingestThread.joinable()) {
+        ingestThread.join();
+    }
+}
+
+// Callback from the MQTT broker thread for push/<camera ip>, checked here and handled at the ingestion thread
+void IngestModule::onMessage(void* self, const std::string topic, const std::string payload) {
+    IngestModule& ingestModule = *(IngestModule*)self;
+    std::string ip = topic.substr(std::string("push/").size());
+    std::string sourceIp = ingestModule.commModule.messageSourceIp();
+    if (sourceIp != ip) {
+        std::cerr << "Rejected count on " << topic << ": sent from " << sourceIp << std::endl;
+        return;
+    }
+    if (!ingestModule.pushQueue.push({ip, payload})) {
+        std::cerr << "Ingest queue full, dropped count on " << topic << std::endl;
+    }
+}
+
+// Method to pass the count to the camera manager, returns the error or empty when accepted
+std::string IngestModule::ingest(const std::string& ip, const std::string& sourceIp, const std::string& body) {
+    if (sourceIp != ip) {
+        return "Count for " + ip + " sent from " + sourceIp;
+    }
+    try {
+        cameraManager.ingestCount(ip, body);
+    } catch (const std::string& err) {
+        return err;
+    }
+    return "";
+}
+
+// Ingestion thread
+void IngestModule::run() {
+    const std::string prefix = "/api/v1/push/";
+    while (running) {
+        restfulServer.loop(mg_millis());
+
+        std::pair<std::string, std::string> pushed;
+        while (pushQueue.pop(pushed)) {
+            std::string error = ingest(pushed.first, pushed.first, pushed.second); // sender checked at the broker thread
+            if (!error.empty()) {
+                std::cerr << "Rejected count on push/" << pushed.first << ": " << error << std::endl;
+            }
+        }
+
+        unsigned long id;
+        std::string body;
+        std::string uri;
+        std::string method;
+        std::string remoteIp;
+        while (restfulServer.get(id, body, &uri, &method, NULL, &remoteIp) == 0) {
+            std::string error = "Count must be sent with POST";
+            if (method == "POST") {
+                error = ingest(uri.substr(prefix.size()), remoteIp, body);
+            }
+
+            LvJSON doc;
+            auto& allocator = doc.GetAllocator();
+            doc.SetObject();
+            doc.AddMember("result", rapidjson::StringRef(error.empty() ? "ok" : "error"), allocator);
+            if (!error.empty()) {
+                rapidjson::Value errorValue;
+                errorValue.SetString(error.c_str(), allocator);
+                doc.AddMember("message", errorValue, allocator);
+            }
+            restfulServer.set(id, doc.stringify());
+        }
+        usleep(1000); // short, a pushed count should reach the outputs right away
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef INGEST_MODULE_H
+#define INGEST_MODULE_H
+
+#include "CameraManager.h"
+#include "CommModule.h"
+#include "LvRestfulServer.h"
+#include "LvJSON.h"
+#include "LvMPSCQueue.h"
+#include <string>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+
+// Takes the count JSON pushed by the cameras that support webhooks, same format as their /api/v1/count,
+// and feeds it to the same demand handling as the poll
+// POST http://<box>/api/v1/push/<camera ip>   replies {"result":"ok"|"error","message"}
+// MQTT push/<camera ip>
+// A count is taken only from the camera it claims to be, the sender address must be the camera ip
+class IngestModule {
+public:
+    IngestModule(CameraManager& cameraManager, CommModule& commModule, const std::string& address);
+    ~IngestModule();
+
+    // Method to run the ingestion server at its own thread
+    void start();
+    void stop();
+
+private:
+    CameraManager& cameraManager;
+    CommModule& commModule;
+    LvRestfulServer restfulServer;
+    LvMPSCQueue<std::pair<std::string, std::string>, 64> pushQueue; // <camera ip, count json> from the broker thread
+    std::thread ingestThread;
+    std::atomic<bool> running{false};
+
+    static void onMessage(void* self, const std::string topic, const std::string payload);
+    std::string ingest(const std::string& ip, const std::string& sourceIp, const std::string& body);
+    void run();
+};
+
+#endif // INGEST_MODULE_H
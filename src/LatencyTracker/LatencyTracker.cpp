@@ -0,0 +1,112 @@
+#include "LatencyTracker.h"
+#include <cstdio>
+
+//Constructor
+LatencyTracker::LatencyTracker(const ConfigManager& configManager) {
+    // Everything is allocated here so recording never allocates nor locks
+    for (const auto& camConfig : configManager.getCameraConfigs()) {
+        for (const auto& demand : camConfig.demands) {
+            series.emplace_back();
+            Series& s = series.back();
+            s.ip = camConfig.ip_address;
+            s.demandId = demand.detect_loop;
+            for (int stage = 0; stage < StageCount; stage++) {
+                s.stages[stage].reset(new LvHdrHistogram());
+            }
+        }
+    }
+
+    // The total and output stages are what the road authority asks for, the rest is in the REST answer
+    for (const auto& s : series) {
+        for (int stage : {StageTotal, StageOutput}) {
+            for (double percent : {50.0, 99.0, 99.9}) {
+                quantiles.push_back({s.stages[stage].get(), percent});
+                char quantile[16];
+                snprintf(quantile, sizeof(quantile), "%g", percent / 100);
+                std::string labels = "camera=\"" + s.ip + "\",demand=\"" + std::to_string(s.demandId) +
+                                     "\",stage=\"" + stageName(stage) + "\",quantile=\"" + quantile + "\"";
+                LvMetrics::instance().gaugeCallback("iotbox_demand_latency_us",
+                    "Detection to output latency of the demands, microseconds",
+                    &LatencyTracker::quantileValue, &quantiles.back(), labels);
+            }
+        }
+    }
+}
+
+// Method to record a demand that drove an output
+void LatencyTracker::record(const std::string& ip, int demandId, const Stamps& stamps) {
+    for (auto& s : series) {
+        if (s.ip != ip || s.demandId != demandId) {
+            continue;
+        }
+        s.stages[StageNetwork]->record(stamps.responseUs - stamps.requestUs);
+        s.stages[StageParse]->record(stamps.parsedUs - stamps.responseUs);
+        s.stages[StageDecide]->record(stamps.handleUs - stamps.parsedUs);
+        s.stages[StageOutput]->record(stamps.writtenUs - stamps.handleUs);
+        s.stages[StageTotal]->record(stamps.writtenUs - stamps.requestUs);
+        return;
+    }
+}
+
+// Method to get the percentiles as JSON
+// {"latency":[{"ip","demand","stages":{"total":{"count","mean","p50","p90","p99","p999","max"},...}}]}
+std::string LatencyTracker::toJSON() {
+    LvJSON doc;
+    auto& allocator = doc.GetAllocator();
+    doc.SetObject();
+    LvJSON::Value seriesArray(rapidjson::kArrayType);
+    for (const auto& s : series) {
+        LvJSON::Value seriesObj(rapidjson::kObjectType);
+        rapidjson::Value ipValue;
+        ipValue.SetString(s.ip.c_str(), allocator);
+        seriesObj.AddMember("ip", ipValue, allocator);
+        seriesObj.AddMember("demand", s.demandId, allocator);
+
+        LvJSON::Value stagesObj(rapidjson::kObjectType);
+        for (int stage = 0; stage < StageCount; stage++) {
+            const LvHdrHistogram& histogram = *s.stages[stage];
+            LvJSON::Value stageObj(rapidjson::kObjectType);
+            stageObj.AddMember("count", (uint64_t)histogram.count(), allocator);
+            stageObj.AddMember("mean", histogram.mean(), allocator);
+            stageObj.AddMember("p50", (uint64_t)histogram.percentile(50), allocator);
+            stageObj.AddMember("p90", (uint64_t)histogram.percentile(90), allocator);
+            stageObj.AddMember("p99", (uint64_t)histogram.percentile(99), allocator);
+            stageObj.AddMember("p999", (uint64_t)histogram.percentile(99.9), allocator);
+            stageObj.AddMember("max", (uint64_t)histogram.max(), allocator);
+            stagesObj.AddMember(rapidjson::StringRef(stageName(stage)), stageObj, allocator);
+        }
+        seriesObj.AddMember("stages", stagesObj, allocator);
+        seriesArray.PushBack(seriesObj, allocator);
+    }
+    doc.AddMember("unit", "us", allocator);
+    doc.AddMember("latency", seriesArray, allocator);
+    return doc.stringify();
+}
+
+// Method to get the monotonic time in microseconds, the stamps are only compared with each other
+uint64_t LatencyTracker::nowUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Method to get the name of the stage for the JSON and the metric labels
+const char* LatencyTracker::stageName(int stage) {
+    switch (stage) {
+        case StageNetwork:
+            return "network";
+        case StageParse:
+            return "parse";
+        case StageDecide:
+            return "decide";
+        case StageOutput:
+            return "output";
+        default:
+            return "total";
+    }
+}
+
+// Metrics callback, read at export time
+double LatencyTracker::quantileValue(void* self) {
+    Quantile& quantile = *(Quantile*)self;
+    return quantile.histogram->percentile(quantile.percent);
+}
@@ -0,0 +1,60 @@
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include "ConfigManager.h"
+#include "LvHdrHistogram.h"
+#include "LvMetrics.h"
+#include "LvJSON.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <chrono>
+
+// Detection to output latency of every demand, per camera and detect loop.
+// Each demand carries the time of its stages, from the count request to the expander write,
+// the stage durations go to HDR histograms (microseconds) so the percentiles hold at any load.
+// Exported as p50/p99/p999 gauges on the metrics and in full at GET /api/v1/latency.
+class LatencyTracker {
+public:
+    // Stage times of one demand in microseconds of the monotonic clock, see nowUs()
+    // A pushed count has no request, its request and response are the time it was received
+    struct Stamps {
+        uint64_t requestUs = 0;  // count request sent to the camera
+        uint64_t responseUs = 0; // count response received
+        uint64_t parsedUs = 0;   // count JSON parsed
+        uint64_t handleUs = 0;   // handleDemand entered
+        uint64_t writtenUs = 0;  // expander write completed
+    };
+
+    LatencyTracker(const ConfigManager& configManager);
+
+    // Method to record a demand that drove an output, safe to call at any thread
+    void record(const std::string& ip, int demandId, const Stamps& stamps);
+    // Method to get the percentiles of every camera loop as JSON
+    std::string toJSON();
+
+    static uint64_t nowUs();
+
+private:
+    enum Stage { StageNetwork, StageParse, StageDecide, StageOutput, StageTotal, StageCount };
+    static const char* stageName(int stage);
+
+    struct Series {
+        std::string ip;
+        int demandId;
+        std::unique_ptr<LvHdrHistogram> stages[StageCount];
+    };
+    std::vector<Series> series; // one per configured demand, fixed after the constructor
+
+    // Metrics callback context, one per exported percentile
+    struct Quantile {
+        const LvHdrHistogram* histogram;
+        double percent;
+    };
+    std::deque<Quantile> quantiles; // deque keeps the addresses given to the callbacks
+
+    static double quantileValue(void* self);
+};
+
+#endif // LATENCY_TRACKER_H
@@ -0,0 +1,41 @@
+#include "MetricsModule.h"
+
+//Constructor
+MetricsModule::MetricsModule(CommModule& commModule, uint64_t intervalMs)
+    : commModule(commModule), intervalMs(intervalMs), startMs(LvClock::nowMs()) {
+    LvMetrics::instance().gaugeCallback("iotbox_uptime_seconds", "Seconds since the program started",
+                                        &MetricsModule::uptimeSeconds, this);
+
+    commModule.addStateTopic("$SYS/iotbox/#");
+}
+
+// Method to publish the metrics of every subsystem once per interval
+void MetricsModule::loop(uint64_t now_ms) {
+    if (now_ms - lastPublishMs < intervalMs) {
+        return;
+    }
+    lastPublishMs = now_ms;
+
+    // iotbox_<subsystem>_<metric>, the names are sorted so a subsystem is one run
+    const std::string prefix = "iotbox_";
+    std::string lastSubsystem;
+    for (const auto& name : LvMetrics::instance().names()) {
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        size_t end = name.find('_', prefix.size());
+        std::string subsystem = name.substr(prefix.size(), end == std::string::npos ? std::string::npos : end - prefix.size());
+        if (subsystem == lastSubsystem) {
+            continue;
+        }
+        lastSubsystem = subsystem;
+        std::string subsystemPrefix = prefix + subsystem + (end == std::string::npos ? "" : "_");
+        commModule.publish("$SYS/iotbox/" + subsystem, LvMetrics::instance().json(subsystemPrefix));
+    }
+}
+
+// Metrics callback, read at export time
+double MetricsModule::uptimeSeconds(void* self) {
+    MetricsModule& metricsModule = *(MetricsModule*)self;
+    return (LvClock::nowMs() - metricsModule.startMs) / 1000.0;
+}
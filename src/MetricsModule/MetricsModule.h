@@ -0,0 +1,28 @@
+#ifndef METRICS_MODULE_H
+#define METRICS_MODULE_H
+
+#include "CommModule.h"
+#include "LvMetrics.h"
+#include "LvClock.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Publishes the metrics registry for fleet monitoring, one retained-style state topic per subsystem:
+// iotbox_camera_* goes to $SYS/iotbox/camera, iotbox_mqtt_* to $SYS/iotbox/mqtt and so on.
+// The same registry is served as Prometheus text at /metrics by the dashboard.
+class MetricsModule {
+public:
+    MetricsModule(CommModule& commModule, uint64_t intervalMs = 10000);
+    void loop(uint64_t now_ms);
+
+private:
+    CommModule& commModule;
+    const uint64_t intervalMs;
+    uint64_t lastPublishMs = 0;
+    uint64_t startMs;
+
+    static double uptimeSeconds(void* self);
+};
+
+#endif // METRICS_MODULE_H
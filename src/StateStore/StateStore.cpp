@@ -0,0 +1,104 @@
+#include "StateStore.h"
+
+//Constructor
+StateStore::StateStore(const ConfigManager& configManager)
+    : flushIntervalMs(configManager.getStateConfig().flush_interval_ms) {
+    const auto& stateConfig = configManager.getStateConfig();
+    int rc = stateFile.open(stateConfig.file);
+    if (rc < 0) {
+        std::cerr << "Failed to open state file: " << stateConfig.file << ", starting cold on every restart" << std::endl;
+        return;
+    }
+    state = stateFile.get();
+    std::cout << "State file: " << stateConfig.file << (rc == 0 ? " loaded" : " created") << std::endl;
+}
+
+// Method to get the saved state of a demand
+bool StateStore::loadDemand(const std::string& ip, int demandId, DemandState& demandState) {
+    std::lock_guard<std::mutex> lock(stateMtx);
+    SavedDemand* saved = findDemand(ip, demandId, false);
+    if (saved == NULL) {
+        return false;
+    }
+    demandState.previousCount = saved->previousCount;
+    demandState.isHandled = saved->isHandled;
+    demandState.lastHandledTime = saved->lastHandledTime;
+    return true;
+}
+
+// Method to save the state of a demand
+void StateStore::saveDemand(const std::string& ip, int demandId, const DemandState& demandState) {
+    std::lock_guard<std::mutex> lock(stateMtx);
+    SavedDemand* saved = findDemand(ip, demandId, true);
+    if (saved == NULL) {
+        return;
+    }
+    saved->previousCount = demandState.previousCount;
+    saved->isHandled = demandState.isHandled;
+    saved->lastHandledTime = demandState.lastHandledTime;
+    dirty = true;
+}
+
+// Method to get the saved output value of an expander
+bool StateStore::loadOutputs(int expander, unsigned char& portValue) {
+    std::lock_guard<std::mutex> lock(stateMtx);
+    if (state == NULL || !state->hasOutputs || expander < 0 || expander >= MaxExpanders) {
+        return false;
+    }
+    portValue = state->portValue[expander];
+    return true;
+}
+
+void StateStore::saveOutputs(int expander, unsigned char portValue) {
+    std::lock_guard<std::mutex> lock(stateMtx);
+    if (state == NULL || expander < 0 || expander >= MaxExpanders) {
+        return;
+    }
+    state->hasOutputs = 1;
+    state->portValue[expander] = portValue;
+    dirty = true;
+}
+
+// Method to write back the changes, at most once per flush interval
+// the write is waited for outside the lock so the demand saves go on meanwhile
+void StateStore::loop(uint64_t now_ms) {
+    {
+        std::lock_guard<std::mutex> lock(stateMtx);
+        if (!dirty || now_ms - lastFlushMs < flushIntervalMs) {
+            return;
+        }
+        dirty = false;
+        lastFlushMs = now_ms;
+    }
+    stateFile.flush();
+}
+
+// Method to find the slot of a demand, take a free one when asked, caller holds stateMtx
+StateStore::SavedDemand* StateStore::findDemand(const std::string& ip, int demandId, bool create) {
+    if (state == NULL || ip.size() >= sizeof(state->demands[0].ip)) {
+        return NULL;
+    }
+    SavedDemand* freeSlot = NULL;
+    for (auto& saved : state->demands) {
+        if (saved.ip[0] == '\0') {
+            if (freeSlot == NULL) {
+                freeSlot = &saved;
+            }
+            continue;
+        }
+        if (saved.demandId == demandId && ip == saved.ip) {
+            return &saved;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (freeSlot == NULL) {
+        std::cerr << "State file full, demand " << demandId << " of camera " << ip << " not kept" << std::endl;
+        return NULL;
+    }
+    memset(freeSlot, 0, sizeof(SavedDemand));
+    strncpy(freeSlot->ip, ip.c_str(), sizeof(freeSlot->ip) - 1);
+    freeSlot->demandId = demandId;
+    return freeSlot;
+}
@@ -0,0 +1,65 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include "ConfigManager.h"
+#include "LvMmapState.h"
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <cstring>
+
+// Checkpoint of the demand state and the output shadow in a small mmap'd file, so a restart
+// resumes where it stopped instead of seeing every count as new and pulsing the outputs.
+// Every save lands in the mapping at once (a process restart always sees it),
+// loop() writes it back to the file so a power cut loses at most one interval.
+class StateStore {
+public:
+    struct DemandState {
+        int previousCount;
+        bool isHandled;
+        uint64_t lastHandledTime; // wall time, a monotonic time would not outlive a reboot
+    };
+
+    StateStore(const ConfigManager& configManager);
+
+    // Method to get the saved state of a demand, returns false when there is none
+    bool loadDemand(const std::string& ip, int demandId, DemandState& demandState);
+    // Method to save the state of a demand, safe to call at any thread
+    void saveDemand(const std::string& ip, int demandId, const DemandState& demandState);
+    // Method to get the saved output value of an expander (0 or 1), returns false when there is none
+    bool loadOutputs(int expander, unsigned char& portValue);
+    void saveOutputs(int expander, unsigned char portValue);
+    // Method to write back the changes, called from the main loop
+    void loop(uint64_t now_ms);
+
+private:
+    static const int MaxDemands = 64;
+    static const int MaxExpanders = 2;
+
+    // File layout, change the version passed to open() when the meaning changes
+    struct SavedDemand {
+        char ip[64]; // empty when the slot is free
+        int32_t demandId;
+        int32_t previousCount;
+        uint8_t isHandled;
+        uint8_t reserved[7];
+        uint64_t lastHandledTime;
+    };
+    struct SavedState {
+        SavedDemand demands[MaxDemands];
+        uint8_t hasOutputs;
+        uint8_t portValue[MaxExpanders]; // the second one was reserved, zero in an older file
+        uint8_t reserved[5];
+    };
+
+    LvMmapState<SavedState> stateFile;
+    SavedState* state = NULL; // NULL when the file could not be opened, nothing is kept then
+    std::mutex stateMtx; // saved by the camera, ingest and MQTT threads
+    bool dirty = false;
+    uint64_t flushIntervalMs;
+    uint64_t lastFlushMs = 0;
+
+    SavedDemand* findDemand(const std::string& ip, int demandId, bool create);
+};
+
+#endif // STATE_STORE_H
@@ -0,0 +1,142 @@
+#include "UplinkModule.h"
+
+//Constructor
+UplinkModule::UplinkModule(const ConfigManager& configManager, CommModule& commModule)
+    : uplinkConfig(configManager.getUplinkConfig()) {
+    if (!uplinkConfig.enabled) {
+        std::cout << "Uplink disabled." << std::endl;
+        return;
+    }
+
+    if (ring.open(uplinkConfig.buffer_file, uplinkConfig.buffer_size) != 0) {
+        std::cerr << "Failed to open uplink buffer file: " << uplinkConfig.buffer_file << std::endl;
+        return;
+    }
+    std::cout << "Uplink buffer: " << uplinkConfig.buffer_file << " with " << ring.size() << " pending messages" << std::endl;
+    LvMetrics::instance().gaugeCallback("iotbox_uplink_pending", "Messages buffered for the central broker",
+                                        &UplinkModule::pendingCount, this);
+
+    mqttClient.reset(new LvMQTTClient(uplinkConfig.url, uplinkConfig.client_id));
+
+    commModule.addOnPublishCallback(&UplinkModule::onPublish, this);
+}
+
+//Destructor
+UplinkModule::~UplinkModule() {
+    stop();
+    std::lock_guard<std::mutex> lock(ringMtx);
+    ring.flush();
+}
+
+// Method to run the uplink at its own thread
+void UplinkModule::start() {
+    if (!mqttClient || running) {
+        return;
+    }
+    running = true;
+    uplinkThread = std::thread(&UplinkModule::run, this);
+    std::cout << "Uplink to " << uplinkConfig.url << " started" << std::endl;
+}
+
+void UplinkModule::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (uplinkThread.joinable()) {
+        uplinkThread.join();
+    }
+}
+
+// Callback from CommModule for every published message, store the forwarded topics
+void UplinkModule::onPublish(void* self, const std::string topic, const std::string payload) {
+    UplinkModule& uplink = *(UplinkModule*)self;
+    if (!uplink.isForwarded(topic)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(uplink.ringMtx);
+    uint32_t count = uplink.ring.size();
+    int rc = uplink.ring.push(topic, payload);
+    if (rc == 1) {
+        // the dropped ones may be in flight, their acknowledgement must not pop the next message
+        uint32_t dropped = std::min(count + 1 - uplink.ring.size(), uplink.inFlight);
+        uplink.inFlight -= dropped;
+        uplink.ackToSkip += dropped;
+        std::cerr << "Uplink buffer full, oldest message dropped" << std::endl;
+    } else if (rc < 0) {
+        std::cerr << "Uplink buffer cannot store message of topic: " << topic << std::endl;
+    }
+}
+
+// Method to check the topic against the configured topics, wildcard supported
+bool UplinkModule::isForwarded(const std::string& topic) const {
+    for (const auto& pattern : uplinkConfig.topics) {
+        if (mg_globmatch(pattern.c_str(), pattern.size(), topic.c_str(), topic.size())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Method to send the buffered messages in order, limited to replay_rate per second
+// A message leaves the ring only when the central broker acknowledged it
+void UplinkModule::replay(uint64_t now_ms) {
+    if (now_ms - replayTickMs >= 1000) {
+        replayTickMs = now_ms;
+        replayBudget = uplinkConfig.replay_rate;
+    }
+
+    std::lock_guard<std::mutex> lock(ringMtx);
+    for (uint32_t acked = mqttClient->take_puback(); acked > 0; acked--) {
+        if (ackToSkip > 0) {
+            ackToSkip--;
+        } else if (inFlight > 0) {
+            ring.pop();
+            inFlight--;
+        }
+    }
+    // the previous connection took its unacknowledged messages with it, send them again
+    if (mqttClient->connected_count() != connection) {
+        connection = mqttClient->connected_count();
+        inFlight = 0;
+        ackToSkip = 0;
+    }
+
+    std::string topic;
+    std::string payload;
+    while (replayBudget > 0 && inFlight < UPLINK_MAX_IN_FLIGHT && mqttClient->isconnected()) {
+        if (ring.at(inFlight, topic, payload) != 0) {
+            break;
+        }
+        if (mqttClient->pub(topic, payload, 1) != 0) {
+            break; // client queue full or link dropped, try again later
+        }
+        inFlight++;
+        replayBudget--;
+    }
+}
+
+// Uplink thread
+void UplinkModule::run() {
+    while (running) {
+        uint64_t now_ms = mg_millis();
+        mqttClient->loop(now_ms);
+        replay(now_ms);
+
+        // let the kernel write back the ring now and then instead of on every message
+        if (now_ms - flushTickMs > 10000) {
+            flushTickMs = now_ms;
+            std::lock_guard<std::mutex> lock(ringMtx);
+            ring.flush();
+        }
+        usleep(10000);
+    }
+}
+
+// Metrics callback, read at export time
+double UplinkModule::pendingCount(void* self) {
+    UplinkModule& uplink = *(UplinkModule*)self;
+    std::lock_guard<std::mutex> lock(uplink.ringMtx);
+    return uplink.ring.size();
+}
@@ -0,0 +1,57 @@
+#ifndef UPLINK_MODULE_H
+#define UPLINK_MODULE_H
+
+#include "ConfigManager.h"
+#include "CommModule.h"
+#include "LvMQTTClient.h"
+#include "LvMmapRing.h"
+#include "LvMetrics.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <unistd.h>
+
+#define UPLINK_MAX_IN_FLIGHT 16 // messages sent to the central broker and not acknowledged yet
+
+// Forwards the selected published topics to the central broker.
+// Every message goes through an mmap'd ring on disk first, so while the link is down
+// they are kept and replayed in order, at most replay_rate messages per second, after reconnect.
+// They are sent with QoS 1 and leave the ring only on PUBACK, a connection lost before that sends them again.
+class UplinkModule {
+public:
+    UplinkModule(const ConfigManager& configManager, CommModule& commModule);
+    ~UplinkModule();
+
+    // Method to run the uplink at its own thread
+    void start();
+    void stop();
+
+private:
+    const ConfigManager::UplinkConfig& uplinkConfig;
+
+    std::unique_ptr<LvMQTTClient> mqttClient; // only when enabled
+    LvMmapRing ring;
+    std::mutex ringMtx; // ring is written by the publishing threads and read by the uplink thread
+    std::thread uplinkThread;
+    std::atomic<bool> running{false};
+
+    uint64_t replayTickMs = 0;
+    int replayBudget = 0;
+    uint64_t connection = 0; // connected_count() of the connection the in flight messages were sent on
+    uint32_t inFlight = 0; // ring messages from the front sent and not acknowledged, guarded by ringMtx
+    uint32_t ackToSkip = 0; // acknowledgements of in flight messages the full ring dropped, guarded by ringMtx
+    uint64_t flushTickMs = 0;
+
+    static double pendingCount(void* self);
+    static void onPublish(void* self, const std::string topic, const std::string payload);
+    bool isForwarded(const std::string& topic) const;
+    void replay(uint64_t now_ms);
+    void run();
+};
+
+#endif // UPLINK_MODULE_H
@@ -1,21 +1,37 @@
 #include "ConfigManager.h"
 #include "CameraManager.h"
+#include "CameraLiveness.h"
+#include "CountHistory.h"
+#include "EventJournal.h"
+#include "StateStore.h"
+#include "LatencyTracker.h"
+#include "CameraCapture.h"
+#include "MetricsModule.h"
 #include "ControlModule.h"
 #include "CommModule.h"
 #include "ACMonitor.h"
 #include "DCinput.h"
+#include "CommandModule.h"
+#include "UplinkModule.h"
+#include "DashboardModule.h"
+#include "IngestModule.h"
+#include "LvTrace.h"
+#include "LvClock.h"
 
 #include <thread>
 #include <chrono>
 #include <iostream>
 #include <unistd.h>
+#include <csignal>
 
 #define MCP23017_ADDR1 0x20
 #define MCP23017_ADDR2 0x21
 
-uint64_t get_current_time_ms(){
-	using namespace std::chrono;
-	return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+// set by SIGUSR1, the main loop writes the trace file
+static volatile sig_atomic_t trace_dump_requested = 0;
+
+static void on_trace_signal(int) {
+    trace_dump_requested = 1;
 }
 
 int main() {
@@ -23,46 +39,157 @@ int main() {
     ConfigManager configManager("config.json");
     std::cout << "----- Configuration loaded successfully -----" << std::endl;
 
+    // A replay answers the polls from a file, on a box it would drive the outputs on old traffic
+    if (configManager.getCaptureConfig().mode == "replay") {
+        std::cerr << "Capture mode \"replay\" is for meow_sim and meow_farm only, use \"off\" or \"record\"" << std::endl;
+        return 1;
+    }
+
+    const ConfigManager::TraceConfig& traceConfig = configManager.getTraceConfig();
+    LvTrace::instance().setRingSize(traceConfig.ring_events);
+    LvTrace::instance().enable(traceConfig.enabled);
+    LvTrace::instance().setThreadName("main");
+    signal(SIGUSR1, on_trace_signal);
+    std::cout << "Trace " << (traceConfig.enabled ? "on" : "off") << ", SIGUSR1 writes " << traceConfig.file << std::endl;
+
+    std::cout << "-------- Starting the state store --------" << std::endl;
+    StateStore stateStore(configManager);
+    std::cout << "-------- State store initialized ---------" << std::endl;
+
     std::cout << "-------- Starting the control module --------" << std::endl;
-    ControlModule controlModule("/dev/i2c-0", MCP23017_ADDR1, MCP23017_ADDR2, configManager);
+    ControlModule controlModule("/dev/i2c-0", MCP23017_ADDR1, MCP23017_ADDR2, configManager, stateStore);
     std::cout << "-------- Control module initialized ---------" << std::endl;
 
     std::cout << "-------- Starting the communication module --------" << std::endl;
     // CommModule commModule(configManager.getCommModuleAddress());
-    CommModule commModule("0.0.0.0:1883");
+    CommModule commModule("0.0.0.0:1883", "0.0.0.0:8083");
     std::cout << "-------- Communication module initialized ---------" << std::endl;
 
+    std::cout << "-------- Starting the event journal --------" << std::endl;
+    EventJournal eventJournal(configManager);
+    std::cout << "-------- Event journal initialized ---------" << std::endl;
+
     std::cout << "-------- Starting the DC input module --------" << std::endl;
-    DCInput dcInput(configManager, controlModule, commModule);
+    DCInput dcInput(configManager, controlModule, commModule, eventJournal);
     std::cout << "-------- DC input module initialized ---------" << std::endl;
 
     std::cout << "-------- Starting the AC monitor module --------" << std::endl;
-    ACMonitor acMonitor(configManager, controlModule, commModule);
+    ACMonitor acMonitor(configManager, controlModule, commModule, eventJournal);
     std::cout << "-------- AC monitor module initialized ---------" << std::endl;
     
+    std::cout << "-------- Starting the camera liveness --------" << std::endl;
+    CameraLiveness cameraLiveness(configManager);
+    cameraLiveness.start();
+    std::cout << "-------- Camera liveness initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the count history --------" << std::endl;
+    CountHistory countHistory(configManager);
+    std::cout << "-------- Count history initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the latency tracker --------" << std::endl;
+    LatencyTracker latencyTracker(configManager);
+    std::cout << "-------- Latency tracker initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the camera capture --------" << std::endl;
+    CameraCapture cameraCapture(configManager);
+    std::cout << "-------- Camera capture initialized ---------" << std::endl;
+
     std::cout << "-------- Starting the camera manager --------" << std::endl;
-    CameraManager cameraManager(configManager, controlModule, commModule);
+    CameraManager cameraManager(configManager, controlModule, commModule, cameraLiveness, countHistory, eventJournal, stateStore, latencyTracker, cameraCapture);
     std::cout << "-------- Camera manager initialized ---------" << std::endl;
 
+    std::cout << "-------- Starting the command module --------" << std::endl;
+    CommandModule commandModule(configManager, controlModule, commModule);
+    std::cout << "-------- Command module initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the uplink module --------" << std::endl;
+    UplinkModule uplinkModule(configManager, commModule);
+    uplinkModule.start();
+    std::cout << "-------- Uplink module initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the ingest module --------" << std::endl;
+    IngestModule ingestModule(cameraManager, commModule, "0.0.0.0:8080");
+    ingestModule.start();
+    std::cout << "-------- Ingest module initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the dashboard module --------" << std::endl;
+    DashboardModule dashboardModule(commModule, countHistory, eventJournal, latencyTracker, "0.0.0.0:3000",
+                                    configManager.getDashboardConfig().root_dir);
+    dashboardModule.start();
+    std::cout << "-------- Dashboard module initialized ---------" << std::endl;
+
+    std::cout << "-------- Starting the metrics module --------" << std::endl;
+    MetricsModule metricsModule(commModule);
+    LvMetrics::Histogram& loopDuration = LvMetrics::instance().histogram("iotbox_main_loop_duration_ms",
+        "Work time of one main loop tick", {1, 5, 10, 25, 50, 100, 250, 500, 1000});
+    std::cout << "-------- Metrics module initialized ---------" << std::endl;
+
+    // Broker runs on its own thread so MQTT is not held up by the camera polling
+    commModule.start();
+
     std::cout << "---------- Starting the main loop -----------" << std::endl;
+    uint64_t last_io_loop_ms = 0;
     while (true) {
-        uint64_t now_ms = get_current_time_ms();
-        std::cout << "-------- Entering camera manager loop -------" << std::endl;
-        cameraManager.loop(now_ms);
+        // One monotonic time per tick, the modules take it from here instead of reading their own clock
+        uint64_t now_ms = LvClock::nowMs();
+        if (trace_dump_requested) {
+            trace_dump_requested = 0;
+            if (LvTrace::instance().dump(traceConfig.file) == 0) {
+                LV_LOG_INFO("Trace written to {}", traceConfig.file);
+            } else {
+                LV_LOG_ERROR("Failed to write the trace to {}", traceConfig.file);
+            }
+        }
 
-        //AC Monitor loop
-        std::cout << "-------- Entering AC monitor loop -------" << std::endl;
-        acMonitor.loop(now_ms);
+        LV_TRACE_SCOPE("main.loop"); // whole iteration, the sleep included
+        {
+            //Camera manager loop, polls only the cameras that are due so it runs on a short tick
+            LV_TRACE_SCOPE("camera.loop");
+            cameraManager.loop(now_ms);
+        }
+        {
+            //Event journal, writes back the batched events once per flush interval
+            LV_TRACE_SCOPE("journal.loop");
+            eventJournal.loop(now_ms);
+        }
+        //Camera capture, hands the recorded polls to the file once per second
+        cameraCapture.loop(now_ms);
+        {
+            //State store, writes back the checkpoint once per flush interval
+            LV_TRACE_SCOPE("state.loop");
+            stateStore.loop(now_ms);
+        }
 
-        //DC Input loop
-        std::cout << "-------- Entering DC input loop -------" << std::endl;
-        dcInput.loop(now_ms);
-
-        //CommModule loop to handle incoming messages
-        std::cout << "-------- Entering communication module loop -------" << std::endl;
+        //CommModule loop, only does the job if the broker thread failed to start, every tick since it is then the broker I/O
         commModule.loop(now_ms);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        if (now_ms - last_io_loop_ms >= 1000) {
+            last_io_loop_ms = now_ms;
+
+            //AC Monitor loop
+            LV_LOG_DEBUG("-------- Entering AC monitor loop -------");
+            {
+                LV_TRACE_SCOPE("ac.loop");
+                acMonitor.loop(now_ms);
+            }
+
+            //DC Input loop
+            LV_LOG_DEBUG("-------- Entering DC input loop -------");
+            {
+                LV_TRACE_SCOPE("dc.loop");
+                dcInput.loop(now_ms);
+            }
+
+            //Metrics module loop, publishes the $SYS/iotbox topics once per interval
+            {
+                LV_TRACE_SCOPE("metrics.loop");
+                metricsModule.loop(now_ms);
+            }
+        }
+
+        loopDuration.observe(LvClock::nowMs() - now_ms);
+        LV_TRACE_SCOPE("main.sleep");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
 
     return 0;